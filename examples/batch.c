@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "../combstruct2json.h"
+
+
+
+/*****************************************************************
+ * BENCHMARK OF BATCH VERSUS POINTWISE ORACLE EVALUATION
+ *
+ * This example compiles a grammar into an oracle (see
+ * compileOracle()), and evaluates it at a number of points
+ * spread over (0, 1.1 rho), past its singularity rho: once with
+ * a loop of calls to evaluateOracle(), and once with a single
+ * call to evaluateOracleBatch(), which evaluates several points
+ * at once in the lanes of SIMD vectors. It reports the time
+ * taken per point by each, and checks that they agree.
+ *
+ * The number of lanes depends on the instruction set the
+ * library is compiled for, so it should be built with, say,
+ * "make lib CC='gcc -O2 -march=native'". Then, assuming the
+ * working directory is the top-level directory of this project:
+ *
+ * $ gcc -O2 -o batch examples/batch.c -L. -lcombstruct2json -lm
+ * $ ./batch tests/reluctantQPW1 unlabelled 10000
+ *
+ *****************************************************************/
+
+double seconds(clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s FILE [labelled|unlabelled] [points]\n", argv[0]);
+    return 2;
+  }
+  Grammar *root = readGrammar(argv[1]);
+  OracleType type = (argc > 2 && strcmp(argv[2], "labelled") == 0) ? LABELLED : UNLABELLED;
+  int count = (argc > 3) ? atoi(argv[3]) : 10000;
+
+  Oracle *oracle = compileOracle(root, type);
+  if (oracle == NULL)
+  {
+    printf("cannot compile an oracle for this grammar\n");
+    return 1;
+  }
+  double rho = oracleSingularity(oracle, 1e-12);
+  double bound = isinf(rho) ? 1.0 : 1.1 * rho;
+
+  int size = oracleSize(oracle);
+  double *z = malloc(count * sizeof(double));
+  double *pointwise = malloc((size_t) count * size * sizeof(double));
+  double *batch = malloc((size_t) count * size * sizeof(double));
+  int *pointwiseStatus = malloc(count * sizeof(int));
+  int *batchStatus = malloc(count * sizeof(int));
+  for (int p = 0; p < count; p++)
+    z[p] = bound * (p + 0.5) / count;
+
+  clock_t start = clock();
+  for (int p = 0; p < count; p++)
+    pointwiseStatus[p] = evaluateOracle(oracle, z[p], pointwise + (size_t) p * size);
+  double pointwiseTime = seconds(start);
+
+  start = clock();
+  int successes = evaluateOracleBatch(oracle, z, count, batch, batchStatus);
+  double batchTime = seconds(start);
+
+  // both should agree on which points are below the singularity, and on their values
+  int mismatches = 0;
+  double deviation = 0.0;
+  for (int p = 0; p < count; p++)
+  {
+    if (pointwiseStatus[p] != batchStatus[p])
+    {
+      mismatches++;
+      continue;
+    }
+    for (int i = 0; pointwiseStatus[p] == 0 && i < size; i++)
+    {
+      double a = pointwise[(size_t) p * size + i], b = batch[(size_t) p * size + i];
+      if (a != b)
+        deviation = fmax(deviation, fabs(a - b) / fmax(fabs(a), fabs(b)));
+    }
+  }
+
+  printf("%d statements, %d points in (0, %g), rho = %.15g\n", size, count, bound, rho);
+  printf("pointwise: %10.3f us/point\n", 1e6 * pointwiseTime / count);
+  printf("batch:     %10.3f us/point (%d lanes, speedup %.2f)\n",
+         1e6 * batchTime / count, oracleLanes(), pointwiseTime / batchTime);
+  printf("%d points below the singularity, %d disagreements, largest relative deviation %.3g\n",
+         successes, mismatches, deviation);
+
+  free(z);
+  free(pointwise);
+  free(batch);
+  free(pointwiseStatus);
+  free(batchStatus);
+  freeOracle(oracle);
+  freeGrammar(root);
+  return 0;
+}
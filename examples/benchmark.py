@@ -0,0 +1,48 @@
+# coding=utf-8
+
+#################################################################
+# BENCHMARK OF THE PYTHON WRAPPER
+#
+# The wrapper builds the dictionary of a grammar directly from its
+# abstract syntax tree. This compares it with what it used to do,
+# which was to produce the Json representation of the grammar and
+# run json.loads() on it (only the json.loads() part is timed here,
+# on the output of the standalone tool, so the comparison is
+# favourable to the old approach).
+#
+# Assuming the tool and the Python wrapper have been built, and the
+# working directory is the top-level directory of this project:
+#
+# $ python examples/benchmark.py tests/reluctantQPW1 20
+#
+#################################################################
+
+import json
+import subprocess
+import sys
+import timeit
+
+import combstruct2json
+
+
+def main():
+    filename = sys.argv[1] if len(sys.argv) > 1 else "tests/reluctantQPW1"
+    repeat = int(sys.argv[2]) if len(sys.argv) > 2 else 20
+
+    text = subprocess.check_output(["./combstruct2json", filename]).decode("utf-8")
+
+    # Both approaches should give the same dictionary.
+    if combstruct2json.read_file(filename) != json.loads(text):
+        sys.exit("error: read_file() and json.loads() disagree on %s" % filename)
+
+    direct = min(timeit.repeat(lambda: combstruct2json.read_file(filename), number=1, repeat=repeat))
+    loads = min(timeit.repeat(lambda: json.loads(text), number=1, repeat=repeat))
+
+    print("%s (%d bytes of Json), best of %d:" % (filename, len(text), repeat))
+    print("  read_file():               %8.2f ms" % (1000 * direct))
+    print("  json.loads() of the Json:  %8.2f ms" % (1000 * loads))
+    print("  speedup (parse included):  %8.2f x" % (loads / direct))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,68 @@
+# coding=utf-8
+
+#################################################################
+# CONCURRENCY TEST OF THE PYTHON WRAPPER
+#
+# The wrapper releases the global interpreter lock while it parses
+# a grammar, so that a pool of threads parses several grammars at
+# once. This parses the same batch of grammars with 1, 2, 4, ...
+# threads, checks that every thread gets the same result, and
+# reports the throughput and the speedup over a single thread,
+# which should grow linearly with the number of threads (up to the
+# number of processors, and to the share of the time spent building
+# the dictionaries, which needs the lock).
+#
+# Assuming the Python wrapper has been built, and the working
+# directory is the top-level directory of this project:
+#
+# $ python examples/concurrency.py 8
+#
+#################################################################
+
+import os
+import sys
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+import combstruct2json
+
+
+def synthetic_grammar(equations, terms):
+    """A grammar of the given number of equations, each a Union of products."""
+    lines = []
+    for i in range(equations):
+        products = ", ".join("Prod(Z, A%d, Sequence(A%d, card >= 2))" % ((i + k) % equations, (i * k) % equations)
+                             for k in range(terms))
+        lines.append("A%d = Union(Epsilon, %s)" % (i, products))
+    return ",\n".join(lines)
+
+
+def run(grammars, threads):
+    with ThreadPoolExecutor(max_workers=threads) as pool:
+        start = time.perf_counter()
+        results = list(pool.map(combstruct2json.loads, grammars))
+        return time.perf_counter() - start, results
+
+
+def main():
+    max_threads = int(sys.argv[1]) if len(sys.argv) > 1 else (os.cpu_count() or 1)
+    grammar = synthetic_grammar(500, 20)
+    grammars = [grammar] * (4 * max_threads)
+
+    base, expected = run(grammars, 1)
+    if any(result != expected[0] for result in expected):
+        sys.exit("error: inconsistent results")
+
+    print("%d grammars of %d bytes" % (len(grammars), len(grammar)))
+    print("threads  grammars/s  speedup")
+    threads = 1
+    while threads <= max_threads:
+        elapsed, results = run(grammars, threads)
+        if results != expected:
+            sys.exit("error: results differ with %d threads" % threads)
+        print("%7d  %10.1f  %7.2f" % (threads, len(grammars) / elapsed, base / elapsed))
+        threads *= 2
+
+
+if __name__ == "__main__":
+    main()
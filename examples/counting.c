@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../combstruct2json.h"
+
+
+
+/*****************************************************************
+ * COUNTING SEQUENCES
+ *
+ * This example counts the objects of each size up to N described
+ * by each statement of a grammar (see countGrammar()), modulo a
+ * prime (998244353 by default) or exactly (modulus 0), reporting
+ * the time taken and the last counts of each statement.
+ *
+ * Assuming the library and header have been built, and the
+ * working directory is the top-level directory of this project:
+ *
+ * $ gcc -O2 -o counting examples/counting.c -L. -lcombstruct2json -lm
+ * $ ./counting tests/cographs unlabelled 10000
+ * $ ./counting tests/reluctantQPW1 labelled 1000 0
+ *
+ *****************************************************************/
+
+double seconds(clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s FILE [labelled|unlabelled] [N] [modulus]\n", argv[0]);
+    return 2;
+  }
+  Grammar *root = readGrammar(argv[1]);
+  OracleType type = (argc > 2 && strcmp(argv[2], "labelled") == 0) ? LABELLED : UNLABELLED;
+  int size = (argc > 3) ? atoi(argv[3]) : 1000;
+  unsigned int modulus = (argc > 4) ? (unsigned int) strtoul(argv[4], NULL, 10) : 998244353;
+
+  clock_t start = clock();
+  Counts *counts = countGrammar(root, type, size, modulus);
+  double time = seconds(start);
+  if (counts == NULL)
+  {
+    printf("cannot count this grammar\n");
+    freeGrammar(root);
+    return 1;
+  }
+
+  if (modulus == 0)
+    printf("%d statements, exact counts up to size %d: %.3f s (%d primes, %d digits of 32 bits)\n",
+           counts->statements, size, time, counts->primes, counts->limbs);
+  else
+    printf("%d statements, counts modulo %u up to size %d: %.3f s\n",
+           counts->statements, modulus, size, time);
+
+  StatementList *Slist = (StatementList*) root->component;
+  Buffer *buffer = newBuffer();
+  for (int i = 0; i < counts->statements; i++)
+  {
+    bufferClear(buffer);
+    countsWriteDecimal(counts, i, size, buffer);
+    // exact counts may have thousands of digits
+    if (buffer->length > 60)
+      printf("%s: %.40s... (%zu digits)\n", Slist->components[i]->variable->name, buffer->data, buffer->length);
+    else
+      printf("%s: %s\n", Slist->components[i]->variable->name, buffer->data);
+  }
+
+  freeBuffer(buffer);
+  freeCounts(counts);
+  freeGrammar(root);
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../combstruct2json.h"
+
+
+
+/*****************************************************************
+ * BENCHMARK OF INCREMENTAL VERSUS FULL PARSING
+ *
+ * This example opens a grammar as a document (see newDocument())
+ * and edits it as an editor would on every keystroke: a letter
+ * is typed at the end of an identifier taken at random, and then
+ * removed. It reports the time taken per edit by editDocument(),
+ * which parses again only the statements that the edit touched,
+ * and by parsing the whole text again, and checks that both give
+ * the same grammar in the end.
+ *
+ * Assuming the library and header have been built, and the
+ * working directory is the top-level directory of this project:
+ *
+ * $ gcc -O2 -o document examples/document.c -L. -lcombstruct2json -lm
+ * $ ./document tests/reluctantQPW1 1000
+ *
+ *****************************************************************/
+
+double seconds(clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int isIdChar(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+/*
+  Returns the end of an identifier that starts with a capital letter and is followed by a
+  comma or a parenthesis, at or after the given offset (or the length of the text if there
+  is none).
+*/
+size_t findIdentifierEnd(const char* text, size_t length, size_t offset)
+{
+  for (size_t p = (offset > 0) ? offset : 1; p < length; p++)
+  {
+    if ((text[p] != ',' && text[p] != ')') || !isIdChar(text[p - 1]))
+      continue;
+    size_t q = p - 1;
+    while (q > 0 && isIdChar(text[q - 1]))
+      q--;
+    if (text[q] >= 'A' && text[q] <= 'Z') // not a number, nor card
+      return p;
+  }
+  return length;
+}
+
+int main(int argc, char* argv[])
+{
+  FILE* file = fopen(argv[1], "r");
+  if (file == NULL)
+  {
+    printf("could not open %s\n", argv[1]);
+    return 1;
+  }
+  fseek(file, 0, SEEK_END);
+  size_t length = ftell(file);
+  rewind(file);
+  char* text = malloc(length + 1);
+  length = fread(text, 1, length, file);
+  fclose(file);
+
+  int keystrokes = (argc > 2) ? atoi(argv[2]) : 1000;
+  srand(1);
+
+  Document* document = newDocument(text, length);
+  Grammar* grammar = documentGrammar(document);
+  if (grammar->type == ISERROR)
+  {
+    printf("%s\n", grammar->toString(grammar));
+    return 1;
+  }
+  int statements = ((StatementList*) grammar->component)->size;
+
+  long long int reparsed = 0, changed = 0;
+  clock_t start = clock();
+  for (int k = 0; k < keystrokes; k++)
+  {
+    size_t p = findIdentifierEnd(text, length, rand() % length);
+    if (p == length)
+      p = findIdentifierEnd(text, length, 0);
+    DocumentChange change;
+    editDocument(document, p, p, "x", 1, &change);
+    reparsed += change.inserted;
+    changed += change.symbolCount;
+    editDocument(document, p, p + 1, "", 0, &change);
+    reparsed += change.inserted;
+    changed += change.symbolCount;
+  }
+  double incrementalTime = seconds(start);
+
+  start = clock();
+  for (int k = 0; k < keystrokes; k++)
+    freeGrammar(readGrammarFromBuffer(text, length));
+  double fullTime = seconds(start);
+
+  Grammar* full = readGrammarFromBuffer(text, length);
+  char* expected = full->toJson(full);
+  grammar = documentGrammar(document);
+  char* found = grammar->toJson(grammar);
+  int same = (strcmp(expected, found) == 0);
+
+  printf("%d statements, %zu bytes, %d keystrokes (%d edits)\n", statements, length, keystrokes, 2 * keystrokes);
+  printf("incremental: %10.2f us/edit (%.2f statements parsed, %.2f symbols changed per edit)\n",
+         1e6 * incrementalTime / (2 * keystrokes), (double) reparsed / (2 * keystrokes), (double) changed / (2 * keystrokes));
+  printf("full:        %10.2f us/edit\n", 1e6 * fullTime / keystrokes);
+  printf("same grammar: %s\n", same ? "yes" : "NO");
+
+  free(expected);
+  free(found);
+  freeGrammar(full);
+  freeDocument(document);
+  free(text);
+  return !same;
+}
@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../combstruct2json.h"
+
+
+
+/*****************************************************************
+ * BENCHMARK OF THE CLEANUP AFTER A PARSING ERROR
+ *
+ * This example generates a grammar of many statements (100,000
+ * by default), each a Union of a few products, and parses it
+ * twice: once as it is, and once with a syntax error at the very
+ * end, so that the whole abstract syntax tree has been built when
+ * the error is found, and must be discarded. The nodes are
+ * allocated from an arena, so that discarding them takes time
+ * proportional to the number of its chunks rather than to the
+ * number of nodes, and both parses should take about as long.
+ *
+ * Assuming the library and header have been built, and the
+ * working directory is the top-level directory of this project:
+ *
+ * $ gcc -O2 -o errorCleanup examples/errorCleanup.c -L. -lcombstruct2json -lm
+ * $ ./errorCleanup 100000
+ *
+ *****************************************************************/
+
+double seconds(clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+/*
+  Writes a grammar of the given number of statements, followed by a syntax error if error
+  is not 0, to a new temporary file whose name is stored in path (of at least 32 bytes).
+  Returns the size of the file, or -1 if it could not be created.
+*/
+long generateGrammar(int statements, int error, char* path)
+{
+  strcpy(path, "/tmp/errorCleanupXXXXXX");
+  int fd = mkstemp(path);
+  FILE* file = (fd < 0) ? NULL : fdopen(fd, "w");
+  if (file == NULL)
+    return -1;
+
+  for (int i = 0; i < statements; i++)
+  {
+    int a = (int) (((long long int) i * 7919 + 1) % statements);
+    int b = (int) (((long long int) i * 104729 + 3) % statements);
+    fprintf(file, "%sC%d = Union(Epsilon, Prod(Atom, C%d), Prod(Atom, Atom, Sequence(C%d)))",
+            (i > 0) ? ",\n" : "", i, a, b);
+  }
+  if (error)
+    fprintf(file, ",\nC = Prod(Atom,"); // the parser only sees the error at the end
+  fprintf(file, "\n");
+
+  long size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+int main(int argc, char* argv[])
+{
+  int statements = (argc > 1) ? atoi(argv[1]) : 100000;
+  int rounds = (argc > 2) ? atoi(argv[2]) : 5;
+
+  char valid[32], error[32];
+  long validSize = generateGrammar(statements, 0, valid);
+  long errorSize = generateGrammar(statements, 1, error);
+  if (validSize < 0 || errorSize < 0)
+  {
+    printf("could not write the grammars\n");
+    return 1;
+  }
+
+  clock_t start = clock();
+  for (int r = 0; r < rounds; r++)
+  {
+    Grammar* root = readGrammar(valid);
+    if (root->type == ISERROR)
+    {
+      printf("%s\n", root->toString(root));
+      return 1;
+    }
+    freeGrammar(root);
+  }
+  double validTime = seconds(start) / rounds;
+
+  int line = 0;
+  start = clock();
+  for (int r = 0; r < rounds; r++)
+  {
+    Grammar* root = readGrammar(error); // the error is also printed to stderr
+    if (root->type != ISERROR)
+    {
+      printf("the trailing error was not found\n");
+      return 1;
+    }
+    line = ((Error*) root->component)->line;
+    freeGrammar(root);
+  }
+  double errorTime = seconds(start) / rounds;
+
+  printf("%d statements, %ld bytes, %d rounds\n", statements, errorSize, rounds);
+  printf("valid grammar, parsed and freed: %8.3f s\n", validTime);
+  printf("error at line %d, parsed and cleaned up: %8.3f s\n", line, errorTime);
+
+  unlink(valid);
+  unlink(error);
+  return 0;
+}
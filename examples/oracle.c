@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "../combstruct2json.h"
+
+
+
+/*****************************************************************
+ * GENERATING FUNCTION ORACLE
+ *
+ * This example compiles a grammar into an oracle (see
+ * compileOracle()), finds the singularity of its system by
+ * bisection, and evaluates the system a number of times at a
+ * point below the singularity (90% of it, or the point given),
+ * reporting the time taken by each step and the values of the
+ * statements.
+ *
+ * Assuming the library and header have been built, and the
+ * working directory is the top-level directory of this project:
+ *
+ * $ gcc -O2 -o oracle examples/oracle.c -L. -lcombstruct2json -lm
+ * $ ./oracle tests/reluctantQPW1 unlabelled
+ * $ ./oracle tests/cographs unlabelled 0.2
+ *
+ *****************************************************************/
+
+double seconds(clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s FILE [labelled|unlabelled] [z]\n", argv[0]);
+    return 2;
+  }
+  Grammar *root = readGrammar(argv[1]);
+  OracleType type = (argc > 2 && strcmp(argv[2], "labelled") == 0) ? LABELLED : UNLABELLED;
+  int rounds = 100;
+
+  clock_t start = clock();
+  Oracle *oracle = compileOracle(root, type);
+  double compileTime = seconds(start);
+  if (oracle == NULL)
+  {
+    printf("cannot compile an oracle for this grammar\n");
+    return 1;
+  }
+
+  start = clock();
+  double rho = oracleSingularity(oracle, 1e-12);
+  double singularityTime = seconds(start);
+  double z = (argc > 3) ? atof(argv[3]) : (isinf(rho) ? 1.0 : 0.9 * rho);
+
+  double *values = malloc((oracleSize(oracle) + 1) * sizeof(double));
+  int status = 0;
+  start = clock();
+  for (int r = 0; r < rounds; r++)
+    status |= evaluateOracle(oracle, z, values);
+  double evaluationTime = seconds(start) / rounds;
+
+  printf("compilation: %10.3f ms\n", 1e3 * compileTime);
+  printf("singularity: %10.3f ms (rho = %.15g)\n", 1e3 * singularityTime, rho);
+  printf("evaluation:  %10.3f ms (z = %.15g)\n", 1e3 * evaluationTime, z);
+  if (status != 0)
+  {
+    printf("z is beyond the singularity\n");
+    return 1;
+  }
+
+  StatementList *Slist = (StatementList*) root->component;
+  for (int i = 0; i < Slist->size; i++)
+    printf("%s = %.15g\n", Slist->components[i]->variable->name, values[i]);
+
+  free(values);
+  freeOracle(oracle);
+  freeGrammar(root);
+  return 0;
+}
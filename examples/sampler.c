@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "../combstruct2json.h"
+
+
+
+/*****************************************************************
+ * BOLTZMANN SAMPLING
+ *
+ * This example compiles a Boltzmann sampler for the first
+ * statement of a grammar (see compileSampler()), at a parameter
+ * close to the singularity of the system, and draws objects of
+ * size within 10% of N, reporting the time taken to compile the
+ * sampler, the number of atoms generated per second (counting
+ * rejected objects), and the number of objects drawn for each
+ * one kept.
+ *
+ * Assuming the library and header have been built, and the
+ * working directory is the top-level directory of this project:
+ *
+ * $ gcc -O2 -o sampler examples/sampler.c -L. -lcombstruct2json -lm
+ * $ ./sampler tests/cographs unlabelled 1000
+ * $ ./sampler tests/reluctantQPW1 labelled 10000 100
+ *
+ *****************************************************************/
+
+double seconds(clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s FILE [labelled|unlabelled] [N] [draws] [seed]\n", argv[0]);
+    return 2;
+  }
+  Grammar *root = readGrammar(argv[1]);
+  OracleType type = (argc > 2 && strcmp(argv[2], "labelled") == 0) ? LABELLED : UNLABELLED;
+  int size = (argc > 3) ? atoi(argv[3]) : 1000;
+  int draws = (argc > 4) ? atoi(argv[4]) : 1000;
+  unsigned long long int seed = (argc > 5) ? strtoull(argv[5], NULL, 10) : 0;
+
+  Oracle *oracle = compileOracle(root, type);
+  double rho = (oracle != NULL) ? oracleSingularity(oracle, 1e-12) : 0.0;
+  freeOracle(oracle);
+  if (!(rho > 0.0) || isinf(rho))
+  {
+    printf("cannot find the singularity of this grammar\n");
+    freeGrammar(root);
+    return 1;
+  }
+
+  // the expected size grows as the parameter gets closer to the singularity
+  double z = rho * (1.0 - 1.0 / size);
+  clock_t start = clock();
+  Sampler *sampler = compileSampler(root, type, z, NULL);
+  double time = seconds(start);
+  if (sampler == NULL)
+  {
+    printf("cannot sample this grammar\n");
+    freeGrammar(root);
+    return 1;
+  }
+  seedSampler(sampler, seed);
+  printf("singularity %.12g, sampler compiled at %.12g in %.3f ms\n", rho, z, 1000 * time);
+
+  Sample sample;
+  long long int drawn = 0, attempts = 0, nodes = 0;
+  int kept = 0;
+  start = clock();
+  for (int i = 0; i < draws; i++)
+  {
+    if (drawSample(sampler, 0, size - size / 10, size + size / 10, 1000000, &sample) < 0)
+      break;
+    kept++;
+    drawn += sample.drawn;
+    nodes += sample.length;
+    attempts += sample.attempts;
+  }
+  time = seconds(start);
+
+  printf("%d objects of size %d to %d (%.1f nodes each) in %.3f s: %.1f draws per object, %.2f million atoms per second\n",
+         kept, size - size / 10, size + size / 10, kept ? (double) nodes / kept : 0.0, time,
+         kept ? (double) attempts / kept : 0.0, drawn / time / 1e6);
+
+  freeSampler(sampler);
+  freeGrammar(root);
+  return 0;
+}
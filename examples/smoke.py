@@ -0,0 +1,53 @@
+# coding=utf-8
+
+#################################################################
+# SMOKE TEST OF THE PYTHON WRAPPER
+#
+# Imports the module (which fails if a function of the library is
+# missing from the sources of the extension, see setup.py), and
+# calls each of its functions once, on the grammars of the folder
+# tests.
+#
+# Assuming the Python wrapper has been built in place, and the
+# working directory is the top-level directory of this project:
+#
+# $ PYTHONPATH=. python examples/smoke.py
+#
+# which is what make check does.
+#
+#################################################################
+
+import combstruct2json
+
+
+def main():
+    grammar = combstruct2json.read_file("tests/cographs")
+    assert set(grammar.keys()) == {"G", "Co", "Ge", "Gc", "Sc", "C", "v"}, grammar.keys()
+
+    grammar = combstruct2json.loads("A = Prod(Atom, Sequence(A))")
+    assert list(grammar.keys()) == ["A"], grammar
+
+    flat = combstruct2json.read_flat("tests/reluctantQPW1")
+    assert len(memoryview(flat.ops)) > 0
+    flat = combstruct2json.loads_flat("A = Union(Epsilon, Prod(Atom, A, A))")
+    assert len(memoryview(flat.roots)) == 1
+
+    analysis = combstruct2json.analyze_file("tests/cographs")
+    assert analysis["well-founded"], analysis
+    analysis = combstruct2json.analyze_string("A = Prod(Atom, A)")
+    assert not analysis["well-founded"], analysis
+
+    # every function gives the dictionary of the error of a grammar that cannot be parsed
+    for function in (combstruct2json.loads, combstruct2json.loads_flat, combstruct2json.analyze_string):
+        error = function("A = Prod(Atom,")
+        assert error["type"] == "error" and error["source"] == "parser", error
+    for function in (combstruct2json.read_file, combstruct2json.read_flat, combstruct2json.analyze_file,
+                     combstruct2json.read_binary):
+        error = function("tests/missing")
+        assert error["type"] == "error" and error["source"] == "input", error
+
+    print("ok")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../combstruct2json.h"
+
+
+
+/*****************************************************************
+ * STRESS TEST OF THE REENTRANT PARSER
+ *
+ * This example parses every grammar of a folder (tests/ecs by
+ * default) once in the main thread, to get the reference Json
+ * representation of each, and then from many threads at once (32
+ * by default), each thread parsing every grammar a number of
+ * times with its own ParseContext, in a different order. Every
+ * result is compared with its reference, so that any state shared
+ * between threads by the parser or the lexer shows up as a
+ * mismatch (or as a crash, or a report of a thread sanitizer).
+ *
+ * Assuming the library and header have been built, and the
+ * working directory is the top-level directory of this project:
+ *
+ * $ gcc -O2 -pthread -o threads examples/threads.c -L. -lcombstruct2json -lm
+ * $ ./threads tests/ecs 32 20
+ *
+ *****************************************************************/
+
+typedef struct Work_s
+{
+  char** paths;
+  char** expected; // Json representation of each grammar, parsed by the main thread
+  int count;
+  int rounds;
+  int thread;
+  int mismatches; // results of this thread that differ from the reference
+} Work;
+
+double elapsed(struct timespec start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start.tv_sec) + 1e-9 * (now.tv_nsec - start.tv_nsec);
+}
+
+char* parseToJson(ParseContext* ctx, const char* path)
+{
+  Grammar* root = readGrammarCtx(ctx, (char*) path);
+  char* json = root->toJson(root);
+  freeGrammar(root);
+  return json;
+}
+
+void* work(void* argument)
+{
+  Work* W = (Work*) argument;
+  ParseContext ctx;
+
+  for (int r = 0; r < W->rounds; r++)
+    for (int k = 0; k < W->count; k++)
+    {
+      int i = (k + W->thread * 7 + r) % W->count; // threads do not go through the files together
+      char* json = parseToJson(&ctx, W->paths[i]);
+      if (strcmp(json, W->expected[i]) != 0)
+        W->mismatches++;
+      free(json);
+    }
+  return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+  const char* folder = (argc > 1) ? argv[1] : "tests/ecs";
+  int threads = (argc > 2) ? atoi(argv[2]) : 32;
+  int rounds = (argc > 3) ? atoi(argv[3]) : 20;
+
+  DIR* dir = opendir(folder);
+  if (dir == NULL)
+  {
+    printf("could not open %s\n", folder);
+    return 1;
+  }
+  int count = 0, space = 16;
+  char** paths = malloc(space * sizeof(char*));
+  for (struct dirent* entry = readdir(dir); entry != NULL; entry = readdir(dir))
+  {
+    if (entry->d_name[0] == '.')
+      continue;
+    if (count == space)
+      paths = realloc(paths, (space *= 2) * sizeof(char*));
+    paths[count] = malloc(strlen(folder) + strlen(entry->d_name) + 2);
+    sprintf(paths[count++], "%s/%s", folder, entry->d_name);
+  }
+  closedir(dir);
+  if (count == 0)
+  {
+    printf("no grammar in %s\n", folder);
+    return 1;
+  }
+
+  ParseContext ctx;
+  char** expected = malloc(count * sizeof(char*));
+  for (int i = 0; i < count; i++)
+    expected[i] = parseToJson(&ctx, paths[i]);
+
+  Work* works = malloc(threads * sizeof(Work));
+  pthread_t* ids = malloc(threads * sizeof(pthread_t));
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int t = 0; t < threads; t++)
+  {
+    works[t] = (Work) {paths, expected, count, rounds, t, 0};
+    pthread_create(&ids[t], NULL, work, &works[t]);
+  }
+  int mismatches = 0;
+  for (int t = 0; t < threads; t++)
+  {
+    pthread_join(ids[t], NULL);
+    mismatches += works[t].mismatches;
+  }
+  double time = elapsed(start);
+
+  long long int parses = (long long int) threads * rounds * count;
+  printf("%d grammars, %d threads, %d rounds: %lld parses in %.3f s (%.0f per second)\n",
+         count, threads, rounds, parses, time, parses / time);
+  printf("mismatches: %d\n", mismatches);
+
+  for (int i = 0; i < count; i++)
+  {
+    free(paths[i]);
+    free(expected[i]);
+  }
+  free(paths);
+  free(expected);
+  free(works);
+  free(ids);
+  return mismatches != 0;
+}
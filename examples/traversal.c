@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../combstruct2json.h"
+
+
+
+/*****************************************************************
+ * BENCHMARK OF ABSTRACT TREE VERSUS FLAT GRAMMAR TRAVERSAL
+ *
+ * This example walks every expression of a grammar a number of
+ * times, once through the abstract syntax tree (following
+ * pointers) and once through its flat representation (see
+ * flattenGrammar()), and reports the time taken per node by
+ * each traversal. Both compute the same checksum, so that the
+ * results can be checked against each other.
+ *
+ * Assuming the library and header have been built, and the
+ * working directory is the top-level directory of this project:
+ *
+ * $ gcc -O2 -o traversal examples/traversal.c -L. -lcombstruct2json -lm
+ * $ ./traversal tests/reluctantQPW1 1000
+ *
+ *****************************************************************/
+
+long long int walkExpression(const Expression* E)
+{
+  long long int sum = 1 + E->restriction + (E->restriction == NONE ? 0 : E->limit);
+
+  switch (E->type)
+  {
+  case (ID):
+    return sum + ((Id*) E->component)->symbol;
+
+  case (UNION):
+  case (PROD):
+  case (SUBST): ;
+    ExpressionList* Elist = (ExpressionList*) E->component;
+    for (int i = 0; i < Elist->size; i++)
+      sum += walkExpression(Elist->components[i]);
+    return sum;
+
+  case (SET):
+  case (POWERSET):
+  case (SEQUENCE):
+  case (CYCLE):
+    return sum + walkExpression((Expression*) E->component);
+
+  default:
+    return sum;
+  }
+}
+
+long long int walkFlatExpression(const FlatGrammar* flat, int node)
+{
+  const FlatNode* N = &flat->nodes[node];
+  long long int sum = 1 + N->restriction + flatLimit(flat, node);
+
+  if (N->op == FLAT_ID)
+    return sum + N->value;
+
+  for (int k = 0, c = flatFirstChild(node); k < N->children; k++, c = flatNextSibling(flat, c))
+    sum += walkFlatExpression(flat, c);
+  return sum;
+}
+
+double seconds(clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char* argv[])
+{
+  Grammar *root = readGrammar(argv[1]);
+  int rounds = (argc > 2) ? atoi(argv[2]) : 100;
+
+  FlatGrammar *flat = flattenGrammar(root);
+  if (flat == NULL)
+  {
+    printf("%s\n", root->toString(root));
+    return 1;
+  }
+
+  StatementList *Slist = (StatementList*) root->component;
+  long long int treeSum = 0, flatSum = 0;
+
+  clock_t start = clock();
+  for (int r = 0; r < rounds; r++)
+    for (int i = 0; i < Slist->size; i++)
+      treeSum += walkExpression(Slist->components[i]->expression);
+  double treeTime = seconds(start);
+
+  start = clock();
+  for (int r = 0; r < rounds; r++)
+    for (int i = 0; i < flat->statements; i++)
+      flatSum += walkFlatExpression(flat, flat->roots[i]);
+  double flatTime = seconds(start);
+
+  double nodes = (double) flat->size * rounds;
+  printf("%d statements, %d nodes (%zu bytes each), %d rounds\n",
+         flat->statements, flat->size, sizeof(FlatNode), rounds);
+  printf("tree: %8.2f ns/node (checksum %lld)\n", 1e9 * treeTime / nodes, treeSum);
+  printf("flat: %8.2f ns/node (checksum %lld)\n", 1e9 * flatTime / nodes, flatSum);
+
+  freeFlatGrammar(flat);
+  freeGrammar(root);
+  return 0;
+}
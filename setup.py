@@ -10,7 +10,10 @@ c2j_ext_link = Extension("combstruct2json",
 # Compile the wrapper by recompiling everything.
 c2j_ext = Extension("combstruct2json",
                     ["src/pywrapper.c", "parser.tab.c", "lex.yy.c",
-                    "src/absyn.c", "src/node.c"],
+                    "src/absyn.c", "src/arena.c", "src/buffer.c",
+                    "src/symbols.c", "src/graph.c", "src/share.c", "src/flat.c",
+                    "src/binary.c", "src/analysis.c"],
+                    libraries=["m"],
 
                     extra_compile_args=[
                         "-Wno-strict-prototypes",
@@ -30,13 +33,11 @@ setup(
     author_email = "lumbroso@cs.princeton.edu",
     url = "https://github.com/jlumbroso/combstruct2json",
     keywords = ['combinatorics'],
+    python_requires = '>=3.5',
     license = 'LGPLv3',
     classifiers = [
-        'Programming Language :: Python :: 2',
-        'Programming Language :: Python :: 2.7',
         'Programming Language :: Python :: 3',
-        'Programming Language :: Python :: 3.4',
-        'Programming Language :: Python :: 3.5',
+        'Programming Language :: Python :: 3 :: Only',
         'Topic :: Scientific/Engineering :: Mathematics',
         'Topic :: Software Development :: Libraries :: Python Modules',
         'Intended Audience :: Developers',
@@ -2,15 +2,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <sys/mman.h>
 #include "absyn.h"
+#include "share.h"
 
 #define ENOUGH 36 // should be enough to hold constructor names and small expressions
 
-extern NodeST* ST; // Symbol Table with all allocated nodes (for cleanup on parse error)
-
 /************************************* Functions *************************************/
 
-ExpressionList* addExpressionToList(Expression* expression, ExpressionList* list)
+ExpressionList* addExpressionToList(Arena* arena, Expression* expression, ExpressionList* list)
 {
   int size = list->size;
   int space = list->space;
@@ -18,7 +18,7 @@ ExpressionList* addExpressionToList(Expression* expression, ExpressionList* list
 
   if (size >= space) { // grow (no need to shrink as list always grows)
     space = 2 * size + 1;
-    list->components = (Expression**) realloc(components, space * sizeof(Expression*));
+    list->components = (Expression**) arenaGrow(arena, components, size * sizeof(Expression*), space * sizeof(Expression*));
     list->space = space;
   }
 
@@ -27,7 +27,7 @@ ExpressionList* addExpressionToList(Expression* expression, ExpressionList* list
   return list;
 }
 
-StatementList* addStatementToList(Statement* statement, StatementList* list)
+StatementList* addStatementToList(Arena* arena, Statement* statement, StatementList* list)
 {
   int size = list->size;
   int space = list->space;
@@ -35,7 +35,7 @@ StatementList* addStatementToList(Statement* statement, StatementList* list)
 
   if (size >= space) { // grow (no need to shrink as list always grows)    
     space = 2 * size + 1;
-    list->components = (Statement**) realloc(components, space * sizeof(Statement*));
+    list->components = (Statement**) arenaGrow(arena, components, size * sizeof(Statement*), space * sizeof(Statement*));
     list->space = space;
   }
 
@@ -45,154 +45,19 @@ StatementList* addStatementToList(Statement* statement, StatementList* list)
 }
 
 /*
-  Helper function that converts token types to the corresponding node types.
+  Free the whole abstract syntax tree. Every node, string and array of the tree
+  was allocated from the arena of the grammar, so this runs in time proportional
+  to the number of chunks of the arena.
 */
-NodeType tokenToNode(enum yytokentype t)
-{
-  if (t == EPSILON || t == ATOM || t == Z)
-    return UNIT_N;
-  else if (t == ID)
-    return ID_N;
-  else if (t == UNION || t == PROD || t == SUBST)
-    return EXPLIST_N;
-  else if (t == SET || t == POWERSET || t == SEQUENCE || t == CYCLE)
-    return EXP_N;
-  else {
-    fprintf(stderr, "\nError: token is not a node!\n");
-    return UNIT_N;
-  }
-}
-
-/*
-  Free the given node, but not its children. Also takes the corresponding node
-  out of the ST.
-*/ 
-void freeNode(void* node, NodeType type)
-{
-  key_t key; // will need it to take node out of ST later
-
-  switch (type) {
-  case (UNIT_N): ;
-    Unit* U = (Unit*) node;
-    key = U->key;
-    free(U);
-    break;
-  case (ID_N): ;
-    Id* id = (Id*) node;
-    key = id->key;
-    free(id->name);
-    free(id);
-    break;
-  case (EXP_N): ;
-    Expression* E = (Expression*) node;
-    key = E->key;
-    free(E);
-    break;
-  case (EXPLIST_N): ;
-    ExpressionList* Elist = (ExpressionList*) node;
-    key = Elist->key;
-    free(Elist->components);
-    free(Elist);
-    break;
-  case (STMT_N): ;
-    Statement* S = (Statement*) node;
-    key = S->key;
-    free(S);
-    break;
-  case (STMTLIST_N): ;
-    StatementList* Slist = (StatementList*) node;
-    key = Slist->key;
-    free(Slist->components);
-    free(Slist);
-    break;
-  case (ERROR_N): ;
-    Error* Err = (Error*) node;
-    key = Err->key;
-    free(Err->message);
-    free(Err);
-    break;
-  case (GRAMMAR_N): ;
-    Grammar* G = (Grammar*) node;
-    key = G->key;
-    free(G);
-    break;
-  }
-
-  removeNode(key, ST); // node has been deallocated
-}
+void freeGrammar(Grammar* grammar)
+{
+  char* input = grammar->input; // the grammar itself is in the arena
+  size_t inputSize = grammar->inputSize;
 
-/*
-  Free the abstract syntax subtree with root node. Also takes the corresponding nodes
-  out of the ST.
-*/ 
-void freeNodeRecursive(void* node, NodeType type)
-{
-  key_t key; // will need it to take node out of ST later
-
-  switch (type) {
-  case (UNIT_N): ;
-    Unit* U = (Unit*) node;
-    key = U->key;
-    free(U);
-    break;
-  case (ID_N): ;
-    Id* id = (Id*) node;
-    key = id->key;
-    free(id->name);
-    free(id);
-    break;
-  case (EXP_N): ;
-    Expression* E = (Expression*) node;
-    key = E->key;
-    freeNodeRecursive(E->component, tokenToNode(E->type));
-    free(E);
-    break;
-  case (EXPLIST_N): ;
-    ExpressionList* Elist = (ExpressionList*) node;
-    key = Elist->key;
-    int size = Elist->size;
-    for (int i = 0; i < size; i++) {
-      freeNodeRecursive(Elist->components[i], EXP_N);
-    }
-    free(Elist->components);
-    free(Elist);
-    break;
-  case (STMT_N): ;
-    Statement* S = (Statement*) node;
-    key = S->key;
-    freeNodeRecursive(S->variable, ID_N);
-    freeNodeRecursive(S->expression, EXP_N);
-    free(S);
-    break;
-  case (STMTLIST_N): ;
-    StatementList* Slist = (StatementList*) node;
-    key = Slist->key;
-    size = Slist->size;
-    for (int i = 0; i < size; i++) {
-      freeNodeRecursive(Slist->components[i], STMT_N);
-    }
-    free(Slist->components);
-    free(Slist);
-    break;
-  case (ERROR_N): ;
-    Error* Err = (Error*) node;
-    key = Err->key;
-    free(Err->message);
-    free(Err);
-    break;
-  case (GRAMMAR_N): ;
-    Grammar* G = (Grammar*) node;
-    key = G->key;
-    if (G->type == ISERROR) {
-      freeNodeRecursive(G->component, ERROR_N);
-    } else {
-      freeNodeRecursive(G->component, STMTLIST_N);
-    }
-    free(G);
-    break;
+  freeArena(grammar->arena);
+  if (input != NULL) {
+    munmap(input, inputSize);
   }
-
-  removeNode(key, ST); // node has been deallocated
 }
 
 /********************************** String Representations **********************************/
@@ -449,6 +314,8 @@ char* errorToString(const Error* error)
   char* str = (char*) malloc(sizeof(char) * (strlen(error->message) + strlen(line) + ENOUGH));
   if (error->type == LEXER) {
     sprintf(str, "Lexer Error (l. %s): %s", line, error->message);
+  } else if (error->type == INPUT) {
+    sprintf(str, "Input Error: %s", error->message);
   } else {
     sprintf(str, "Parser Error (l. %s): %s", line, error->message);
   }
@@ -470,416 +337,426 @@ char* grammarToString(const Grammar* grammar)
 
 /********************************** Json Representations **********************************/
 
-#define MAKE_JSON_ERROR(msg) (strdup("{\n  \"type\": \"error\",\n  \"source\": \"json-export\",\n  \"msg\": \"" msg "\"\n}"))
-
 /*
-  Helper function for converting ints to jsons.
+  The Json representation is written in a single pass over the abstract syntax tree,
+  into one growable buffer (which may be attached to a file), so that the cost is
+  linear in the size of the output. The toJson() functions are thin wrappers that
+  return the content of an in-memory buffer.
 */
-// FIXME: fix below
-char* intToJson(long long int a)
-{
-  int sign = (a >= 0) ? 1 : -1;
-  long long int abs = a * sign;
-  char* str = (char*) malloc(sizeof(char) * ((int) ceil(log10(abs + 1)) + 2)); // +2: sign and  NULL terminator
 
-  if (sign > 0)
-    sprintf(str, "%lld", abs);
-  else
-    sprintf(str, "-%lld", abs);
-
-  return str;
-}
+#define JSON_ERROR(msg) ("{ \"type\": \"error\", \"source\": \"json-export\", \"msg\": \"" msg "\" }")
+#define APPEND(buffer, literal) (bufferAppend((buffer), (literal), sizeof(literal) - 1)) // literal strings only
 
 /*
-  Helper function for getting json representations of restrictions.
+  Helper function for writing json representations of restrictions.
 */
-char* restrictionToJson(Restriction rest, long long limit)
+void restrictionWriteJson(Restriction rest, long long limit, Buffer* buffer)
 {
-  // Special case treated separately because it requires no mem allocation.
-  char* str = (char*) malloc(sizeof(char));
   switch (rest) {
   case (NONE):
-    sprintf(str, "");
-    return str;
-  default:
-      free(str);
-  }
-  
-  char* val = intToJson(limit); 
-  str = (char*) malloc(sizeof(char) * (strlen(val) + 2*ENOUGH));
-  
-  switch (rest) {
+    return;
   case (LESS):
-    sprintf(str, ", \"restriction\": \"card <= %s\"", val);
-    return str;
+    APPEND(buffer, ", \"restriction\": \"card <= ");
+    break;
   case (EQUAL):
-    sprintf(str, ", \"restriction\": \"card = %s\"", val);
-    return str;
+    APPEND(buffer, ", \"restriction\": \"card = ");
+    break;
   case (GREATER):
-    sprintf(str, ", \"restriction\": \"card >= %s\"", val);
-    return str;
+    APPEND(buffer, ", \"restriction\": \"card >= ");
+    break;
   default:
-    //sprintf(str, "\n{ \"error\": \"restriction is invalid!\" }\n");
-    return MAKE_JSON_ERROR("restriction is invalid.");
+    APPEND(buffer, JSON_ERROR("restriction is invalid."));
+    return;
   }
+  bufferAppendInt(buffer, limit);
+  APPEND(buffer, "\"");
 }
 
-/* 
-   Json representation of Units. Always encapsulates json literals in malloc'ed char arrays.
-*/ 
-// DONE:
-char* unitToJson(const Unit* U)
+void unitWriteJson(const Unit* U, Buffer* buffer)
 {
-  /* NOTE: This is how you would dynamically allocate these strings:
-
-  char* str = (char*) malloc(sizeof(char) * ENOUGH);
-  sprintf(str, "{ \"type\": \"unit\", \"unit\": \"Atom\" }");
-  return str;
-
-  But since these are literals we can also just return them, they
-  are guaranteed to be located in some valid memory address.
-  ******************************************************************/
-
   switch (U->type) {
   case (ATOM):
-    return strdup("{ \"type\": \"unit\", \"unit\": \"Atom\" }");
+    APPEND(buffer, "{ \"type\": \"unit\", \"unit\": \"Atom\" }");
+    return;
   case (EPSILON):
-    return strdup("{ \"type\": \"unit\", \"unit\": \"Epsilon\" }");
+    APPEND(buffer, "{ \"type\": \"unit\", \"unit\": \"Epsilon\" }");
+    return;
   case (Z):
-    return strdup("{ \"type\": \"id\", \"id\": \"Z\" }");
+    APPEND(buffer, "{ \"type\": \"id\", \"id\": \"Z\" }");
+    return;
   default:
-    //return strdup("\n{ \"error\": \"Token is not a unit!\" }\n");
-    return MAKE_JSON_ERROR("Token is not a unit.");
-  } 
+    APPEND(buffer, JSON_ERROR("Token is not a unit."));
+  }
 }
 
 /*
-  Json representation of Ids. We avoid simply returning A->name to enforce the philosophy that
-  all jsons are owned by this module, so we can (and should) free the returned jsons.
+  The Json representation of an Id is its bare name (it is quoted by the caller).
 */
-// FIXME: fix below
-char* idToJson(const Id* A)
+void idWriteJson(const Id* A, Buffer* buffer)
 {
-    char* str = (char*) malloc(sizeof(char) * (strlen(A->name) + 1)); // NULL terminator
-  sprintf(str, "%s", A->name);
-  return str;
+  bufferAppendString(buffer, A->name);
 }
 
 /*
-  Json representation of expressions.
+  Texts of the shared expressions of a grammar (see shareGrammar()) whose Json
+  representation was written already: the text of an expression used more than once is
+  kept the first time it is written, and copied afterwards, so that each distinct
+  expression is visited once.
 */
-// DONE:
-char* expressionToJson(const Expression* E)
+typedef struct JsonCache_s
 {
-  
+  const Sharing* sharing;
+  Buffer* texts; // texts of the expressions written so far
+  size_t* offsets; // offsets[i] is the offset of the text of the i-th distinct expression in texts
+  size_t* lengths; // lengths[i] is its length, or NOT_WRITTEN
+} JsonCache;
+
+#define NOT_WRITTEN ((size_t) -1)
+
+static void writeExpression(const Expression* E, Buffer* buffer, JsonCache* cache);
 
+/*
+  Helper function that writes the Json representation of an expression, from the cache if
+  it is shared.
+*/
+static void writeShared(const Expression* E, Buffer* buffer, JsonCache* cache)
+{
+  int leaf = (E->type == ATOM || E->type == EPSILON || E->type == Z || E->type == ID);
+  int i = (cache != NULL && !leaf) ? sharingIndex(cache->sharing, E) : -1;
+  if (i < 0 || cache->sharing->uses[i] < 2) { // leaves are cheaper to write than to copy
+    writeExpression(E, buffer, cache);
+    return;
+  }
+  if (cache->lengths[i] == NOT_WRITTEN) {
+    Buffer* text = newBuffer();
+    writeExpression(E, text, cache);
+    cache->offsets[i] = cache->texts->length;
+    cache->lengths[i] = text->length;
+    bufferAppend(cache->texts, text->data, text->length);
+    freeBuffer(text);
+  }
+  bufferAppend(buffer, cache->texts->data + cache->offsets[i], cache->lengths[i]);
+}
+
+static void writeExpressionList(const ExpressionList* Elist, Buffer* buffer, JsonCache* cache)
+{
+  APPEND(buffer, "[ ");
+  writeShared(Elist->components[0], buffer, cache); // there is always a first element
+  for (int i = 1; i < Elist->size; i++) { // add other elements, separating with comma
+    APPEND(buffer, ", ");
+    writeShared(Elist->components[i], buffer, cache);
+  }
+  APPEND(buffer, " ]");
+}
+
+static void writeExpression(const Expression* E, Buffer* buffer, JsonCache* cache)
+{
   // type is single entity
   switch (E->type) {
   case (ATOM):
-    //sprintf(str, "{ \"type\": \"unit\", \"unit\": \"Atom\" }");
-    return strdup("{ \"type\": \"unit\", \"unit\": \"Atom\" }");
+    APPEND(buffer, "{ \"type\": \"unit\", \"unit\": \"Atom\" }");
+    return;
   case (EPSILON):
-    //sprintf(str, "{ \"type\": \"unit\", \"unit\": \"Epsilon\" }");
-    return strdup("{ \"type\": \"unit\", \"unit\": \"Epsilon\" }");
+    APPEND(buffer, "{ \"type\": \"unit\", \"unit\": \"Epsilon\" }");
+    return;
   case (Z):
-    //sprintf(str, "{ \"id\": \"Z\" }"); // Not sure about this one (FIXME: Make it an alias)
-    return strdup("{ \"type\": \"id\", \"id\": \"Z\" }");
-  case (ID): ;
-    //free(str);
-    Id* id = (Id*) E->component;
-    char *subexp = id->toJson(id);
-    char *str = (char*) malloc(sizeof(char) * (strlen(subexp) + 29)); // + 13
-    sprintf(str, "{ \"type\": \"id\", \"id\": \"%s\" }", subexp);
-    free(subexp);
-    return str;
+    APPEND(buffer, "{ \"type\": \"id\", \"id\": \"Z\" }");
+    return;
+  case (ID):
+    APPEND(buffer, "{ \"type\": \"id\", \"id\": \"");
+    idWriteJson((Id*) E->component, buffer);
+    APPEND(buffer, "\" }");
+    return;
   default: ;
   }
 
-  char* str = (char*) malloc(sizeof(char) * ENOUGH);
-
   // type is constructor, but no restrictions apply
-  // first line after case must be expression  
   switch (E->type) {
-  case (UNION): ;
-    #define JSONPATT_UNION "{ \"type\": \"op\", \"op\": \"Union\", \"param\": %s }"
-    ExpressionList* elist = (ExpressionList*) E->component;
-    char* subexps = elist->toJson(elist);
-    str = (char*) realloc(str, sizeof(char) * (strlen(subexps) + strlen(JSONPATT_UNION) + 1));
-    sprintf(str, JSONPATT_UNION, subexps);
-    free(subexps);
-    return str;
-  case (PROD): ;
-    #define JSONPATT_PROD "{ \"type\": \"op\", \"op\": \"Prod\", \"param\": %s }"
-    elist = (ExpressionList*) E->component;
-    subexps = elist->toJson(elist);
-    str = (char*) realloc(str, sizeof(char) * (strlen(subexps) + strlen(JSONPATT_PROD) + 1));
-    sprintf(str, JSONPATT_PROD, subexps);
-    free(subexps);
-    return str;
-  case (SUBST): ;
-    #define JSONPATT_SUBST "{ \"type\": \"op\", \"op\": \"Subst\", \"param\": %s }"
-    elist = (ExpressionList*) E->component;
-    subexps = elist->toJson(elist);
-    str = (char*) realloc(str, sizeof(char) * (strlen(subexps) + strlen(JSONPATT_SUBST) + 1));
-    sprintf(str, JSONPATT_SUBST, subexps);
-    free(subexps);
-    return str;
+  case (UNION):
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"Union\", \"param\": ");
+    break;
+  case (PROD):
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"Prod\", \"param\": ");
+    break;
+  case (SUBST):
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"Subst\", \"param\": ");
+    break;
   default: ;
   }
-  
+  if (E->type == UNION || E->type == PROD || E->type == SUBST) {
+    writeExpressionList((ExpressionList*) E->component, buffer, cache);
+    APPEND(buffer, " }");
+    return;
+  }
+
   // type is constructor, restrictions apply
-  // first line after case must be expression
   switch (E->type) {
-  case (SET): ;
-    #define JSONPATT_SET "{ \"type\": \"op\", \"op\": \"Set\", \"param\": [%s]%s }"
-    Expression* e = (Expression*) E->component;
-    char* rest = restrictionToJson(E->restriction, E->limit);
-    char* subexp = e->toJson(e);
-    str = (char*) realloc(str, sizeof(char) * (strlen(subexp) + strlen(rest) + strlen(JSONPATT_SET) + 1));
-    sprintf(str, JSONPATT_SET, subexp, rest);
-    free(rest);
-    free(subexp);
-    return str;
-  case (POWERSET): ;
-    #define JSONPATT_POWERSET "{ \"type\": \"op\", \"op\": \"PowerSet\", \"param\": [%s]%s }"
-    e = (Expression*) E->component;
-    rest = restrictionToJson(E->restriction, E->limit);
-    subexp = e->toJson(e);
-    str = (char*) realloc(str, sizeof(char) * (strlen(subexp) + strlen(rest) + strlen(JSONPATT_POWERSET) + 1));
-    sprintf(str, JSONPATT_POWERSET, subexp, rest);
-    free(rest);  
-    free(subexp); 
-    return str;
-  case (SEQUENCE): ;
-    #define JSONPATT_SEQUENCE "{ \"type\": \"op\", \"op\": \"Sequence\", \"param\": [%s]%s }"
-    e = (Expression*) E->component;
-    rest = restrictionToJson(E->restriction, E->limit);
-    subexp = e->toJson(e);
-    str = (char*) realloc(str, sizeof(char) * (strlen(subexp) + strlen(rest) + strlen(JSONPATT_SEQUENCE) + 1));
-    sprintf(str, JSONPATT_SEQUENCE, subexp, rest);
-    free(rest);
-    free(subexp);
-    return str;
-  case (CYCLE): ;
-    #define JSONPATT_CYCLE "{ \"type\": \"op\", \"op\": \"Cycle\", \"param\": [%s]%s }"
-    e = (Expression*) E->component;
-    rest = restrictionToJson(E->restriction, E->limit);
-    subexp = e->toJson(e);
-    str = (char*) realloc(str, sizeof(char) * (strlen(subexp) + strlen(rest) + strlen(JSONPATT_CYCLE) + 1));
-    sprintf(str, JSONPATT_CYCLE, subexp, rest);
-    free(rest);
-    free(subexp);
-    return str;
+  case (SET):
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"Set\", \"param\": [");
+    break;
+  case (POWERSET):
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"PowerSet\", \"param\": [");
+    break;
+  case (SEQUENCE):
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"Sequence\", \"param\": [");
+    break;
+  case (CYCLE):
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"Cycle\", \"param\": [");
+    break;
   default:
-    //sprintf(str, "\nError: token is not an expression!\n");
-    //return str;
-    return MAKE_JSON_ERROR("Token is not an expression.");
+    APPEND(buffer, JSON_ERROR("Token is not an expression."));
+    return;
   }
+  writeShared((Expression*) E->component, buffer, cache);
+  APPEND(buffer, "]");
+  restrictionWriteJson(E->restriction, E->limit, buffer);
+  APPEND(buffer, " }");
 }
 
+void expressionWriteJson(const Expression* E, Buffer* buffer)
+{
+  writeExpression(E, buffer, NULL);
+}
 
-/*
-  Json representation of lists of expressions.
-*/
-// FIXME: fix below
-char* expressionListToJson(const ExpressionList* Elist)
+void expressionListWriteJson(const ExpressionList* Elist, Buffer* buffer)
 {
-  int size = Elist->size;
-  int length = 0;
-  Expression** subexps = Elist->components;
-  char** substrs = (char**) malloc(sizeof(char*) * size);
-  
-  for (int i = 0; i < size; i++) { // get json representation of subexpressions
-    char* substr = subexps[i]->toJson(subexps[i]);
-    substrs[i] = substr;
-    length += strlen(substr);
-  }
+  writeExpressionList(Elist, buffer, NULL);
+}
 
-  length += 2 * (size - 1) + 1; // for ", " between subexpressions and NULL terminator
-  length += 4; // various Json stuff
-  char* str = (char*) malloc(sizeof(char) * length);
-  sprintf(str, "[ %s", substrs[0]); // there is always a first element
+static void writeStatement(const Statement* S, Buffer* buffer, JsonCache* cache)
+{
+  APPEND(buffer, "\"");
+  idWriteJson(S->variable, buffer);
+  APPEND(buffer, "\": ");
+  writeShared(S->expression, buffer, cache);
+}
 
-  for (int i = 1; i < size; i++) { // add other elements, separating with comma
-    strcat(str, ", ");
-    strcat(str, substrs[i]);
-    free(substrs[i]);
+static void writeStatementList(const StatementList* Slist, Buffer* buffer, JsonCache* cache)
+{
+  APPEND(buffer, "{ ");
+  writeStatement(Slist->components[0], buffer, cache); // there is always a first element
+  for (int i = 1; i < Slist->size; i++) { // add other elements, separating with comma
+    APPEND(buffer, ", ");
+    writeStatement(Slist->components[i], buffer, cache);
   }
-  strcat(str, " ]");
-
-  free(substrs);
-  return str;
+  APPEND(buffer, "}\n");
 }
 
-// DONE:
-char* statementToJson(const Statement* S)
+void statementWriteJson(const Statement* S, Buffer* buffer)
 {
-  Id* var = S->variable;
-  Expression* exp = S->expression;
-  char* varstr = var->toJson(var);
-  char* expstr = exp->toJson(exp);
-  char* str = (char*) malloc(sizeof(char) * (strlen(varstr) + strlen(expstr) + 5)); // NULL terminator and "\"': "
-  sprintf(str, "\"%s\": %s", varstr, expstr);
-  free(varstr);
-  free(expstr);
-  return str;
+  writeStatement(S, buffer, NULL);
 }
 
-// DONE:
-char* statementListToJson(const StatementList* Slist)
+void statementListWriteJson(const StatementList* Slist, Buffer* buffer)
 {
-  int size = Slist->size;
-  int length = 0;
-  Statement** substms = Slist->components;
-  char** substrs = (char**) malloc(sizeof(char*) * size);
-  
-  for (int i = 0; i < size; i++) { // get string representation of substatements
-    char* substr = substms[i]->toJson(substms[i]);
-    substrs[i] = substr;
-    length += strlen(substr);
-  }
-  
-  length += 2 * (size - 1) + 1; // for ", " between substatements and NULL terminator
-  length += 4; // various Json stuff
-  char* str = (char*) malloc(sizeof(char) * length);
-  sprintf(str, "{ %s", substrs[0]); // there is always a first element
-  free(substrs[0]);
-  
-  for (int i = 1; i < size; i++) { // add other elements, separating with comma
-    strcat(str, ", ");
-    strcat(str, substrs[i]);
-    free(substrs[i]);
-  }
-  strcat(str, "}\n");
-  
-  free(substrs);
-  return str;
+  writeStatementList(Slist, buffer, NULL);
 }
 
-// DONE:
-char* errorToJson(const Error* error)
+void errorWriteJson(const Error* error, Buffer* buffer)
 {
-  char* line = intToJson(error->line);
-  char* str = (char*) malloc(sizeof(char) * (strlen(error->message) + strlen(line) + 2*ENOUGH));
   if (error->type == LEXER) {
-      sprintf(str, "{\n  \"type\": \"error\",\n  \"source\": \"lexer\",\n  \"line\": %s\n  \"msg\": \"%s\"\n}", line, error->message);
+    APPEND(buffer, "{ \"type\": \"error\", \"source\": \"lexer\", \"line\": ");
+  } else if (error->type == INPUT) {
+    APPEND(buffer, "{ \"type\": \"error\", \"source\": \"input\", \"line\": ");
   } else {
-      sprintf(str, "{\n  \"type\": \"error\",\n  \"source\": \"parser\",\n  \"line\": %s\n  \"msg\": \"%s\"\n}", line, error->message);
+    APPEND(buffer, "{ \"type\": \"error\", \"source\": \"parser\", \"line\": ");
   }
-
-  free(line);
-  return str;
+  bufferAppendInt(buffer, error->line);
+  APPEND(buffer, ", \"msg\": \"");
+  bufferAppendEscaped(buffer, error->message);
+  APPEND(buffer, "\" }");
 }
 
-// DONE:
-char* grammarToJson(const Grammar* grammar)
+void grammarWriteJson(const Grammar* grammar, Buffer* buffer)
 {
   if (grammar->type == ISERROR) {
-    Error* E = (Error*) grammar->component;
-    return E->toJson(E);
+    errorWriteJson((Error*) grammar->component, buffer);
+  } else if (grammar->sharing == NULL) {
+    statementListWriteJson((StatementList*) grammar->component, buffer);
   } else {
-    StatementList* Slist = (StatementList*) grammar->component;
-    return Slist->toJson(Slist);
+    const Sharing* sharing = grammar->sharing;
+    JsonCache cache = {sharing, newBuffer(), malloc((sharing->distinct + 1) * sizeof(size_t)),
+                       malloc((sharing->distinct + 1) * sizeof(size_t))};
+    for (int i = 0; i < sharing->distinct; i++) {
+      cache.lengths[i] = NOT_WRITTEN;
+    }
+    writeStatementList((StatementList*) grammar->component, buffer, &cache);
+    freeBuffer(cache.texts);
+    free(cache.offsets);
+    free(cache.lengths);
   }
 }
 
+char* unitToJson(const Unit* U)
+{
+  Buffer* buffer = newBuffer();
+  unitWriteJson(U, buffer);
+  return bufferToString(buffer);
+}
+
+/*
+  Json representation of Ids. We avoid simply returning A->name to enforce the philosophy that
+  all jsons are owned by this module, so we can (and should) free the returned jsons.
+*/
+char* idToJson(const Id* A)
+{
+  Buffer* buffer = newBuffer();
+  idWriteJson(A, buffer);
+  return bufferToString(buffer);
+}
+
+char* expressionToJson(const Expression* E)
+{
+  Buffer* buffer = newBuffer();
+  expressionWriteJson(E, buffer);
+  return bufferToString(buffer);
+}
+
+char* expressionListToJson(const ExpressionList* Elist)
+{
+  Buffer* buffer = newBuffer();
+  expressionListWriteJson(Elist, buffer);
+  return bufferToString(buffer);
+}
+
+char* statementToJson(const Statement* S)
+{
+  Buffer* buffer = newBuffer();
+  statementWriteJson(S, buffer);
+  return bufferToString(buffer);
+}
+
+char* statementListToJson(const StatementList* Slist)
+{
+  Buffer* buffer = newBuffer();
+  statementListWriteJson(Slist, buffer);
+  return bufferToString(buffer);
+}
+
+char* errorToJson(const Error* error)
+{
+  Buffer* buffer = newBuffer();
+  errorWriteJson(error, buffer);
+  return bufferToString(buffer);
+}
+
+char* grammarToJson(const Grammar* grammar)
+{
+  Buffer* buffer = newBuffer();
+  grammarWriteJson(grammar, buffer);
+  return bufferToString(buffer);
+}
+
 /********************************** Constructors **********************************/
 
-Unit* newUnit(enum yytokentype type)
+Unit* newUnit(Arena* arena, enum yytokentype type)
 {
-  Unit* U = malloc(sizeof(Unit));
+  Unit* U = arenaAlloc(arena, sizeof(Unit));
   U->type = type;
   U->toString = &unitToString;
   U->toJson = &unitToJson;
-  U->key = addNode(U, UNIT_N, ST); 
   return U;
 }
 
-Id* newId(char* name)
+/*
+  Helper function that returns an Id whose name is the given string (which is not copied).
+*/
+static Id* newIdView(Arena* arena, char* name, int length)
 {
-  Id* A = malloc(sizeof(Id));
-  char* str = (char*) malloc(sizeof(char) * (strlen(name) + 1));
-  sprintf(str, "%s", name);
-  A->name = str;
+  Id* A = arenaAlloc(arena, sizeof(Id));
+  A->name = name;
+  A->length = length;
+  A->symbol = -1;
+  A->definition = -1;
   A->toString = &idToString;
   A->toJson = &idToJson;
-  A->key = addNode(A, ID_N, ST); 
   return A;
 }
 
-Expression* newExpression(void* component, enum yytokentype type, Restriction restriction, long long int limit)
+Id* newId(Arena* arena, char* name)
+{
+  int length = strlen(name);
+  return newIdView(arena, arenaStrndup(arena, name, length), length);
+}
+
+Id* newSymbolId(Arena* arena, SymbolTable* symbols, int symbol)
+{
+  Id* A = newIdView(arena, symbols->names[symbol], symbols->lengths[symbol]);
+  A->symbol = symbol;
+  return A;
+}
+
+Expression* newExpression(Arena* arena, void* component, enum yytokentype type, Restriction restriction, long long int limit)
 {
-  Expression* E = malloc(sizeof(Expression));
+  Expression* E = arenaAlloc(arena, sizeof(Expression));
   E->component = component;
   E->type = type;
   E->restriction = restriction;
   E->limit = limit;
   E->toString = &expressionToString;
   E->toJson = &expressionToJson;
-  E->key = addNode(E, EXP_N, ST);
   return E;
 }
 
-ExpressionList* newExpressionList(Expression* expression)
+ExpressionList* newExpressionList(Arena* arena, Expression* expression)
 {
-  ExpressionList* Elist = malloc(sizeof(ExpressionList));
-  Expression** components = (Expression**) malloc(sizeof(Expression*));
+  ExpressionList* Elist = arenaAlloc(arena, sizeof(ExpressionList));
+  Expression** components = (Expression**) arenaAlloc(arena, sizeof(Expression*));
   components[0] = expression;
   Elist->components = components;
   Elist->size = 1;
   Elist->space = 1;
   Elist->toString = &expressionListToString;
   Elist->toJson = &expressionListToJson;
-  Elist->key = addNode(Elist, EXPLIST_N, ST);
   return Elist;
 }
 
-Statement* newStatement(Id* variable, Expression* expression)
+Statement* newStatement(Arena* arena, Id* variable, Expression* expression)
 {
-  Statement* S = malloc(sizeof(Statement));
+  Statement* S = arenaAlloc(arena, sizeof(Statement));
   S->variable = variable;
   S->expression = expression;
   S->toString = &statementToString;
   S->toJson = &statementToJson;
-  S->key = addNode(S, STMT_N, ST);
   return S;
 }
 
-StatementList* newStatementList(Statement* statement)
+StatementList* newStatementList(Arena* arena, Statement* statement)
 {
-  StatementList* Slist = malloc(sizeof(StatementList));
-  Statement** components = (Statement**) malloc(sizeof(Statement*));
+  StatementList* Slist = arenaAlloc(arena, sizeof(StatementList));
+  Statement** components = (Statement**) arenaAlloc(arena, sizeof(Statement*));
   components[0] = statement;
   Slist->components = components;
   Slist->size = 1;
   Slist->space = 1;
   Slist->toString = &statementListToString;
   Slist->toJson = &statementListToJson;
-  Slist->key = addNode(Slist, STMTLIST_N, ST);
   return Slist;
 }
 
-Error* newError(int line, char* message, ErrorType type)
+Error* newError(Arena* arena, int line, char* message, ErrorType type)
 {
-  Error* E = malloc(sizeof(Error));
-  char* str = (char*) malloc(sizeof(char) * (strlen(message) + 1));
-  sprintf(str, "%s", message);
-  E->message = str;
+  Error* E = arenaAlloc(arena, sizeof(Error));
+  E->message = arenaStrndup(arena, message, strlen(message));
   E->line = line;
   E->type = type;
   E->toString = &errorToString;
   E->toJson = &errorToJson;
-  E->key = addNode(E, ERROR_N, ST);
   return E;
 }
 
-Grammar* newGrammar(void* component, GrammarType type)
+Grammar* newGrammar(Arena* arena, void* component, GrammarType type)
 {
-  Grammar* G = malloc(sizeof(Grammar));
+  Grammar* G = arenaAlloc(arena, sizeof(Grammar));
   G->component = component;
   G->type = type;
+  G->arena = arena;
+  G->input = NULL;
+  G->inputSize = 0;
+  G->symbols = NULL;
+  G->sharing = NULL;
+  G->graph = NULL;
   G->toString = &grammarToString;
   G->toJson = &grammarToJson;
-  G->key = addNode(G, GRAMMAR_N, ST);
   return G;
 }
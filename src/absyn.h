@@ -1,6 +1,8 @@
 #ifndef ABSYNTYPES
 #define ABSYNTYPES
-#include "node.h"
+#include "arena.h"
+#include "buffer.h"
+#include "symbols.h"
 
 /*
   There is a circular dependency between parser.tab.h (which contains the tokens)
@@ -16,12 +18,15 @@ typedef struct Statement_s Statement;
 typedef struct StatementList_s StatementList;
 typedef struct Error_s Error;
 typedef struct Grammar_s Grammar;
+typedef struct ParseContext_s ParseContext; // defined in context.h
+typedef struct Sharing_s Sharing; // defined in share.h
+typedef struct GrammarGraph_s GrammarGraph; // defined in graph.h
 
 #include "../parser.tab.h"
 
 typedef enum {NONE, LESS, EQUAL, GREATER} Restriction; // restrictions to cardinality
 
-typedef enum {LEXER, PARSER} ErrorType; // origin of error
+typedef enum {LEXER, PARSER, INPUT} ErrorType; // origin of error (INPUT: input could not be read)
 
 typedef enum {ISERROR, NOTERROR} GrammarType; // types of grammars resulting from parsing
 
@@ -33,7 +38,6 @@ typedef enum {ISERROR, NOTERROR} GrammarType; // types of grammars resulting fro
 struct Unit_s
 {
   enum yytokentype type;
-  key_t key;
   char* (*toString)(const struct Unit_s* self);
   char* (*toJson)(const struct Unit_s* self);
 };
@@ -43,8 +47,10 @@ struct Unit_s
 */
 struct Id_s
 {
-  char* name;
-  key_t key;
+  char* name; // NULL-terminated (once parsing is done, see terminateSymbols())
+  int length; // number of characters of the name
+  int symbol; // index of the name in the symbol table of the grammar (-1 if not interned)
+  int definition; // index of the statement defining the name (-1 if unknown, see resolveGrammar())
   char* (*toString)(const struct Id_s* self);
   char* (*toJson)(const struct Id_s* self);
 };
@@ -61,7 +67,6 @@ struct Expression_s
   enum yytokentype type;
   Restriction restriction; // restriction type
   long long int limit; // numerical value of restriction in cardinality
-  key_t key;
   char* (*toString)(const struct Expression_s* self);
   char* (*toJson)(const struct Expression_s* self);
 };
@@ -74,7 +79,6 @@ struct ExpressionList_s
   Expression** components;
   int size; // number of expressions in the list of components
   int space; // maximum number of expressions that can be put in the current list
-  key_t key;
   char* (*toString)(const struct ExpressionList_s* self);
   char* (*toJson)(const struct ExpressionList_s* self);
 };
@@ -87,7 +91,6 @@ struct Statement_s
 {
   Id* variable;
   Expression* expression;
-  key_t key;
   char* (*toString)(const struct Statement_s* self);
   char* (*toJson)(const struct Statement_s* self);
 };
@@ -100,7 +103,6 @@ struct StatementList_s
   Statement** components;
   int size; // number of statements in the list of components
   int space; // maximum number of statements that can be put in the current list
-  key_t key;
   char* (*toString)(const struct StatementList_s* self);
   char* (*toJson)(const struct StatementList_s* self);
 };
@@ -113,7 +115,6 @@ struct Error_s
   int line;
   char* message;
   ErrorType type;
-  key_t key;
   char* (*toString)(const struct Error_s* self);
   char* (*toJson)(const struct Error_s* self);
 };
@@ -125,7 +126,12 @@ struct Grammar_s
 {
   GrammarType type;
   void* component; // can be Error or StatementList
-  key_t key;
+  Arena* arena; // owns every node of the abstract syntax tree (including this one)
+  char* input; // memory-mapped input that the names of Ids point into (NULL if names are copied)
+  size_t inputSize; // size of the mapping
+  SymbolTable* symbols; // distinct identifiers of the grammar (NULL for errors)
+  Sharing* sharing; // structurally equal expressions, once shared by shareGrammar() (NULL otherwise)
+  GrammarGraph* graph; // identifiers bound to their definitions, once resolved by resolveGrammar() (NULL otherwise)
   char* (*toString)(const struct Grammar_s* self);
   char* (*toJson)(const struct Grammar_s* self);
 };
@@ -136,36 +142,58 @@ struct Grammar_s
 
 /********************************** Constructors **********************************/
 
-Unit* newUnit(enum yytokentype type);
+/*
+  All nodes (and the strings and arrays they own) are allocated from the given arena.
+*/
+
+Unit* newUnit(Arena* arena, enum yytokentype type);
 
-Id* newId(char* name);
+Id* newId(Arena* arena, char* name);
+
+/*
+  Id for the given symbol of the table (see internSymbol()), which shares its name.
+*/
+Id* newSymbolId(Arena* arena, SymbolTable* symbols, int symbol);
 
-Expression* newExpression(void* component, enum yytokentype type, Restriction restriction, long long int limit);
+Expression* newExpression(Arena* arena, void* component, enum yytokentype type, Restriction restriction, long long int limit);
 
-ExpressionList* newExpressionList(Expression* expression);
+ExpressionList* newExpressionList(Arena* arena, Expression* expression);
 
-Statement* newStatement(Id* variable, Expression* expression);
+Statement* newStatement(Arena* arena, Id* variable, Expression* expression);
 
-StatementList* newStatementList(Statement* statement);
+StatementList* newStatementList(Arena* arena, Statement* statement);
 
-Error* newError(int line, char* message, ErrorType type);
+Error* newError(Arena* arena, int line, char* message, ErrorType type);
 
-Grammar* newGrammar(void* component, GrammarType type);
+Grammar* newGrammar(Arena* arena, void* component, GrammarType type);
 
 /************************************* Functions *************************************/
 
-ExpressionList* addExpressionToList(Expression* expression, ExpressionList* list);
+ExpressionList* addExpressionToList(Arena* arena, Expression* expression, ExpressionList* list);
 
-StatementList* addStatementToList(Statement* statement, StatementList* list);
+StatementList* addStatementToList(Arena* arena, Statement* statement, StatementList* list);
 
 /*
-  Free the abstract syntax tree with root node. Also takes the corresponding nodes out of the ST.
+  Free the whole abstract syntax tree (every node was allocated from the arena of the grammar),
+  as well as the input it was parsed from, if it was memory-mapped.
 */
-void freeNodeRecursive(void* node, NodeType type);
+void freeGrammar(Grammar* grammar);
 
 /*
-  Free the given node, but not its children. Also takes the corresponding node out of the ST. 
+  Write the Json representation of the node to the buffer, in a single pass over the
+  abstract syntax tree. This is what the toJson() functions use, and grammarWriteJson()
+  with a buffer from newFileBuffer() streams the output directly to a file.
 */
-void freeNode(void* node, NodeType type);
+void restrictionWriteJson(Restriction rest, long long limit, Buffer* buffer);
+
+void expressionWriteJson(const Expression* E, Buffer* buffer);
+
+void expressionListWriteJson(const ExpressionList* Elist, Buffer* buffer);
+
+void statementWriteJson(const Statement* S, Buffer* buffer);
+
+void statementListWriteJson(const StatementList* Slist, Buffer* buffer);
+
+void grammarWriteJson(const Grammar* grammar, Buffer* buffer);
 
 #endif
@@ -0,0 +1,487 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "analysis.h"
+#include "flat.h"
+
+#define NEVER INT_MAX // number of children needed by a node that can never hold
+
+/*
+  The analysis works on the flat representation of the grammar, in which every expression
+  is a node of one array. References (FLAT_ID nodes, and FLAT_Z nodes when Z is defined by
+  a statement) are bound to the statement they refer to, or to -1 if it is undefined.
+*/
+typedef struct Analyzer_s
+{
+  const FlatGrammar* flat;
+  const GrammarGraph* graph;
+  int* parent; // parent[n] is the parent of node n, or -1 for the root of a statement
+  int* statementOf; // statementOf[n] is the statement whose expression is rooted at node n, or -1
+  int* target; // target[n] is the statement that reference n refers to (-1 if undefined, -2 if not a reference)
+  int* occurrenceOffsets; // references to statement i are occurrences[occurrenceOffsets[i]], ...
+  int* occurrences;
+  int* need; // work arrays of propagate()
+  int* queue;
+} Analyzer;
+
+/*
+  Helper function that returns the minimal and maximal number of components allowed by
+  the restriction of a node (maximum INT_MAX if there is none).
+*/
+static void cardinalityRange(const FlatGrammar* flat, int node, long long int* min, long long int* max)
+{
+  long long int limit = flatLimit(flat, node);
+  switch (flat->nodes[node].restriction) {
+  case (LESS):
+    *min = 0;
+    *max = limit;
+    break;
+  case (EQUAL):
+    *min = limit;
+    *max = limit;
+    break;
+  case (GREATER):
+    *min = limit;
+    *max = INT_MAX;
+    break;
+  default:
+    *min = 0;
+    *max = INT_MAX;
+  }
+  if (flat->nodes[node].op == FLAT_CYCLE && *min < 1) { // a cycle has at least one component
+    *min = 1;
+  }
+}
+
+/*
+  Helper function that returns the number of children that must hold for a node to hold,
+  for productivity (nullable is 0) or nullability (nullable is 1), or NEVER.
+*/
+static int needed(const Analyzer* A, int node, int nullable)
+{
+  const FlatNode* N = &A->flat->nodes[node];
+  long long int min, max;
+
+  if (A->target[node] != -2) { // reference: holds if the statement does
+    return (A->target[node] >= 0) ? 1 : NEVER;
+  }
+
+  switch (N->op) {
+  case (FLAT_EPSILON):
+    return 0;
+  case (FLAT_ATOM):
+  case (FLAT_Z):
+    return nullable ? NEVER : 0;
+  case (FLAT_UNION):
+    return 1;
+  case (FLAT_PROD):
+  case (FLAT_SUBST):
+    return N->children;
+  default: // SET, POWERSET, SEQUENCE, CYCLE
+    cardinalityRange(A->flat, node, &min, &max);
+    if (min > max) {
+      return NEVER;
+    }
+    return (min == 0) ? 0 : 1;
+  }
+}
+
+/*
+  Helper function that computes the least fixpoint of productivity or nullability, by
+  propagating, from the nodes that hold unconditionally, to their parents and from the
+  roots of statements to the references to these statements. Each node is put in the
+  queue at most once, and each arc is followed once, so this runs in linear time.
+*/
+static void propagate(Analyzer* A, int nullable, char* holds, char* statementHolds)
+{
+  int size = A->flat->size;
+  int head = 0, tail = 0;
+
+  memset(holds, 0, size);
+  memset(statementHolds, 0, A->flat->statements);
+  for (int n = 0; n < size; n++) {
+    A->need[n] = needed(A, n, nullable);
+    if (A->need[n] == 0) {
+      holds[n] = 1;
+      A->queue[tail++] = n;
+    }
+  }
+
+  while (head < tail) {
+    int n = A->queue[head++];
+    int s = A->statementOf[n];
+    if (s >= 0) { // root of statement s: every reference to s now holds
+      statementHolds[s] = 1;
+      for (int k = A->occurrenceOffsets[s]; k < A->occurrenceOffsets[s + 1]; k++) {
+        int r = A->occurrences[k];
+        if (!holds[r]) {
+          holds[r] = 1;
+          A->queue[tail++] = r;
+        }
+      }
+      continue;
+    }
+    int p = A->parent[n];
+    if (!holds[p] && A->need[p] != NEVER && --A->need[p] == 0) {
+      holds[p] = 1;
+      A->queue[tail++] = p;
+    }
+  }
+}
+
+/*
+  Helper function that computes the strongly connected components of the graph on n
+  vertices whose arcs are given in compressed sparse row form, with Tarjan's algorithm
+  (without recursion, so that long chains of statements cannot overflow the stack).
+  Components are numbered in the order in which they are completed, so that arcs only go
+  to components with a smaller or equal number. Returns the number of components.
+*/
+static int stronglyConnectedComponents(int n, const int* offsets, const int* targets, int* component)
+{
+  int* index = malloc(n * sizeof(int));
+  int* low = malloc(n * sizeof(int));
+  int* stack = malloc(n * sizeof(int)); // vertices of the components being built
+  int* callStack = malloc(n * sizeof(int)); // vertices being explored
+  int* nextArc = malloc(n * sizeof(int)); // next arc to explore, for each vertex of callStack
+  int counter = 0, count = 0, top = 0;
+
+  memset(index, -1, n * sizeof(int));
+  for (int root = 0; root < n; root++) {
+    if (index[root] >= 0) {
+      continue;
+    }
+    int depth = 0;
+    callStack[depth++] = root;
+    nextArc[root] = offsets[root];
+    index[root] = low[root] = counter++;
+    stack[top++] = root;
+    component[root] = -1;
+
+    while (depth > 0) {
+      int v = callStack[depth - 1];
+      if (nextArc[v] < offsets[v + 1]) {
+        int w = targets[nextArc[v]++];
+        if (index[w] < 0) { // explore w
+          index[w] = low[w] = counter++;
+          stack[top++] = w;
+          component[w] = -1;
+          nextArc[w] = offsets[w];
+          callStack[depth++] = w;
+        } else if (component[w] < 0 && index[w] < low[v]) { // w is on the stack
+          low[v] = index[w];
+        }
+        continue;
+      }
+
+      // v is done
+      depth--;
+      if (low[v] == index[v]) {
+        int w;
+        do {
+          w = stack[--top];
+          component[w] = count;
+        } while (w != v);
+        count++;
+      }
+      if (depth > 0 && low[v] < low[callStack[depth - 1]]) {
+        low[callStack[depth - 1]] = low[v];
+      }
+    }
+  }
+
+  free(index);
+  free(low);
+  free(stack);
+  free(callStack);
+  free(nextArc);
+  return count;
+}
+
+/*
+  Helper function that tells whether the graph, whose components are given, has a cycle,
+  and returns a vertex on a cycle (or -1).
+*/
+static int findCycle(int n, const int* offsets, const int* targets, const int* component, int count)
+{
+  int* componentSize = calloc(count, sizeof(int));
+  int witness = -1;
+
+  for (int v = 0; v < n; v++) {
+    componentSize[component[v]]++;
+  }
+  for (int v = 0; v < n && witness < 0; v++) {
+    if (componentSize[component[v]] > 1) {
+      witness = v;
+    }
+    for (int k = offsets[v]; k < offsets[v + 1] && witness < 0; k++) {
+      if (targets[k] == v) {
+        witness = v;
+      }
+    }
+  }
+
+  free(componentSize);
+  return witness;
+}
+
+/*
+  Helper function that builds the graph of the references that can be followed without
+  producing an atom: those through which an object of size 0 of the referenced statement
+  is part of an object of size 0 of the referencing one (all other parts being of size 0
+  as well). The system is well-founded only if this graph is acyclic. Also returns (in
+  *infinite) a statement in which some object of size 0 is made of an unbounded number of
+  components, or -1. The arcs are returned in compressed sparse row form.
+*/
+static void zeroSizeGraph(const Analyzer* A, const char* nullable, int** offsets, int** targets, int* infinite)
+{
+  const FlatGrammar* flat = A->flat;
+  int size = flat->size;
+  char* reachable = malloc(size);
+  int* nonNullable = calloc(size, sizeof(int)); // number of children of each node that are not nullable
+  int length = 0;
+
+  *infinite = -1;
+  *offsets = malloc((flat->statements + 1) * sizeof(int));
+  *targets = malloc((size > 0 ? size : 1) * sizeof(int)); // at most one arc per reference
+
+  for (int n = 0; n < size; n++) {
+    if (A->parent[n] >= 0 && !nullable[n]) {
+      nonNullable[A->parent[n]]++;
+    }
+  }
+
+  for (int i = 0; i < flat->statements; i++) {
+    int root = flat->roots[i];
+    (*offsets)[i] = length;
+
+    // in preorder, the parent of a node is visited before it
+    for (int n = root; n < root + flat->nodes[root].span; n++) {
+      int p = A->parent[n];
+      if (p < 0) {
+        reachable[n] = 1;
+      } else {
+        long long int min, max;
+        switch (flat->nodes[p].op) {
+        case (FLAT_UNION):
+          reachable[n] = reachable[p];
+          break;
+        case (FLAT_PROD):
+        case (FLAT_SUBST):
+          reachable[n] = reachable[p] && (nonNullable[p] - !nullable[n] == 0);
+          break;
+        default: // a single component of size 0, or any number of components of which one is
+          cardinalityRange(flat, p, &min, &max);
+          reachable[n] = reachable[p] && (nullable[n] || (min <= 1 && 1 <= max));
+          break;
+        }
+      }
+
+      int op = flat->nodes[n].op;
+      if ((op == FLAT_SET || op == FLAT_SEQUENCE || op == FLAT_CYCLE) && nullable[n + 1] && *infinite < 0) {
+        long long int min, max;
+        cardinalityRange(flat, n, &min, &max);
+        if (max == INT_MAX) {
+          *infinite = i;
+        }
+      }
+      if (reachable[n] && A->target[n] >= 0) {
+        (*targets)[length++] = A->target[n];
+      }
+    }
+  }
+  (*offsets)[flat->statements] = length;
+
+  free(reachable);
+  free(nonNullable);
+}
+
+GrammarAnalysis* analyzeGrammar(Grammar* grammar)
+{
+  if (grammar->type == ISERROR) {
+    return NULL;
+  }
+
+  Arena* arena = grammar->arena;
+  GrammarGraph* graph = resolveGrammar(grammar);
+  FlatGrammar* flat = flattenGrammar(grammar);
+  int size = flat->size;
+  int statements = flat->statements;
+
+  // bind the nodes to their parents and to the statements they refer to
+  Analyzer A = {.flat = flat, .graph = graph};
+  A.parent = malloc(size * sizeof(int));
+  A.statementOf = malloc(size * sizeof(int));
+  A.target = malloc(size * sizeof(int));
+  A.occurrenceOffsets = calloc(statements + 2, sizeof(int));
+  A.need = malloc(size * sizeof(int));
+  A.queue = malloc(size * sizeof(int));
+
+  memset(A.statementOf, -1, size * sizeof(int));
+  for (int i = 0; i < statements; i++) {
+    A.parent[flat->roots[i]] = -1;
+    A.statementOf[flat->roots[i]] = i;
+  }
+  for (int n = 0; n < size; n++) {
+    for (int k = 0, c = flatFirstChild(n); k < flat->nodes[n].children; k++, c = flatNextSibling(flat, c)) {
+      A.parent[c] = n;
+    }
+    if (flat->nodes[n].op == FLAT_ID) {
+      A.target[n] = graph->definition[flat->nodes[n].value];
+    } else if (flat->nodes[n].op == FLAT_Z && graph->zStatement >= 0) {
+      A.target[n] = graph->zStatement;
+    } else {
+      A.target[n] = -2;
+    }
+    if (A.target[n] >= 0) {
+      A.occurrenceOffsets[A.target[n] + 2]++;
+    }
+  }
+  for (int i = 0; i < statements; i++) { // counting sort of the references by statement
+    A.occurrenceOffsets[i + 2] += A.occurrenceOffsets[i + 1];
+  }
+  A.occurrences = malloc((A.occurrenceOffsets[statements + 1] + 1) * sizeof(int));
+  for (int n = 0; n < size; n++) {
+    if (A.target[n] >= 0) {
+      A.occurrences[A.occurrenceOffsets[A.target[n] + 1]++] = n;
+    }
+  }
+
+  GrammarAnalysis* analysis = arenaAlloc(arena, sizeof(GrammarAnalysis));
+  analysis->graph = graph;
+  analysis->size = statements;
+  analysis->component = arenaAlloc(arena, statements * sizeof(int));
+  analysis->componentStatements = arenaAlloc(arena, statements * sizeof(int));
+  analysis->productive = arenaAlloc(arena, statements);
+  analysis->nullable = arenaAlloc(arena, statements);
+
+  // fixpoints
+  char* productive = malloc(size);
+  char* nullable = malloc(size);
+  propagate(&A, 0, productive, analysis->productive);
+  propagate(&A, 1, nullable, analysis->nullable);
+
+  // components, in topological order
+  int count = stronglyConnectedComponents(statements, graph->offsets, graph->targets, analysis->component);
+  analysis->componentCount = count;
+  analysis->componentOffsets = arenaAlloc(arena, (count + 1) * sizeof(int));
+  analysis->recursive = arenaAlloc(arena, count);
+  memset(analysis->componentOffsets, 0, (count + 1) * sizeof(int));
+  memset(analysis->recursive, 0, count);
+  for (int i = 0; i < statements; i++) {
+    analysis->componentOffsets[analysis->component[i] + 1]++;
+    for (int k = graph->offsets[i]; k < graph->offsets[i + 1]; k++) {
+      if (graph->targets[k] == i) {
+        analysis->recursive[analysis->component[i]] = 1;
+      }
+    }
+  }
+  for (int c = 0; c < count; c++) {
+    if (analysis->componentOffsets[c + 1] > 1) {
+      analysis->recursive[c] = 1;
+    }
+    analysis->componentOffsets[c + 1] += analysis->componentOffsets[c];
+  }
+  int* next = malloc((count + 1) * sizeof(int));
+  memcpy(next, analysis->componentOffsets, (count + 1) * sizeof(int));
+  for (int i = 0; i < statements; i++) {
+    analysis->componentStatements[next[analysis->component[i]]++] = i;
+  }
+  free(next);
+
+  // well-foundedness
+  int witness = -1;
+  for (int e = 0; e < graph->errorCount && witness < 0; e++) {
+    if (graph->errors[e].type == UNDEFINED_SYMBOL) {
+      witness = graph->errors[e].statement;
+    }
+  }
+  for (int i = 0; i < statements && witness < 0; i++) {
+    if (!analysis->productive[i]) {
+      witness = i;
+    }
+  }
+  if (witness < 0) {
+    int *zeroOffsets, *zeroTargets, infinite;
+    zeroSizeGraph(&A, nullable, &zeroOffsets, &zeroTargets, &infinite);
+    witness = infinite;
+    if (witness < 0) {
+      int* zeroComponent = malloc((statements > 0 ? statements : 1) * sizeof(int));
+      int zeroCount = stronglyConnectedComponents(statements, zeroOffsets, zeroTargets, zeroComponent);
+      witness = findCycle(statements, zeroOffsets, zeroTargets, zeroComponent, zeroCount);
+      free(zeroComponent);
+    }
+    free(zeroOffsets);
+    free(zeroTargets);
+  }
+  analysis->wellFounded = (witness < 0);
+  analysis->witness = witness;
+
+  free(productive);
+  free(nullable);
+  free(A.parent);
+  free(A.statementOf);
+  free(A.target);
+  free(A.occurrenceOffsets);
+  free(A.occurrences);
+  free(A.need);
+  free(A.queue);
+  freeFlatGrammar(flat);
+  return analysis;
+}
+
+/********************************** Json **********************************/
+
+#define APPEND(buffer, literal) (bufferAppend((buffer), (literal), sizeof(literal) - 1)) // literal strings only
+
+/*
+  Helper function that writes the names of the statements i such that flags[i] == value.
+*/
+static void namesWriteJson(const StatementList* Slist, const char* flags, int value, Buffer* buffer)
+{
+  int first = 1;
+  APPEND(buffer, "[");
+  for (int i = 0; i < Slist->size; i++) {
+    if (flags[i] == value) {
+      bufferAppendString(buffer, first ? " \"" : ", \"");
+      bufferAppendString(buffer, Slist->components[i]->variable->name);
+      APPEND(buffer, "\"");
+      first = 0;
+    }
+  }
+  APPEND(buffer, " ]");
+}
+
+void analysisWriteJson(const Grammar* grammar, const GrammarAnalysis* analysis, Buffer* buffer)
+{
+  const StatementList* Slist = (StatementList*) grammar->component;
+
+  APPEND(buffer, "{ \"well-founded\": ");
+  if (analysis->wellFounded) {
+    APPEND(buffer, "true");
+  } else {
+    APPEND(buffer, "false, \"witness\": \"");
+    bufferAppendString(buffer, Slist->components[analysis->witness]->variable->name);
+    APPEND(buffer, "\"");
+  }
+
+  APPEND(buffer, ", \"components\": [");
+  for (int c = 0; c < analysis->componentCount; c++) {
+    bufferAppendString(buffer, (c == 0) ? " { \"symbols\": [" : ", { \"symbols\": [");
+    for (int k = analysis->componentOffsets[c]; k < analysis->componentOffsets[c + 1]; k++) {
+      bufferAppendString(buffer, (k == analysis->componentOffsets[c]) ? " \"" : ", \"");
+      bufferAppendString(buffer, Slist->components[analysis->componentStatements[k]]->variable->name);
+      APPEND(buffer, "\"");
+    }
+    if (analysis->recursive[c]) {
+      APPEND(buffer, " ], \"recursive\": true }");
+    } else {
+      APPEND(buffer, " ], \"recursive\": false }");
+    }
+  }
+
+  APPEND(buffer, " ], \"unproductive\": ");
+  namesWriteJson(Slist, analysis->productive, 0, buffer);
+  APPEND(buffer, ", \"nullable\": ");
+  namesWriteJson(Slist, analysis->nullable, 1, buffer);
+  APPEND(buffer, " }");
+}
@@ -0,0 +1,54 @@
+#include "graph.h"
+
+#ifndef ANALYSISTYPE
+#define ANALYSISTYPE
+/*
+  Structural properties of a grammar, seen as a system of equations on its statements.
+
+  The statements are grouped into the strongly connected components of the graph of the
+  grammar (see resolveGrammar()), which are numbered in topological order: a statement
+  only references statements of its own component, or of components with a smaller
+  number, so that the components can be solved (or sampled) one after the other, in order.
+  The statements of component c are componentStatements[componentOffsets[c]], ...,
+  componentStatements[componentOffsets[c+1] - 1].
+*/
+typedef struct GrammarAnalysis_s
+{
+  GrammarGraph* graph; // resolved grammar that the analysis is based on
+  int size; // number of statements
+  int componentCount;
+  int* component; // component[i] is the component of statement i
+  int* componentOffsets; // componentCount + 1 entries
+  int* componentStatements; // size entries
+  char* recursive; // recursive[c] is 1 if component c has a cycle (more than one statement, or a self-reference)
+  char* productive; // productive[i] is 1 if statement i describes at least one object
+  char* nullable; // nullable[i] is 1 if statement i describes an object of size 0
+  int wellFounded; // 1 if the system defines finitely many objects of each size (see analyzeGrammar())
+  int witness; // statement that shows that the system is not well-founded, or -1
+} GrammarAnalysis;
+#endif
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+/*
+  Analyzes the grammar in time linear in its size: strongly connected components (with
+  Tarjan's algorithm), and the least fixpoints of productivity and nullability. The system
+  is well-founded if every symbol is defined and productive, no object of size 0 is made
+  of an unbounded number of components (such as Sequence(A), with A nullable), and no
+  symbol derives itself without producing an atom (such as A = Union(Atom, Prod(E, A)),
+  with E nullable). A Subst is treated as a product of its arguments. The result is
+  allocated from the arena of the grammar, and is released with it. Returns NULL if the
+  grammar is an error.
+*/
+GrammarAnalysis* analyzeGrammar(Grammar* grammar);
+
+/*
+  Writes the Json representation of the analysis of the grammar to the buffer:
+    { "well-founded": ..., "components": [ { "symbols": [...], "recursive": ... }, ... ],
+      "unproductive": [...], "nullable": [...] }
+  with a field "witness" (the name of the statement) if the system is not well-founded.
+*/
+void analysisWriteJson(const Grammar* grammar, const GrammarAnalysis* analysis, Buffer* buffer);
+
+#endif
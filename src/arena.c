@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define CHUNK_SIZE 65536 // default size of a chunk (larger allocations get their own chunk)
+#define ALIGNMENT 16 // alignment of every block returned by the arena
+
+/********************************** Structures **********************************/
+
+/*
+  Contiguous piece of memory from which blocks are handed out, in increasing order.
+*/
+typedef struct Chunk_s
+{
+  struct Chunk_s* next;
+  size_t size; // number of usable bytes in data
+  size_t used; // number of bytes already handed out
+  char* data;
+} Chunk;
+
+/*
+  Bump allocator: all the nodes of an abstract syntax tree are allocated from
+  the same arena, so that the whole tree can be released at once.
+*/
+struct Arena_s
+{
+  Chunk* current; // chunk from which blocks are currently handed out
+  Chunk* full; // chunks that have been filled (or dedicated to a large block)
+  void* last; // last block handed out from the current chunk (for arenaGrow())
+};
+
+/*
+  Helper function that rounds size up to the next multiple of ALIGNMENT.
+*/
+static size_t align(size_t size)
+{
+  return (size + ALIGNMENT - 1) & ~((size_t) ALIGNMENT - 1);
+}
+
+/*
+  Helper function that allocates size bytes with malloc(), and aborts if memory is
+  exhausted: the arena never returns NULL, so that its callers need not check.
+*/
+static void* allocate(size_t size)
+{
+  void* memory = malloc(size);
+  if (memory == NULL) {
+    fputs("combstruct2json: out of memory\n", stderr);
+    abort();
+  }
+  return memory;
+}
+
+/*
+  Helper function that allocates a chunk with at least size usable bytes. The
+  header is stored at the beginning of the same allocation, so that data is aligned.
+*/
+static Chunk* newChunk(size_t size)
+{
+  size_t header = align(sizeof(Chunk));
+  Chunk* chunk = allocate(header + size);
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  chunk->data = (char*) chunk + header;
+  return chunk;
+}
+
+/********************************** Constructors **********************************/
+
+/*
+  Returns an empty Arena. Memory is requested from the system in chunks, on demand.
+*/
+Arena* newArena()
+{
+  Arena* arena = allocate(sizeof(Arena));
+  arena->current = newChunk(CHUNK_SIZE);
+  arena->full = NULL;
+  arena->last = NULL;
+  return arena;
+}
+
+/********************************** Functions **********************************/
+
+/*
+  Returns a pointer to size bytes of (suitably aligned) memory owned by the arena.
+*/
+void* arenaAlloc(Arena* arena, size_t size)
+{
+  Chunk* current = arena->current;
+  size = align(size);
+
+  if (size > current->size - current->used) {
+    if (size > CHUNK_SIZE / 4) { // large block: give it its own chunk, keep filling the current one
+      Chunk* chunk = newChunk(size);
+      chunk->used = size;
+      chunk->next = arena->full;
+      arena->full = chunk;
+      return chunk->data;
+    }
+
+    current->next = arena->full; // retire the current chunk
+    arena->full = current;
+    current = newChunk(CHUNK_SIZE);
+    arena->current = current;
+  }
+
+  void* block = current->data + current->used;
+  current->used += size;
+  arena->last = block;
+  return block;
+}
+
+/*
+  Grows a block previously returned by arenaAlloc() from oldSize to newSize bytes,
+  preserving its contents. Extends the block in place when possible.
+*/
+void* arenaGrow(Arena* arena, void* ptr, size_t oldSize, size_t newSize)
+{
+  Chunk* current = arena->current;
+
+  if (ptr != NULL && ptr == arena->last) { // last block of the current chunk: try in place
+    size_t offset = (char*) ptr - current->data;
+    if (align(newSize) <= current->size - offset) {
+      current->used = offset + align(newSize);
+      return ptr;
+    }
+  }
+
+  void* block = arenaAlloc(arena, newSize);
+  if (ptr != NULL) {
+    memcpy(block, ptr, oldSize);
+  }
+  return block;
+}
+
+/*
+  Returns a NULL-terminated copy (owned by the arena) of the first length characters of str.
+*/
+char* arenaStrndup(Arena* arena, const char* str, size_t length)
+{
+  char* copy = arenaAlloc(arena, length + 1);
+  memcpy(copy, str, length);
+  copy[length] = '\0';
+  return copy;
+}
+
+/*
+  Frees all the memory owned by the arena, and the arena itself.
+*/
+void freeArena(Arena* arena)
+{
+  Chunk* current = arena->full;
+  while (current != NULL) {
+    Chunk* next = current->next;
+    free(current);
+    current = next;
+  }
+  free(arena->current);
+  free(arena);
+}
@@ -0,0 +1,45 @@
+#ifndef ARENATYPE
+#define ARENATYPE
+#include <stddef.h>
+
+typedef struct Arena_s Arena;
+#endif
+
+#ifndef ARENA_H
+#define ARENA_H
+/********************************** Constructors **********************************/
+
+/*
+  Returns an empty Arena. Memory is requested from the system in chunks, on demand (and
+  the program aborts if it is exhausted, so that no function of the arena returns NULL).
+*/
+Arena* newArena();
+
+/********************************** Functions **********************************/
+
+/*
+  Returns a pointer to size bytes of (suitably aligned) memory owned by the arena.
+  The memory cannot be freed individually, it is released with the whole arena.
+*/
+void* arenaAlloc(Arena* arena, size_t size);
+
+/*
+  Grows a block previously returned by arenaAlloc() from oldSize to newSize bytes,
+  preserving its contents. The block is extended in place when it is the last
+  allocation of the arena, and copied otherwise (like realloc, the old pointer
+  should not be used anymore).
+*/
+void* arenaGrow(Arena* arena, void* ptr, size_t oldSize, size_t newSize);
+
+/*
+  Returns a NULL-terminated copy (owned by the arena) of the first length characters of str.
+*/
+char* arenaStrndup(Arena* arena, const char* str, size_t length);
+
+/*
+  Frees all the memory owned by the arena, and the arena itself. Runs in time
+  proportional to the number of chunks, not to the number of allocations.
+*/
+void freeArena(Arena* arena);
+
+#endif
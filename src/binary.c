@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "binary.h"
+
+#define BINARY_MAGIC "C2JGRAM" // followed by a NULL character
+#define BINARY_VERSION 1 // to be increased whenever the layout of the file (or of FlatNode) changes
+#define BINARY_BYTE_ORDER 0x01020304u // as written by the machine that created the file
+#define BINARY_ALIGNMENT 16
+
+/*
+  Header at the beginning of the file. Offsets are in bytes from the beginning of the file,
+  and the checksum (64-bit FNV-1a) covers everything after the header.
+*/
+typedef struct BinaryHeader_s
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t fileSize;
+  uint64_t checksum;
+  int32_t size; // number of nodes
+  int32_t limitCount;
+  int32_t statements;
+  int32_t symbols;
+  int32_t namesSize;
+  int32_t reserved;
+  uint64_t nodes; // offsets of the arrays
+  uint64_t limits;
+  uint64_t roots;
+  uint64_t variables;
+  uint64_t nameOffsets;
+  uint64_t names;
+} BinaryHeader;
+
+/*
+  Helper function that rounds up to the alignment of the arrays.
+*/
+static uint64_t align(uint64_t offset)
+{
+  return (offset + BINARY_ALIGNMENT - 1) & ~(uint64_t) (BINARY_ALIGNMENT - 1);
+}
+
+/*
+  Helper function that computes the 64-bit FNV-1a hash of a block of memory.
+*/
+static uint64_t checksum(const unsigned char* data, size_t length)
+{
+  uint64_t h = 14695981039346656037ull;
+  for (size_t i = 0; i < length; i++) {
+    h ^= data[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+/*
+  Helper function that fills the counts and offsets of the header, and returns the size of the file.
+*/
+static uint64_t layout(const FlatGrammar* flat, BinaryHeader* header)
+{
+  memset(header, 0, sizeof(BinaryHeader));
+  memcpy(header->magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+  header->version = BINARY_VERSION;
+  header->byteOrder = BINARY_BYTE_ORDER;
+  header->size = flat->size;
+  header->limitCount = flat->limitCount;
+  header->statements = flat->statements;
+  header->symbols = flat->symbols;
+  header->namesSize = flat->namesSize;
+
+  header->nodes = align(sizeof(BinaryHeader));
+  header->limits = align(header->nodes + (uint64_t) flat->size * sizeof(FlatNode));
+  header->roots = align(header->limits + (uint64_t) flat->limitCount * sizeof(long long int));
+  header->variables = align(header->roots + (uint64_t) flat->statements * sizeof(int));
+  header->nameOffsets = align(header->variables + (uint64_t) flat->statements * sizeof(int));
+  header->names = align(header->nameOffsets + (uint64_t) (flat->symbols + 1) * sizeof(int));
+  header->fileSize = header->names + flat->namesSize;
+  return header->fileSize;
+}
+
+/*
+  Helper function that checks that an array of the given number of elements lies within
+  the file, on an aligned offset.
+*/
+static int validArray(const BinaryHeader* header, uint64_t offset, int32_t count, size_t element)
+{
+  return count >= 0 && offset % BINARY_ALIGNMENT == 0 && offset >= sizeof(BinaryHeader)
+    && offset <= header->fileSize && (uint64_t) count * element <= header->fileSize - offset;
+}
+
+/*
+  Helper function that tells whether an operation can have the given number of children.
+*/
+static int validChildren(unsigned char op, int children)
+{
+  switch (op) {
+  case (FLAT_EPSILON):
+  case (FLAT_ATOM):
+  case (FLAT_Z):
+  case (FLAT_ID):
+    return children == 0;
+  case (FLAT_UNION):
+  case (FLAT_PROD):
+  case (FLAT_SUBST):
+    return children >= 1;
+  case (FLAT_SET):
+  case (FLAT_POWERSET):
+  case (FLAT_SEQUENCE):
+  case (FLAT_CYCLE):
+    return children == 1;
+  default:
+    return 0;
+  }
+}
+
+/*
+  Helper function that checks, in a single pass over its arrays, that a flat grammar read
+  from a file can be used without reading out of its arrays: the expressions of the
+  statements follow each other from the first node to the last one, the subtree of every
+  node is made of its children laid out one after the other, and the symbols, limits and
+  names refer to what is in the file. The nodes whose subtrees are still being checked
+  are kept on a stack, with the end of their subtree and the number of children left.
+*/
+static int validFlatGrammar(const FlatGrammar* flat)
+{
+  if (flat->symbols > 0 && (flat->namesSize == 0 || flat->names[flat->namesSize - 1] != '\0')) {
+    return 0;
+  }
+  for (int s = 0; s <= flat->symbols; s++) {
+    if (flat->nameOffsets[s] < 0 || flat->nameOffsets[s] > flat->namesSize
+        || (s < flat->symbols && flat->nameOffsets[s] == flat->namesSize)) {
+      return 0;
+    }
+  }
+  for (int i = 0; i < flat->statements; i++) {
+    if (flat->variables[i] < 0 || flat->variables[i] >= flat->symbols) {
+      return 0;
+    }
+  }
+
+  int* ends = malloc((flat->size + 1) * sizeof(int));
+  int* remaining = malloc((flat->size + 1) * sizeof(int));
+  int top = 0;
+  int statement = 0;
+  int valid = (ends != NULL && remaining != NULL);
+  for (int n = 0; valid && n < flat->size; n++) {
+    const FlatNode* N = &flat->nodes[n];
+    int end = (top > 0) ? ends[top - 1] : flat->size;
+    valid = N->op <= FLAT_CYCLE && N->restriction <= GREATER && validChildren(N->op, N->children)
+      && N->span >= 1 && N->span <= end - n && (N->children == 0) == (N->span == 1) && N->children < N->span
+      && (N->op != FLAT_ID || (N->value >= 0 && N->value < flat->symbols))
+      && (N->restriction == NONE || (N->value >= 0 && N->value < flat->limitCount));
+    if (top > 0) { // a child of the node on top
+      valid = valid && remaining[top - 1]-- > 0;
+    } else { // the root of the next statement
+      valid = valid && statement < flat->statements && flat->roots[statement++] == n;
+    }
+    if (N->children > 0) {
+      ends[top] = n + N->span;
+      remaining[top++] = N->children;
+    }
+    while (valid && top > 0 && ends[top - 1] == n + 1) {
+      valid = (remaining[--top] == 0);
+    }
+  }
+  free(ends);
+  free(remaining);
+  return valid && top == 0 && statement == flat->statements;
+}
+
+int writeFlatGrammarBinary(const FlatGrammar* flat, const char* filename)
+{
+  BinaryHeader header;
+  uint64_t fileSize = layout(flat, &header);
+
+  unsigned char* image = calloc(fileSize, 1); // zero padding
+  if (image == NULL) {
+    return -1;
+  }
+  memcpy(image + header.nodes, flat->nodes, flat->size * sizeof(FlatNode));
+  if (flat->limitCount > 0) {
+    memcpy(image + header.limits, flat->limits, flat->limitCount * sizeof(long long int));
+  }
+  memcpy(image + header.roots, flat->roots, flat->statements * sizeof(int));
+  memcpy(image + header.variables, flat->variables, flat->statements * sizeof(int));
+  memcpy(image + header.nameOffsets, flat->nameOffsets, (flat->symbols + 1) * sizeof(int));
+  memcpy(image + header.names, flat->names, flat->namesSize);
+  header.checksum = checksum(image + sizeof(BinaryHeader), fileSize - sizeof(BinaryHeader));
+  memcpy(image, &header, sizeof(BinaryHeader));
+
+  // write to a temporary file in the same directory, so that readers never see a partial file
+  char* temporary = malloc(strlen(filename) + 8);
+  sprintf(temporary, "%s.XXXXXX", filename);
+  int fd = mkstemp(temporary);
+  int status = -1;
+  if (fd >= 0) {
+    fchmod(fd, 0644); // mkstemp() only gives access to the owner
+    FILE* file = fdopen(fd, "wb");
+    if (file != NULL) {
+      size_t written = fwrite(image, 1, fileSize, file);
+      if (fclose(file) == 0 && written == fileSize) {
+        status = rename(temporary, filename);
+      }
+    } else {
+      close(fd);
+    }
+    if (status != 0) {
+      unlink(temporary);
+    }
+  }
+
+  free(temporary);
+  free(image);
+  return status;
+}
+
+int writeGrammarBinary(const Grammar* grammar, const char* filename)
+{
+  FlatGrammar* flat = flattenGrammar(grammar);
+  if (flat == NULL) {
+    return -1;
+  }
+  int status = writeFlatGrammarBinary(flat, filename);
+  freeFlatGrammar(flat);
+  return status;
+}
+
+FlatGrammar* readGrammarBinary(const char* filename, int verify)
+{
+  struct stat st;
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (size_t) st.st_size < sizeof(BinaryHeader)) {
+    close(fd);
+    return NULL;
+  }
+
+  // private mapping: the grammar can be modified in memory without changing the file
+  char* base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping stays valid
+  if (base == MAP_FAILED) {
+    return NULL;
+  }
+
+  const BinaryHeader* header = (const BinaryHeader*) base;
+  int valid = memcmp(header->magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0
+    && header->version == BINARY_VERSION
+    && header->byteOrder == BINARY_BYTE_ORDER
+    && header->fileSize == (uint64_t) st.st_size
+    && validArray(header, header->nodes, header->size, sizeof(FlatNode))
+    && validArray(header, header->limits, header->limitCount, sizeof(long long int))
+    && validArray(header, header->roots, header->statements, sizeof(int))
+    && validArray(header, header->variables, header->statements, sizeof(int))
+    && header->symbols >= 0 && header->symbols < INT32_MAX
+    && validArray(header, header->nameOffsets, header->symbols + 1, sizeof(int))
+    && validArray(header, header->names, header->namesSize, sizeof(char))
+    && (!verify || header->checksum == checksum((unsigned char*) base + sizeof(BinaryHeader),
+                                                st.st_size - sizeof(BinaryHeader)));
+  if (!valid) {
+    munmap(base, st.st_size);
+    return NULL;
+  }
+
+  FlatGrammar* flat = malloc(sizeof(FlatGrammar));
+  flat->nodes = (FlatNode*) (base + header->nodes);
+  flat->size = header->size;
+  flat->limits = (long long int*) (base + header->limits);
+  flat->limitCount = header->limitCount;
+  flat->roots = (int*) (base + header->roots);
+  flat->variables = (int*) (base + header->variables);
+  flat->statements = header->statements;
+  flat->names = base + header->names;
+  flat->nameOffsets = (int*) (base + header->nameOffsets);
+  flat->symbols = header->symbols;
+  flat->namesSize = header->namesSize;
+  flat->shared = NULL;
+  flat->mapping = base;
+  flat->mappingSize = st.st_size;
+  if (!validFlatGrammar(flat)) {
+    freeFlatGrammar(flat);
+    return NULL;
+  }
+  return flat;
+}
@@ -0,0 +1,34 @@
+#include "flat.h"
+
+#ifndef BINARY_H
+#define BINARY_H
+
+/*
+  Binary format of parsed grammars: a header (with a version and a checksum), followed by
+  the arrays of a flat grammar (see flat.h), each aligned on 16 bytes. Arrays refer to each
+  other by indices rather than pointers, so that a file can be memory-mapped and used as it
+  is. Files are written for (and only read on) machines with the same byte order.
+*/
+
+/*
+  Writes the flat representation of the grammar to the file (atomically, through a
+  temporary file that is renamed). Returns 0 on success, and -1 if the grammar is an
+  error or the file cannot be written.
+*/
+int writeGrammarBinary(const Grammar* grammar, const char* filename);
+
+int writeFlatGrammarBinary(const FlatGrammar* flat, const char* filename);
+
+/*
+  Maps the file written by writeGrammarBinary() and returns the flat grammar it contains,
+  whose arrays point directly into the mapping, without copying them. The structure of
+  the arrays is always checked, in time linear in their size, so that a truncated or
+  corrupt file cannot make consumers of the grammar read out of its arrays (nodes whose
+  subtrees or children do not fit, symbols, limits or names out of range). If verify is
+  not 0, the checksum of the file is also checked, which detects any other change.
+  Returns NULL if the file cannot be mapped, or is not a valid binary grammar of the
+  current version. The result is released (and unmapped) by freeFlatGrammar().
+*/
+FlatGrammar* readGrammarBinary(const char* filename, int verify);
+
+#endif
@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "buffer.h"
+
+#define INITIAL_SPACE 256 // initial capacity of in-memory buffers
+#define FILE_SPACE 65536 // capacity of buffers attached to a file (content is written out when full)
+
+/********************************** Constructors **********************************/
+
+/*
+  Helper function that allocates a buffer with the given capacity.
+*/
+static Buffer* newBufferWithSpace(size_t space, FILE* file)
+{
+  Buffer* buffer = malloc(sizeof(Buffer));
+  buffer->data = (char*) malloc(sizeof(char) * (space + 1)); // NULL terminator
+  buffer->data[0] = '\0';
+  buffer->length = 0;
+  buffer->space = space;
+  buffer->file = file;
+  return buffer;
+}
+
+Buffer* newBuffer()
+{
+  return newBufferWithSpace(INITIAL_SPACE, NULL);
+}
+
+Buffer* newFileBuffer(FILE* file)
+{
+  return newBufferWithSpace(FILE_SPACE, file);
+}
+
+/********************************** Functions **********************************/
+
+/*
+  Writes the content of the buffer to its file (if any) and empties it.
+*/
+void bufferFlush(Buffer* buffer)
+{
+  if (buffer->file == NULL) {
+    return;
+  }
+  fwrite(buffer->data, sizeof(char), buffer->length, buffer->file);
+  buffer->length = 0;
+  buffer->data[0] = '\0';
+}
+
+void bufferClear(Buffer* buffer)
+{
+  buffer->length = 0;
+  buffer->data[0] = '\0';
+}
+
+/*
+  Appends the first length characters of str to the buffer. In-memory buffers double
+  their capacity when full, so that appending is amortized constant time per character.
+*/
+void bufferAppend(Buffer* buffer, const char* str, size_t length)
+{
+  if (buffer->length + length > buffer->space) {
+    if (buffer->file != NULL) {
+      bufferFlush(buffer);
+      if (length > buffer->space) { // does not fit anyway: write directly
+        fwrite(str, sizeof(char), length, buffer->file);
+        return;
+      }
+    } else {
+      size_t space = 2 * buffer->space;
+      if (space < buffer->length + length) {
+        space = buffer->length + length;
+      }
+      buffer->data = (char*) realloc(buffer->data, sizeof(char) * (space + 1));
+      buffer->space = space;
+    }
+  }
+
+  memcpy(buffer->data + buffer->length, str, length);
+  buffer->length += length;
+  buffer->data[buffer->length] = '\0';
+}
+
+void bufferAppendString(Buffer* buffer, const char* str)
+{
+  bufferAppend(buffer, str, strlen(str));
+}
+
+void bufferAppendEscaped(Buffer* buffer, const char* str)
+{
+  const char* start = str; // beginning of the characters that need no escaping
+  for (; *str != '\0'; str++) {
+    unsigned char c = *str;
+    if (c != '"' && c != '\\' && c >= 0x20) {
+      continue;
+    }
+    bufferAppend(buffer, start, str - start);
+    start = str + 1;
+    if (c == '"' || c == '\\') {
+      char escaped[2] = {'\\', c};
+      bufferAppend(buffer, escaped, 2);
+    } else if (c == '\n') {
+      bufferAppend(buffer, "\\n", 2);
+    } else if (c == '\t') {
+      bufferAppend(buffer, "\\t", 2);
+    } else {
+      char escaped[8];
+      sprintf(escaped, "\\u%04x", c);
+      bufferAppend(buffer, escaped, 6);
+    }
+  }
+  bufferAppend(buffer, start, str - start);
+}
+
+void bufferAppendInt(Buffer* buffer, long long int a)
+{
+  char str[24]; // enough for any 64-bit integer, its sign and the NULL terminator
+  int length = sprintf(str, "%lld", a);
+  bufferAppend(buffer, str, length);
+}
+
+char* bufferToString(Buffer* buffer)
+{
+  char* str = buffer->data;
+  free(buffer);
+  return str;
+}
+
+void freeBuffer(Buffer* buffer)
+{
+  bufferFlush(buffer);
+  free(buffer->data);
+  free(buffer);
+}
@@ -0,0 +1,77 @@
+#ifndef BUFFERTYPE
+#define BUFFERTYPE
+#include <stdio.h>
+
+/*
+  Growable character buffer, used to produce the output of the library (such as
+  the JSON representation of a grammar) in a single pass. When a file is attached,
+  the content is written out whenever the buffer fills up, so that the memory used
+  stays bounded no matter how large the output is.
+*/
+typedef struct Buffer_s
+{
+  char* data; // always NULL-terminated
+  size_t length; // number of characters currently in data
+  size_t space; // number of characters that data can hold (not counting the NULL terminator)
+  FILE* file; // if not NULL, destination of the content
+} Buffer;
+#endif
+
+#ifndef BUFFER_H
+#define BUFFER_H
+/********************************** Constructors **********************************/
+
+/*
+  Returns an empty buffer that keeps its whole content in memory.
+*/
+Buffer* newBuffer();
+
+/*
+  Returns an empty buffer that writes its content to the given file as it fills up.
+*/
+Buffer* newFileBuffer(FILE* file);
+
+/********************************** Functions **********************************/
+
+/*
+  Appends the first length characters of str to the buffer.
+*/
+void bufferAppend(Buffer* buffer, const char* str, size_t length);
+
+/*
+  Appends the NULL-terminated string str to the buffer.
+*/
+void bufferAppendString(Buffer* buffer, const char* str);
+
+/*
+  Appends the NULL-terminated string str to the buffer, escaped so that it can be put
+  between double quotes in a Json string.
+*/
+void bufferAppendEscaped(Buffer* buffer, const char* str);
+
+/*
+  Appends the base-10 representation of a to the buffer.
+*/
+void bufferAppendInt(Buffer* buffer, long long int a);
+
+/*
+  Writes the content of the buffer to its file (if any) and empties it.
+*/
+void bufferFlush(Buffer* buffer);
+
+/*
+  Empties the buffer, discarding its content (which is not written to its file).
+*/
+void bufferClear(Buffer* buffer);
+
+/*
+  Frees the buffer, and returns its content as a malloc'ed string (that should be freed).
+*/
+char* bufferToString(Buffer* buffer);
+
+/*
+  Flushes the buffer (if it has a file) and frees it. The file is not closed.
+*/
+void freeBuffer(Buffer* buffer);
+
+#endif
@@ -0,0 +1,75 @@
+#include "absyn.h"
+
+#ifndef CONTEXTTYPE
+#define CONTEXTTYPE
+/*
+  State of one run of the parser (and of its lexer). Every call to readGrammarCtx()
+  works on its own context, so that several grammars can be parsed concurrently,
+  from different threads, as long as they do not share a context.
+*/
+struct ParseContext_s
+{
+  Grammar* root; // root of the abstract syntax tree (or error) once parsing is done
+  Arena* arena; // arena from which all nodes of the abstract syntax tree are allocated
+  SymbolTable* symbols; // identifiers seen so far (allocated from the arena)
+  int hasLexerError; // whether the lexer has reported an error
+  int lineNumber; // current line of the input
+  int commentLevel; // depth of nested C comments
+  char* input; // memory-mapped input being scanned in place (NULL when reading a stream or a copy)
+  size_t inputSize; // size of the mapping
+};
+#endif
+
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+/*
+  Parses the grammar contained in the given file using the given context (which does not
+  need to be initialized, and can be reused for several calls). Returns the root of the
+  abstract syntax tree, which is also stored in ctx->root, and should be freed with
+  freeGrammar(). If the file cannot be opened, the root is an error of type INPUT.
+*/
+Grammar* readGrammarCtx(ParseContext* ctx, char* filename);
+
+/*
+  Same as readGrammarCtx(), for a grammar given as the first length bytes of a buffer in
+  memory (which does not need to be NULL-terminated, and is not modified).
+*/
+Grammar* readGrammarFromBufferCtx(ParseContext* ctx, const char* buffer, size_t length);
+
+/*
+  Same as readGrammarCtx(), for a grammar read (from its current offset) through the given
+  file descriptor, which could be a pipe or a socket. The descriptor is not closed.
+*/
+Grammar* readGrammarFromFdCtx(ParseContext* ctx, int fd);
+
+/*
+  Same as readGrammarFromBufferCtx(), but the nodes are allocated from the arena of the
+  context, and the identifiers interned in its symbol table, as they are (the context must
+  have been used before, and its arena is not freed on errors, so the partial tree stays
+  there), and lines are numbered from the given one. The root is an error, or a grammar
+  that shares the arena of the context. Meant to parse pieces of a larger text into one
+  abstract syntax tree (see document.h).
+*/
+Grammar* readStatementsCtx(ParseContext* ctx, const char* buffer, size_t length, int line);
+
+/*
+  Same as readGrammarCtx(), but the file is memory-mapped and scanned in place, and the
+  names of the Ids are views into the mapping rather than copies. The mapping is owned
+  by the grammar, and released by freeGrammar(). Files that cannot be mapped (such as
+  pipes) are read as a stream instead.
+*/
+Grammar* readGrammarMappedCtx(ParseContext* ctx, char* filename);
+
+/*
+  Same as the functions above, with a context that is private to the call.
+*/
+Grammar* readGrammar(char* filename);
+
+Grammar* readGrammarMapped(char* filename);
+
+Grammar* readGrammarFromBuffer(const char* buffer, size_t length);
+
+Grammar* readGrammarFromFd(int fd);
+
+#endif
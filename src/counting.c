@@ -0,0 +1,1588 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "counting.h"
+#include "flat.h"
+
+#define MAX_LIMIT (1 << 20) // largest restriction to cardinality supported
+#define MAX_SIZE (1 << 22) // largest size supported (so that transforms fit the primes below)
+#define NAIVE_LENGTH 128 // products with a factor this short are computed directly
+#define STABLE_PRIMES 2 // exact counts are final once this many primes in a row leave them unchanged
+
+// primes c 2^k + 1 (k >= 23) for products modulo primes that do not support long enough transforms
+static const unsigned int transformPrimes[3] = {998244353, 167772161, 469762049};
+
+/*
+  Operations of the steps of a counting program. Step COUNT_X sets coefficient t of its
+  target series (written s_t below, with a_t, b_t the coefficients of its operands):
+    CONSTANT: s_t = 1 if t == parameter, 0 otherwise (parameter -1 is the zero series)
+    SUM: s_t = w_1 a_t + w_2 b_t + ... (+ parameter if t == 0), with rational weights w_i
+    PRODUCT: s_t = a_0 b_t + a_1 b_{t-1} + ... + a_t b_0
+    SHIFT: s_t = a_{t-parameter} (0 if t < parameter), the product by z^parameter (parameter > 0)
+    MULTIPLY_INDEX: s_t = t a_t
+    DIVIDE_INDEX: s_t = a_t / t (parameter if t == 0)
+    SPREAD: s_t = a_{t/parameter} if parameter divides t, 0 otherwise (the series A(z^parameter))
+    DIVISORS: s_t = sum over j dividing t of w_j a_{t/j} (0 if t == 0), with w_j given by
+              the PolyaKind parameter: 1/j (SET), (-1)^(j-1)/j (POWERSET), phi(j)/j (CYCLE)
+    PROPER_DIVISORS: the same, for j > 1 only (so that a_t itself is not read)
+*/
+typedef enum {COUNT_CONSTANT, COUNT_SUM, COUNT_PRODUCT, COUNT_SHIFT, COUNT_MULTIPLY_INDEX,
+              COUNT_DIVIDE_INDEX, COUNT_SPREAD, COUNT_DIVISORS, COUNT_PROPER_DIVISORS} CountOp;
+
+typedef enum {POLYA_SET, POLYA_POWERSET, POLYA_CYCLE} PolyaKind;
+
+/*
+  Step of a counting program. For each size t in increasing order, the steps are run in
+  order, each setting coefficient t of its target series. A step only reads coefficient t
+  of series set by earlier steps (coefficient t of the target of a product being the only
+  one completed by the step itself, see leaf()).
+*/
+typedef struct Step_s
+{
+  int op; // CountOp
+  int target; // series set by the step
+  int first; // operands of the step are operands[first], ..., operands[first + count - 1]
+  int count;
+  int parameter; // see CountOp
+} Step;
+
+typedef struct Operand_s
+{
+  int series;
+  int numerator; // weight in a sum, numerator / denominator
+  int denominator;
+} Operand;
+
+/*
+  Grammar compiled into a program that computes the coefficients of its generating
+  functions, independently of the prime they are computed modulo.
+*/
+typedef struct Program_s
+{
+  OracleType type;
+  int length; // number of coefficients computed (size + 1)
+  int series; // number of series
+  int* degrees; // degrees[s] is d if series s is z^d, and -1 otherwise
+  int degreeSpace;
+  Step* steps;
+  int stepCount, stepSpace;
+  Operand* operands;
+  int operandCount, operandSpace;
+  int* products; // steps that are products
+  int productCount, productSpace;
+  int statements;
+  int* roots; // roots[i] is the series of statement i
+  int largestDenominator; // weights have denominators up to this
+  int epsilon, atom, zero; // shared constant series, or -1
+  int failed;
+
+  // state of the compilation
+  const FlatGrammar* flat;
+  const GrammarGraph* graph;
+  const GrammarAnalysis* analysis;
+  char* nullable; // nullable[n] is 1 if node n describes an object of size 0
+  int* memo; // memo[n] is the series of the subtrees equal to that of node n (see shareGrammar()), or -1
+} Program;
+
+/*
+  Prime field in which transforms are computed, in Montgomery form: with R = 2^32, the
+  reduction of x < p R is x / R modulo p, so that multiplying by roots stored times R
+  needs no division.
+*/
+typedef struct Field_s
+{
+  unsigned int p;
+  unsigned int inverse; // -1/p modulo R
+  unsigned int square; // R^2 modulo p
+  unsigned int* roots; // roots[h + j] is w^j R, with w a primitive 2h-th root of unity (h a power of 2)
+  unsigned int* inverseRoots; // the same for the inverse of w
+} Field;
+
+/*
+  State of a run of a program modulo a prime p. Products are computed by transforms modulo
+  p itself if it has roots of unity of large enough order, and otherwise modulo the three
+  transformPrimes, from which they are recovered modulo p.
+*/
+typedef struct Machine_s
+{
+  const Program* program;
+  unsigned int p;
+  int length; // number of coefficients of each series
+  int span; // smallest power of 2 at least length
+  unsigned int* values; // coefficient t of series s is values[s * length + t]
+  unsigned int* weights; // weights[k] is the weight of operand k modulo p
+  unsigned int* inverses; // inverses[t] is 1/t modulo p (1 <= t < length)
+  int* phi; // phi[j] is Euler's totient of j (j < length)
+  unsigned int* polya[3]; // weights of the Pólya operators (see CountOp)
+  Field fields[3];
+  int fieldCount; // 1 if transforms are modulo p, 3 otherwise
+  unsigned int* work[7]; // transform buffers of span entries
+  unsigned long long int garner[4]; // constants to recover products modulo p from fieldCount 3
+} Machine;
+
+/****************************** Modular arithmetic ******************************/
+
+static inline unsigned int mulMod(unsigned int a, unsigned int b, unsigned int p)
+{
+  return (unsigned int) ((unsigned long long int) a * b % p);
+}
+
+static inline unsigned int addMod(unsigned int a, unsigned int b, unsigned int p)
+{
+  return (a + b >= p) ? a + b - p : a + b; // a + b < 2^32, since p < 2^31
+}
+
+static unsigned int powMod(unsigned int a, unsigned long long int e, unsigned int p)
+{
+  unsigned int r = 1 % p;
+  for (; e > 0; e >>= 1) {
+    if (e & 1) {
+      r = mulMod(r, a, p);
+    }
+    a = mulMod(a, a, p);
+  }
+  return r;
+}
+
+static inline unsigned int inverseMod(unsigned int a, unsigned int p)
+{
+  return powMod(a, p - 2, p);
+}
+
+/*
+  Helper function that reduces the rational numerator / denominator modulo p.
+*/
+static unsigned int rationalMod(long long int numerator, long long int denominator, unsigned int p)
+{
+  unsigned int n = (unsigned int) (((numerator % p) + p) % p);
+  return mulMod(n, inverseMod((unsigned int) (denominator % p), p), p);
+}
+
+int isPrime(unsigned int n)
+{
+  static const unsigned int bases[3] = {2, 7, 61};
+  if (n < 2) {
+    return 0;
+  }
+  for (unsigned int q = 2; q < 100; q++) {
+    if (n % q == 0) {
+      return n == q;
+    }
+  }
+  unsigned int d = n - 1;
+  int s = 0;
+  for (; d % 2 == 0; d /= 2) {
+    s++;
+  }
+  for (int k = 0; k < 3; k++) {
+    unsigned int x = powMod(bases[k], d, n);
+    if (x == 1 || x == n - 1) {
+      continue;
+    }
+    int r = 1;
+    for (; r < s && x != n - 1; r++) {
+      x = mulMod(x, x, n);
+    }
+    if (x != n - 1) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+  Helper function that returns a generator of the multiplicative group modulo the prime p.
+*/
+static unsigned int primitiveRoot(unsigned int p)
+{
+  unsigned int factors[32];
+  int count = 0;
+  unsigned int m = p - 1;
+  for (unsigned int q = 2; q * q <= m; q++) {
+    if (m % q == 0) {
+      factors[count++] = q;
+      while (m % q == 0) {
+        m /= q;
+      }
+    }
+  }
+  if (m > 1) {
+    factors[count++] = m;
+  }
+  for (unsigned int g = 2;; g++) {
+    int k = 0;
+    while (k < count && powMod(g, (p - 1) / factors[k], p) != 1) {
+      k++;
+    }
+    if (k == count) {
+      return g;
+    }
+  }
+}
+
+/********************************** Transforms **********************************/
+
+/*
+  Helper function that returns x / R modulo p, for x < p R (Montgomery reduction).
+*/
+static inline unsigned int reduce(const Field* F, unsigned long long int x)
+{
+  unsigned int q = (unsigned int) x * F->inverse;
+  unsigned int r = (unsigned int) ((x + (unsigned long long int) q * F->p) >> 32); // below 2p
+  return (r >= F->p) ? r - F->p : r;
+}
+
+/*
+  Helper function that prepares the field for transforms of length up to span.
+*/
+static void setField(Field* F, unsigned int p, int span)
+{
+  unsigned int g = primitiveRoot(p);
+  unsigned int x = p; // inverse of p modulo 2^3, then 2^6, 2^12, 2^24, 2^48 (Newton's iteration)
+  for (int k = 0; k < 4; k++) {
+    x *= 2 - p * x;
+  }
+  unsigned int r = (unsigned int) ((1ULL << 32) % p);
+  F->p = p;
+  F->inverse = -x;
+  F->square = mulMod(r, r, p);
+  for (int h = 1; h < span; h *= 2) {
+    unsigned int w = powMod(g, (p - 1) / (2 * h), p);
+    unsigned int v = inverseMod(w, p);
+    F->roots[h] = r;
+    F->inverseRoots[h] = r;
+    for (int j = 1; j < h; j++) {
+      F->roots[h + j] = mulMod(F->roots[h + j - 1], w, p);
+      F->inverseRoots[h + j] = mulMod(F->inverseRoots[h + j - 1], v, p);
+    }
+  }
+}
+
+/*
+  Helper function that computes in place the (inverse, up to a factor len) number-theoretic
+  transform of a, of length len (a power of 2).
+*/
+static void transform(const Field* F, unsigned int* a, int len, int inverse)
+{
+  unsigned int p = F->p;
+  const unsigned int* roots = inverse ? F->inverseRoots : F->roots;
+
+  for (int i = 1, j = 0; i < len; i++) { // bit-reversal permutation
+    int bit = len >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      unsigned int x = a[i];
+      a[i] = a[j];
+      a[j] = x;
+    }
+  }
+  for (int h = 1; h < len; h *= 2) {
+    for (int i = 0; i < len; i += 2 * h) {
+      for (int j = 0; j < h; j++) {
+        unsigned int u = a[i + j];
+        unsigned int v = reduce(F, (unsigned long long int) a[i + j + h] * roots[h + j]);
+        a[i + j] = addMod(u, v, p);
+        a[i + j + h] = (u >= v) ? u - v : u + p - v;
+      }
+    }
+  }
+}
+
+/*
+  Helper function that sets out to the transform of the coefficients of indices lo, ...,
+  lo + n - 1 of f, padded with zeros to length len.
+*/
+static void load(const Field* F, unsigned int* out, const unsigned int* f, int lo, int n, int len)
+{
+  for (int i = 0; i < len; i++) {
+    out[i] = (i < n) ? f[lo + i] % F->p : 0;
+  }
+  transform(F, out, len, 0);
+}
+
+/*
+  Helper function that adds to coefficients m, ..., tr - 1 of h the contributions of the
+  block (l, m, r) of relaxed() to the product of f by g: the product of f_0, ..., f_{m-1} by
+  g_0, ..., g_{m-1} if l is 0, and otherwise those of f_l, ..., f_{m-1} by g_0, ..., g_{r-l-1}
+  and of g_l, ..., g_{m-1} by f_0, ..., f_{r-l-1}, whose sum needs a single inverse transform.
+*/
+static void addBlock(Machine* M, const unsigned int* f, const unsigned int* g, unsigned int* h,
+                     int l, int m, int r, int tr)
+{
+  unsigned int p = M->p;
+  int n = m - l; // length of the new coefficients
+  int known = (l == 0) ? m : r - l; // length of the coefficients they are multiplied by
+
+  if (n <= NAIVE_LENGTH) {
+    for (int t = m; t < tr; t++) {
+      int lo = (t - known + 1 > l) ? t - known + 1 : l;
+      unsigned long long int s = 0;
+      for (int a = lo; a < m; a++) {
+        s += (unsigned long long int) f[a] * g[t - a]; // below 2^63 + 2^62
+        if (l > 0) {
+          s += (unsigned long long int) g[a] * f[t - a];
+        }
+        if (s >> 62) {
+          s %= p;
+        }
+      }
+      h[t] = addMod(h[t], (unsigned int) (s % p), p);
+    }
+    return;
+  }
+
+  int len = 1;
+  while (len < n + known - 1) {
+    len *= 2;
+  }
+  unsigned int** work = M->work;
+  for (int k = 0; k < M->fieldCount; k++) {
+    const Field* F = &M->fields[k];
+    unsigned int* R = work[4 + k];
+    load(F, R, f, l, n, len);
+    load(F, work[0], g, 0, known, len);
+    if (l == 0) {
+      for (int i = 0; i < len; i++) {
+        R[i] = reduce(F, (unsigned long long int) R[i] * work[0][i]);
+      }
+    } else {
+      load(F, work[1], g, l, n, len);
+      load(F, work[2], f, 0, known, len);
+      for (int i = 0; i < len; i++) {
+        R[i] = addMod(reduce(F, (unsigned long long int) R[i] * work[0][i]),
+                      reduce(F, (unsigned long long int) work[1][i] * work[2][i]), F->p);
+      }
+    }
+    transform(F, R, len, 1);
+    // the pointwise products are divided by R, and the inverse transform multiplied by len
+    unsigned int scale = mulMod(inverseMod((unsigned int) len, F->p), F->square, F->p);
+    for (int i = 0; i < len; i++) {
+      R[i] = reduce(F, (unsigned long long int) R[i] * scale);
+    }
+  }
+
+  for (int t = m; t < tr; t++) {
+    int i = t - l;
+    unsigned int value;
+    if (M->fieldCount == 1) {
+      value = work[4][i];
+    } else { // Garner's algorithm: the product is r0 + q0 x1 + q0 q1 x2, below q0 q1 q2
+      unsigned long long int q0 = transformPrimes[0], q1 = transformPrimes[1], q2 = transformPrimes[2];
+      unsigned long long int r0 = work[4][i], r1 = work[5][i], r2 = work[6][i];
+      unsigned long long int x1 = (r1 + q1 - r0 % q1) % q1 * M->garner[0] % q1;
+      unsigned long long int partial = (r0 % q2 + q0 % q2 * x1) % q2;
+      unsigned long long int x2 = (r2 + q2 - partial) % q2 * M->garner[1] % q2;
+      value = (unsigned int) ((r0 % p + M->garner[2] * x1 % p + M->garner[3] * x2 % p) % p);
+    }
+    h[t] = addMod(h[t], value, p);
+  }
+}
+
+/******************************** Machine ********************************/
+
+static Machine* newMachine(const Program* program)
+{
+  Machine* M = calloc(1, sizeof(Machine));
+  int length = program->length;
+  M->program = program;
+  M->length = length;
+  M->span = 1;
+  while (M->span < length) {
+    M->span *= 2;
+  }
+  M->values = malloc(((size_t) program->series * length + 1) * sizeof(unsigned int));
+  M->weights = malloc((program->operandCount + 1) * sizeof(unsigned int));
+  M->inverses = malloc((length + 1) * sizeof(unsigned int));
+  M->phi = malloc((length + 1) * sizeof(int));
+  for (int k = 0; k < 3; k++) {
+    M->polya[k] = malloc((length + 1) * sizeof(unsigned int));
+    M->fields[k].roots = malloc((M->span + 1) * sizeof(unsigned int));
+    M->fields[k].inverseRoots = malloc((M->span + 1) * sizeof(unsigned int));
+  }
+  for (int k = 0; k < 7; k++) {
+    M->work[k] = malloc((M->span + 1) * sizeof(unsigned int));
+  }
+
+  // Euler's totient, by sieving
+  for (int j = 0; j < length; j++) {
+    M->phi[j] = j;
+  }
+  for (int j = 2; j < length; j++) {
+    if (M->phi[j] == j) {
+      for (int m = j; m < length; m += j) {
+        M->phi[m] -= M->phi[m] / j;
+      }
+    }
+  }
+  return M;
+}
+
+static void freeMachine(Machine* M)
+{
+  free(M->values);
+  free(M->weights);
+  free(M->inverses);
+  free(M->phi);
+  for (int k = 0; k < 3; k++) {
+    free(M->polya[k]);
+    free(M->fields[k].roots);
+    free(M->fields[k].inverseRoots);
+  }
+  for (int k = 0; k < 7; k++) {
+    free(M->work[k]);
+  }
+  free(M);
+}
+
+/*
+  Helper function that prepares the machine for a run modulo the prime p (larger than the
+  size and the denominators of the weights of the program).
+*/
+static void setPrime(Machine* M, unsigned int p)
+{
+  const Program* program = M->program;
+  int length = M->length;
+
+  M->p = p;
+  M->inverses[1] = 1;
+  for (int t = 2; t < length; t++) {
+    M->inverses[t] = p - mulMod(p / t, M->inverses[p % t], p);
+  }
+  for (int k = 0; k < program->operandCount; k++) {
+    const Operand* O = &program->operands[k];
+    M->weights[k] = rationalMod(O->numerator, O->denominator, p);
+  }
+  for (int j = 1; j < length; j++) {
+    M->polya[POLYA_SET][j] = M->inverses[j];
+    M->polya[POLYA_POWERSET][j] = (j % 2 == 1) ? M->inverses[j] : p - M->inverses[j];
+    M->polya[POLYA_CYCLE][j] = mulMod((unsigned int) M->phi[j], M->inverses[j], p);
+  }
+
+  int adicity = 0;
+  while (((p - 1) >> adicity) % 2 == 0) {
+    adicity++;
+  }
+  if ((1LL << adicity) >= M->span) {
+    M->fieldCount = 1;
+    setField(&M->fields[0], p, M->span);
+  } else if (M->fields[0].p != transformPrimes[0] || M->fieldCount != 3) {
+    M->fieldCount = 3;
+    for (int k = 0; k < 3; k++) {
+      setField(&M->fields[k], transformPrimes[k], M->span);
+    }
+  }
+  if (M->fieldCount == 3) {
+    unsigned long long int q0 = transformPrimes[0], q1 = transformPrimes[1], q2 = transformPrimes[2];
+    M->garner[0] = inverseMod((unsigned int) (q0 % q1), (unsigned int) q1);
+    M->garner[1] = inverseMod((unsigned int) (q0 * q1 % q2), (unsigned int) q2);
+    M->garner[2] = q0 % p;
+    M->garner[3] = q0 * q1 % p;
+  }
+  memset(M->values, 0, (size_t) program->series * length * sizeof(unsigned int));
+}
+
+/*
+  Helper function that runs the steps of the program at size t, all the products of
+  coefficients of smaller sizes having already been added (see relaxed()).
+*/
+static void leaf(Machine* M, int t)
+{
+  const Program* program = M->program;
+  unsigned int p = M->p;
+  int length = M->length;
+  unsigned int* values = M->values;
+
+  for (int k = 0; k < program->stepCount; k++) {
+    const Step* S = &program->steps[k];
+    const Operand* O = &program->operands[S->first];
+    unsigned int* s = values + (size_t) S->target * length;
+    const unsigned int* a = (S->count > 0) ? values + (size_t) O[0].series * length : NULL;
+    unsigned long long int sum;
+
+    switch (S->op) {
+    case (COUNT_CONSTANT):
+      s[t] = (t == S->parameter);
+      break;
+    case (COUNT_SUM):
+      sum = (t == 0) ? (unsigned int) S->parameter : 0;
+      for (int i = 0; i < S->count; i++) {
+        sum += (unsigned long long int) M->weights[S->first + i] * values[(size_t) O[i].series * length + t];
+        if (sum >> 63) {
+          sum %= p;
+        }
+      }
+      s[t] = (unsigned int) (sum % p);
+      break;
+    case (COUNT_PRODUCT): {
+      const unsigned int* b = values + (size_t) O[1].series * length;
+      if (t == 0) {
+        s[0] = mulMod(a[0], b[0], p);
+      } else {
+        s[t] = addMod(s[t], (unsigned int) (((unsigned long long int) a[t] * b[0] + (unsigned long long int) a[0] * b[t]) % p), p);
+      }
+      break;
+    }
+    case (COUNT_SHIFT):
+      s[t] = (t >= S->parameter) ? a[t - S->parameter] : 0;
+      break;
+    case (COUNT_MULTIPLY_INDEX):
+      s[t] = mulMod((unsigned int) t, a[t], p);
+      break;
+    case (COUNT_DIVIDE_INDEX):
+      s[t] = (t == 0) ? (unsigned int) S->parameter : mulMod(a[t], M->inverses[t], p);
+      break;
+    case (COUNT_SPREAD):
+      s[t] = (t % S->parameter == 0) ? a[t / S->parameter] : 0;
+      break;
+    case (COUNT_DIVISORS):
+    case (COUNT_PROPER_DIVISORS): {
+      const unsigned int* w = M->polya[S->parameter];
+      int j = (S->op == COUNT_DIVISORS) ? 1 : 2; // smallest j
+      sum = 0;
+      for (int d = 1; t > 0 && d * d <= t; d++) {
+        if (t % d == 0) {
+          if (d >= j) {
+            sum += (unsigned long long int) w[d] * a[t / d] % p;
+          }
+          if (d * d != t && t / d >= j) {
+            sum += (unsigned long long int) w[t / d] * a[d] % p;
+          }
+        }
+      }
+      s[t] = (unsigned int) (sum % p);
+      break;
+    }
+    }
+  }
+}
+
+/*
+  Helper function that computes coefficients l, ..., r - 1 of all series, those of smaller
+  sizes being known, and the contributions to the products at these sizes of pairs of
+  coefficients below l having already been added. This is relaxed (online) multiplication:
+  once the first half is known, its contributions to the second half are added, by blocks
+  whose products are computed by transforms, and each pair of coefficients (of nonzero
+  sizes) is accounted for by exactly one block.
+*/
+static void relaxed(Machine* M, int l, int r)
+{
+  const Program* program = M->program;
+  int length = M->length;
+
+  if (l >= length) {
+    return;
+  }
+  if (r - l == 1) {
+    leaf(M, l);
+    return;
+  }
+  int m = (l + r) / 2;
+  relaxed(M, l, m);
+  if (m < length) {
+    int tr = (r < length) ? r : length;
+    for (int k = 0; k < program->productCount; k++) {
+      const Step* S = &program->steps[program->products[k]];
+      const unsigned int* f = M->values + (size_t) program->operands[S->first].series * length;
+      const unsigned int* g = M->values + (size_t) program->operands[S->first + 1].series * length;
+      unsigned int* h = M->values + (size_t) S->target * length;
+      addBlock(M, f, g, h, l, m, r, tr); // if l > 0, r - l <= l, so that the coefficients below r - l are known
+    }
+  }
+  relaxed(M, m, r);
+}
+
+/*
+  Helper function that runs the program modulo p, and sets residues[i * length + t] to
+  the count of size t of statement i modulo p.
+*/
+static void run(Machine* M, unsigned int p, unsigned int* residues)
+{
+  const Program* program = M->program;
+  int length = M->length;
+
+  setPrime(M, p);
+  relaxed(M, 0, M->span);
+  for (int i = 0; i < program->statements; i++) {
+    const unsigned int* s = M->values + (size_t) program->roots[i] * length;
+    unsigned int factorial = 1;
+    for (int t = 0; t < length; t++) {
+      if (program->type == LABELLED && t > 0) {
+        factorial = mulMod(factorial, (unsigned int) t, p);
+      }
+      residues[(size_t) i * length + t] = (program->type == LABELLED) ? mulMod(s[t], factorial, p) : s[t];
+    }
+  }
+}
+
+/******************************** Compilation ********************************/
+
+/*
+  Helper function that returns the minimal and maximal number of components allowed by
+  the restriction of a node (maximum INT_MAX if there is none).
+*/
+static void cardinalityRange(const FlatGrammar* flat, int node, long long int* min, long long int* max)
+{
+  long long int limit = flatLimit(flat, node);
+  switch (flat->nodes[node].restriction) {
+  case (LESS):
+    *min = 0;
+    *max = limit;
+    break;
+  case (EQUAL):
+    *min = limit;
+    *max = limit;
+    break;
+  case (GREATER):
+    *min = limit;
+    *max = INT_MAX;
+    break;
+  default:
+    *min = 0;
+    *max = INT_MAX;
+  }
+  if (flat->nodes[node].op == FLAT_CYCLE && *min < 1) { // a cycle has at least one component
+    *min = 1;
+  }
+}
+
+static int newSeries(Program* P)
+{
+  if (P->series == P->degreeSpace) {
+    P->degreeSpace = 2 * P->degreeSpace + 16;
+    P->degrees = realloc(P->degrees, P->degreeSpace * sizeof(int));
+  }
+  P->degrees[P->series] = -1;
+  return P->series++;
+}
+
+/*
+  Helper function that appends a step (whose operands are then given by addOperand()), and
+  returns its target.
+*/
+static int addStep(Program* P, int op, int target, int parameter)
+{
+  if (P->stepCount == P->stepSpace) {
+    P->stepSpace = 2 * P->stepSpace + 16;
+    P->steps = realloc(P->steps, P->stepSpace * sizeof(Step));
+  }
+  if (op == COUNT_PRODUCT) {
+    if (P->productCount == P->productSpace) {
+      P->productSpace = 2 * P->productSpace + 16;
+      P->products = realloc(P->products, P->productSpace * sizeof(int));
+    }
+    P->products[P->productCount++] = P->stepCount;
+  }
+  Step* S = &P->steps[P->stepCount++];
+  S->op = op;
+  S->target = target;
+  S->first = P->operandCount;
+  S->count = 0;
+  S->parameter = parameter;
+  return target;
+}
+
+static void addOperand(Program* P, int series, int numerator, int denominator)
+{
+  if (P->operandCount == P->operandSpace) {
+    P->operandSpace = 2 * P->operandSpace + 16;
+    P->operands = realloc(P->operands, P->operandSpace * sizeof(Operand));
+  }
+  Operand* O = &P->operands[P->operandCount++];
+  O->series = series;
+  O->numerator = numerator;
+  O->denominator = denominator;
+  if (denominator > P->largestDenominator) {
+    P->largestDenominator = denominator;
+  }
+  P->steps[P->stepCount - 1].count++;
+}
+
+static int constant(Program* P, int* shared, int size)
+{
+  if (*shared < 0) {
+    *shared = addStep(P, COUNT_CONSTANT, newSeries(P), size);
+    P->degrees[*shared] = size;
+  }
+  return *shared;
+}
+
+static int unary(Program* P, int op, int a, int parameter)
+{
+  int s = addStep(P, op, newSeries(P), parameter);
+  addOperand(P, a, 1, 1);
+  return s;
+}
+
+static int scaled(Program* P, int a, int numerator, int denominator)
+{
+  if (numerator == denominator) {
+    return a;
+  }
+  int s = addStep(P, COUNT_SUM, newSeries(P), 0);
+  addOperand(P, a, numerator, denominator);
+  return s;
+}
+
+/*
+  Helper function that returns the product of a by z^d (d > 0).
+*/
+static int shift(Program* P, int a, int d)
+{
+  int s = unary(P, COUNT_SHIFT, a, d);
+  if (P->degrees[a] >= 0) {
+    P->degrees[s] = P->degrees[a] + d;
+  }
+  return s;
+}
+
+/*
+  Helper function that returns the product of a and b, which is a shift if one of them is
+  a power of z (as all the atoms of a product are).
+*/
+static int product(Program* P, int a, int b)
+{
+  if (P->degrees[a] == 0) {
+    return b;
+  } else if (P->degrees[b] == 0) {
+    return a;
+  } else if (P->degrees[a] > 0) {
+    return shift(P, b, P->degrees[a]);
+  } else if (P->degrees[b] > 0) {
+    return shift(P, a, P->degrees[b]);
+  }
+  int s = addStep(P, COUNT_PRODUCT, newSeries(P), 0);
+  addOperand(P, a, 1, 1);
+  addOperand(P, b, 1, 1);
+  return s;
+}
+
+static int spread(Program* P, int a, int factor)
+{
+  return (factor == 1) ? a : unary(P, COUNT_SPREAD, a, factor);
+}
+
+/*
+  Helper functions that return the series 1 / (1 - A), exp(A) and log(1 / (1 - A)), for a
+  series A without constant term: the first as the solution of Q = 1 + A Q, the others
+  through their derivatives, as E' = A' E and L' = A' Q.
+*/
+static int sequenceOf(Program* P, int a)
+{
+  int q = newSeries(P);
+  int h = product(P, a, q);
+  addStep(P, COUNT_SUM, q, 1);
+  addOperand(P, h, 1, 1);
+  return q;
+}
+
+static int expOf(Program* P, int a)
+{
+  int e = newSeries(P);
+  int h = product(P, unary(P, COUNT_MULTIPLY_INDEX, a, 0), e);
+  addStep(P, COUNT_DIVIDE_INDEX, e, 1);
+  addOperand(P, h, 1, 1);
+  return e;
+}
+
+static int logOf(Program* P, int a)
+{
+  int q = sequenceOf(P, a);
+  int h = product(P, unary(P, COUNT_MULTIPLY_INDEX, a, 0), q);
+  return unary(P, COUNT_DIVIDE_INDEX, h, 0);
+}
+
+/*
+  Helper function that returns the series of the unrestricted construction of the node
+  applied to a (without constant term).
+*/
+static int total(Program* P, int op, int a)
+{
+  int labelled = (P->type == LABELLED);
+  switch (op) {
+  case (FLAT_SEQUENCE):
+    return sequenceOf(P, a);
+  case (FLAT_CYCLE): // the sum over j of phi(j)/j log(1 / (1 - A(z^j)))
+    return labelled ? logOf(P, a) : unary(P, COUNT_DIVISORS, logOf(P, a), POLYA_CYCLE);
+  case (FLAT_POWERSET): // exp of the sum over j of (-1)^(j-1) A(z^j) / j
+    return expOf(P, labelled ? a : unary(P, COUNT_DIVISORS, a, POLYA_POWERSET));
+  default: // exp of the sum over j of A(z^j) / j
+    return expOf(P, labelled ? a : unary(P, COUNT_DIVISORS, a, POLYA_SET));
+  }
+}
+
+/*
+  Helper function that returns the series F of the construction of the node applied to a
+  (without constant term) restricted to at least 2 components, computed so that it does
+  not read coefficient t of a at size t (unlike the unrestricted construction minus 1 and
+  A, in which the terms a_t would cancel out, but only once they are known):
+    Sequence: F = A^2 / (1 - A)
+    Set and PowerSet: with exp(P) the construction and R = P - A (the terms A(z^j) for
+      j > 1, or 0 for LABELLED), 1 + A + F = exp(P), so that z F' = z P' (A + F) + z R'
+    Cycle: with L = log(1 / (1 - A)), z (L - A)' = z A' A / (1 - A), plus the terms
+      phi(j)/j L(z^j) for j > 1 (UNLABELLED)
+*/
+static int tail(Program* P, int op, int a)
+{
+  int labelled = (P->type == LABELLED);
+  int kind = (op == FLAT_POWERSET) ? POLYA_POWERSET : POLYA_SET;
+  int h, f, g;
+
+  switch (op) {
+  case (FLAT_SEQUENCE):
+    return product(P, a, product(P, a, sequenceOf(P, a)));
+  case (FLAT_CYCLE):
+    h = product(P, unary(P, COUNT_MULTIPLY_INDEX, a, 0), product(P, a, sequenceOf(P, a)));
+    f = unary(P, COUNT_DIVIDE_INDEX, h, 0);
+    if (labelled) {
+      return f;
+    }
+    h = unary(P, COUNT_PROPER_DIVISORS, logOf(P, a), POLYA_CYCLE);
+    g = addStep(P, COUNT_SUM, newSeries(P), 0);
+    addOperand(P, f, 1, 1);
+    addOperand(P, h, 1, 1);
+    return g;
+  default:
+    g = newSeries(P); // A + F
+    h = product(P, unary(P, COUNT_MULTIPLY_INDEX, labelled ? a : unary(P, COUNT_DIVISORS, a, kind), 0), g);
+    if (!labelled) {
+      int r = unary(P, COUNT_MULTIPLY_INDEX, unary(P, COUNT_PROPER_DIVISORS, a, kind), 0);
+      int s = addStep(P, COUNT_SUM, newSeries(P), 0);
+      addOperand(P, h, 1, 1);
+      addOperand(P, r, 1, 1);
+      h = s;
+    }
+    f = unary(P, COUNT_DIVIDE_INDEX, h, 0);
+    addStep(P, COUNT_SUM, g, 0);
+    addOperand(P, a, 1, 1);
+    addOperand(P, f, 1, 1);
+    return f;
+  }
+}
+
+/*
+  Helper function that returns the series T_0, ..., T_k of the construction of the node
+  restricted to 0, ..., k components (as a malloc'ed array), from the recurrences of
+  seriesTerm() in oracle.c.
+*/
+static int* terms(Program* P, int op, int a, int k)
+{
+  int labelled = (P->type == LABELLED);
+  int* T = malloc((k + 1) * sizeof(int));
+  int* spreads = NULL; // spreads[i] is A(z^i)
+  int* powers = NULL; // powers[d] is the last power of A(z^d) computed
+  int power = a; // A^j, for labelled cycles
+
+  if (!labelled && op != FLAT_SEQUENCE) {
+    spreads = malloc((k + 1) * sizeof(int));
+    powers = malloc((k + 1) * sizeof(int));
+    for (int i = 1; i <= k; i++) {
+      spreads[i] = -1;
+    }
+  }
+
+  T[0] = (op == FLAT_CYCLE) ? constant(P, &P->zero, -1) : constant(P, &P->epsilon, 0);
+  for (int j = 1; j <= k; j++) {
+    if (op == FLAT_SEQUENCE) {
+      T[j] = product(P, a, T[j - 1]);
+    } else if (labelled && op == FLAT_CYCLE) { // A^j / j
+      power = (j == 1) ? a : product(P, a, power);
+      T[j] = scaled(P, power, 1, j);
+    } else if (labelled) { // A^j / j!
+      T[j] = scaled(P, product(P, a, T[j - 1]), 1, j);
+    } else if (op == FLAT_CYCLE) { // (1/j) sum over d | j of phi(d) A(z^d)^(j/d)
+      int* divisors = malloc((j + 1) * sizeof(int));
+      int count = 0;
+      for (int d = 1; d <= j; d++) {
+        if (j % d == 0) {
+          if (spreads[d] < 0) {
+            spreads[d] = spread(P, a, d);
+          }
+          powers[d] = (d == j) ? spreads[d] : product(P, spreads[d], powers[d]);
+          divisors[count++] = d;
+        }
+      }
+      T[j] = addStep(P, COUNT_SUM, newSeries(P), 0);
+      for (int i = 0; i < count; i++) {
+        int d = divisors[i], phi = d;
+        for (int q = 2, m = d; m > 1; q++) { // phi(d), with d <= k small
+          if (m % q == 0) {
+            phi -= phi / q;
+            while (m % q == 0) {
+              m /= q;
+            }
+          }
+        }
+        addOperand(P, powers[d], phi, j);
+      }
+      free(divisors);
+    } else { // (1/j) sum over i of (+/-) A(z^i) T_{j-i}
+      int* parts = malloc((j + 1) * sizeof(int));
+      for (int i = 1; i <= j; i++) {
+        if (spreads[i] < 0) {
+          spreads[i] = spread(P, a, i);
+        }
+        parts[i] = product(P, spreads[i], T[j - i]);
+      }
+      T[j] = addStep(P, COUNT_SUM, newSeries(P), 0);
+      for (int i = 1; i <= j; i++) {
+        addOperand(P, parts[i], (op == FLAT_POWERSET && i % 2 == 0) ? -1 : 1, j);
+      }
+      free(parts);
+    }
+  }
+  free(spreads);
+  free(powers);
+  return T;
+}
+
+static int compileNode(Program* P, int n);
+
+/*
+  Helper function that returns the series of statement i, or the constant it is defined as
+  (as in Z = Atom), so that products by it are shifts.
+*/
+static int reference(Program* P, int i)
+{
+  switch (P->flat->nodes[P->flat->roots[i]].op) {
+  case (FLAT_EPSILON):
+    return constant(P, &P->epsilon, 0);
+  case (FLAT_ATOM):
+    return constant(P, &P->atom, 1);
+  default:
+    return P->roots[i];
+  }
+}
+
+/*
+  Helper function that compiles a Set, PowerSet, Sequence or Cycle node: T_min + ... + T_max
+  for a bounded number of components, and the unrestricted construction minus T_0, ...,
+  T_{min-1} otherwise. When the child has no object of size 0, T_j has no coefficient below
+  j, so that only the terms below the number of coefficients computed matter.
+*/
+static int compileConstruction(Program* P, int n)
+{
+  int op = P->flat->nodes[n].op;
+  int child = flatFirstChild(n);
+  int a = compileNode(P, child);
+  long long int min, max;
+  cardinalityRange(P->flat, n, &min, &max);
+
+  if (max == INT_MAX) {
+    if (P->nullable[child]) { // only possible for PowerSet, which would need exp(a_0)
+      P->failed = 1;
+      return constant(P, &P->zero, -1);
+    }
+    if (min <= (op == FLAT_CYCLE)) {
+      return total(P, op, a);
+    } else if (min >= P->length) {
+      return constant(P, &P->zero, -1);
+    }
+    // T_1 + F - T_2 - ... - T_{min-1}, with T_1 = A
+    int f = tail(P, op, a);
+    int* T = terms(P, op, a, (int) min - 1);
+    int r = addStep(P, COUNT_SUM, newSeries(P), 0);
+    if (min == 1) {
+      addOperand(P, a, 1, 1);
+    }
+    addOperand(P, f, 1, 1);
+    for (int j = 2; j < min; j++) {
+      addOperand(P, T[j], -1, 1);
+    }
+    free(T);
+    return r;
+  }
+
+  if (!P->nullable[child] && max > P->length - 1) {
+    max = P->length - 1;
+  }
+  if (min > max) {
+    return constant(P, &P->zero, -1);
+  }
+  int* T = terms(P, op, a, (int) max);
+  int r = T[min];
+  if (min < max) {
+    r = addStep(P, COUNT_SUM, newSeries(P), 0);
+    for (int j = (int) min; j <= max; j++) {
+      addOperand(P, T[j], 1, 1);
+    }
+  }
+  free(T);
+  return r;
+}
+
+/*
+  Helper function that compiles the expression rooted at node n (children first), and
+  returns its series.
+*/
+static int compileExpression(Program* P, int n)
+{
+  const FlatNode* N = &P->flat->nodes[n];
+  int zStatement = P->graph->zStatement;
+  int* children;
+  int s;
+
+  switch (N->op) {
+  case (FLAT_EPSILON):
+    return constant(P, &P->epsilon, 0);
+  case (FLAT_ATOM):
+    return constant(P, &P->atom, 1);
+  case (FLAT_Z):
+    return (zStatement >= 0) ? reference(P, zStatement) : constant(P, &P->atom, 1);
+  case (FLAT_ID):
+    if (P->graph->definition[N->value] < 0) {
+      P->failed = 1;
+      return constant(P, &P->zero, -1);
+    }
+    return reference(P, P->graph->definition[N->value]);
+  case (FLAT_UNION):
+    children = malloc(N->children * sizeof(int));
+    for (int k = 0, c = flatFirstChild(n); k < N->children; k++, c = flatNextSibling(P->flat, c)) {
+      children[k] = compileNode(P, c);
+    }
+    s = addStep(P, COUNT_SUM, newSeries(P), 0);
+    for (int k = 0; k < N->children; k++) {
+      addOperand(P, children[k], 1, 1);
+    }
+    free(children);
+    return s;
+  case (FLAT_PROD):
+    s = constant(P, &P->epsilon, 0);
+    for (int k = 0, c = flatFirstChild(n); k < N->children; k++, c = flatNextSibling(P->flat, c)) {
+      s = product(P, s, compileNode(P, c));
+    }
+    return s;
+  case (FLAT_SUBST):
+    P->failed = 1;
+    return constant(P, &P->zero, -1);
+  default:
+    return compileConstruction(P, n);
+  }
+}
+
+/*
+  Helper function that compiles the expression rooted at node n, or returns the series of
+  an equal subtree already compiled if the grammar is shared.
+*/
+static int compileNode(Program* P, int n)
+{
+  if (P->memo == NULL) {
+    return compileExpression(P, n);
+  }
+  int first = P->flat->shared[n];
+  if (P->memo[first] < 0) {
+    P->memo[first] = compileExpression(P, n);
+  }
+  return P->memo[first];
+}
+
+/*
+  Helper function that computes the nullability of the nodes, children first.
+*/
+static void nodeNullability(Program* P)
+{
+  const FlatGrammar* flat = P->flat;
+  const GrammarGraph* graph = P->graph;
+
+  for (int n = flat->size - 1; n >= 0; n--) {
+    const FlatNode* N = &flat->nodes[n];
+    long long int min, max;
+    int s;
+    switch (N->op) {
+    case (FLAT_EPSILON):
+      P->nullable[n] = 1;
+      break;
+    case (FLAT_ATOM):
+      P->nullable[n] = 0;
+      break;
+    case (FLAT_Z):
+      P->nullable[n] = (graph->zStatement >= 0) && P->analysis->nullable[graph->zStatement];
+      break;
+    case (FLAT_ID):
+      s = graph->definition[N->value];
+      P->nullable[n] = (s >= 0) && P->analysis->nullable[s];
+      break;
+    case (FLAT_UNION):
+    case (FLAT_PROD):
+    case (FLAT_SUBST):
+      P->nullable[n] = (N->op != FLAT_UNION);
+      for (int k = 0, c = flatFirstChild(n); k < N->children; k++, c = flatNextSibling(flat, c)) {
+        P->nullable[n] = (N->op == FLAT_UNION) ? (P->nullable[n] || P->nullable[c]) : (P->nullable[n] && P->nullable[c]);
+      }
+      break;
+    default:
+      cardinalityRange(flat, n, &min, &max);
+      P->nullable[n] = (min <= max) && (min == 0 || P->nullable[n + 1]);
+    }
+  }
+}
+
+/*
+  Helper function that tells whether step S reads coefficient t of its operand k at size t,
+  given which series may have a constant term. Coefficient 0 of a factor of a product
+  only matters if the other factor may have a constant term, A(z^j) only reads coefficient
+  t of A at t = 0, and shifts and the proper divisors of t only read smaller coefficients.
+*/
+static int readsSameSize(const Program* P, const Step* S, int k, const char* constant)
+{
+  switch (S->op) {
+  case (COUNT_PRODUCT):
+    return constant[P->operands[S->first + 1 - k].series];
+  case (COUNT_SPREAD):
+    return constant[P->operands[S->first].series];
+  case (COUNT_SHIFT):
+  case (COUNT_PROPER_DIVISORS):
+    return 0;
+  default:
+    return 1;
+  }
+}
+
+/*
+  Helper function that reorders the steps so that each one comes after the steps setting
+  the coefficients it reads at the same size (see readsSameSize()). The steps are compiled
+  children first, but a statement may be referenced before it is compiled, and the terms
+  of a restricted construction read its argument even when the construction as a whole
+  does not (as T_1 = A in Set(A, card = 2)). Returns 0 if there is a cycle, which cannot
+  happen for a well-founded grammar.
+*/
+static int orderSteps(Program* P)
+{
+  int count = P->stepCount;
+  int* writer = malloc((P->series + 1) * sizeof(int)); // writer[s] is the step setting series s
+  char* constant = calloc(P->series + 1, 1); // constant[s] is 1 if series s may have a constant term
+  int* pending = calloc(count + 1, sizeof(int)); // number of steps that step k waits for
+  int* userOffsets = calloc(count + 2, sizeof(int));
+  int* users = malloc((P->operandCount + 1) * sizeof(int));
+  int* order = malloc((count + 1) * sizeof(int));
+
+  // which series may have a constant term (least fixpoint, as terms may be used before being set)
+  for (int k = 0; k < count; k++) {
+    writer[P->steps[k].target] = k;
+  }
+  for (int changed = 1; changed;) {
+    changed = 0;
+    for (int k = 0; k < count; k++) {
+      const Step* S = &P->steps[k];
+      const Operand* O = &P->operands[S->first];
+      int c = 0;
+      switch (S->op) {
+      case (COUNT_CONSTANT):
+        c = (S->parameter == 0);
+        break;
+      case (COUNT_SUM):
+        c = (S->parameter != 0);
+        for (int i = 0; i < S->count; i++) {
+          c = c || constant[O[i].series];
+        }
+        break;
+      case (COUNT_PRODUCT):
+        c = constant[O[0].series] && constant[O[1].series];
+        break;
+      case (COUNT_DIVIDE_INDEX):
+        c = (S->parameter != 0);
+        break;
+      case (COUNT_SPREAD):
+        c = constant[O[0].series];
+        break;
+      default: // SHIFT, MULTIPLY_INDEX, DIVISORS, PROPER_DIVISORS
+        c = 0;
+      }
+      if (c && !constant[S->target]) {
+        constant[S->target] = 1;
+        changed = 1;
+      }
+    }
+  }
+
+  // topological order (Kahn's algorithm), keeping the order of compilation where possible
+  for (int k = 0; k < count; k++) {
+    const Step* S = &P->steps[k];
+    for (int i = 0; i < S->count; i++) {
+      if (readsSameSize(P, S, i, constant)) {
+        pending[k]++;
+        userOffsets[writer[P->operands[S->first + i].series] + 2]++;
+      }
+    }
+  }
+  for (int k = 0; k < count; k++) {
+    userOffsets[k + 2] += userOffsets[k + 1];
+  }
+  for (int k = 0; k < count; k++) {
+    const Step* S = &P->steps[k];
+    for (int i = 0; i < S->count; i++) {
+      if (readsSameSize(P, S, i, constant)) {
+        users[userOffsets[writer[P->operands[S->first + i].series] + 1]++] = k;
+      }
+    }
+  }
+  int head = 0, tail = 0;
+  for (int k = 0; k < count; k++) {
+    if (pending[k] == 0) {
+      order[tail++] = k;
+    }
+  }
+  while (head < tail) {
+    int k = order[head++];
+    for (int u = userOffsets[k]; u < userOffsets[k + 1]; u++) {
+      if (--pending[users[u]] == 0) {
+        order[tail++] = users[u];
+      }
+    }
+  }
+
+  int success = (tail == count);
+  if (success) {
+    Step* steps = malloc((count + 1) * sizeof(Step));
+    P->productCount = 0;
+    for (int k = 0; k < count; k++) {
+      steps[k] = P->steps[order[k]];
+      if (steps[k].op == COUNT_PRODUCT) {
+        P->products[P->productCount++] = k;
+      }
+    }
+    free(P->steps);
+    P->steps = steps;
+    P->stepSpace = count + 1;
+  }
+  free(writer);
+  free(constant);
+  free(pending);
+  free(userOffsets);
+  free(users);
+  free(order);
+  return success;
+}
+
+static void freeProgram(Program* P)
+{
+  free(P->steps);
+  free(P->operands);
+  free(P->products);
+  free(P->roots);
+  free(P->degrees);
+  free(P->nullable);
+  free(P);
+}
+
+/*
+  Helper function that compiles the grammar into a program computing length coefficients,
+  or returns NULL (see countGrammar()).
+*/
+static Program* compileProgram(Grammar* grammar, OracleType type, int length)
+{
+  GrammarAnalysis* analysis = analyzeGrammar(grammar);
+  if (analysis == NULL || !analysis->wellFounded) {
+    return NULL;
+  }
+  FlatGrammar* flat = flattenGrammar(grammar);
+  int statements = flat->statements;
+  Program* P = calloc(1, sizeof(Program));
+  P->type = type;
+  P->length = length;
+  P->statements = statements;
+  P->roots = malloc((statements + 1) * sizeof(int));
+  P->nullable = malloc(flat->size + 1);
+  P->epsilon = P->atom = P->zero = -1;
+  P->flat = flat;
+  P->graph = analysis->graph;
+  P->analysis = analysis;
+
+  for (int n = 0; n < flat->size; n++) {
+    if (flatLimit(flat, n) > MAX_LIMIT) {
+      P->failed = 1;
+    }
+  }
+  for (int i = 0; i < statements; i++) {
+    P->roots[i] = newSeries(P);
+  }
+
+  if (flat->shared != NULL) {
+    P->memo = malloc((flat->size + 1) * sizeof(int));
+    memset(P->memo, -1, (flat->size + 1) * sizeof(int));
+  }
+  nodeNullability(P);
+  for (int i = 0; i < statements && !P->failed; i++) {
+    int s = compileNode(P, flat->roots[i]);
+    addStep(P, COUNT_SUM, P->roots[i], 0);
+    addOperand(P, s, 1, 1);
+  }
+  free(P->memo);
+  P->memo = NULL;
+  if (!P->failed && !orderSteps(P)) {
+    P->failed = 1;
+  }
+  freeFlatGrammar(flat);
+  P->flat = NULL;
+
+  if (P->failed) {
+    freeProgram(P);
+    return NULL;
+  }
+  return P;
+}
+
+/****************************** Exact counts ******************************/
+
+/*
+  Exact counts being reconstructed: each count x is a nonnegative integer below the product
+  M of the primes used so far, congruent to the count modulo each of them.
+*/
+typedef struct Reconstruction_s
+{
+  size_t count; // number of counts
+  int space; // number of digits reserved for each count
+  unsigned int* digits; // count k is digits[k * space], ..., least significant first
+  int* lengths; // lengths[k] is the number of significant digits of count k
+  unsigned int* modulus; // digits of M
+  int modulusLength;
+  unsigned int* powers; // work array: powers of 2^32 modulo the current prime
+} Reconstruction;
+
+/*
+  Helper function that combines residues modulo the prime p into the counts, by setting
+  each count x to x + M ((r - x) / M mod p), and returns the number of counts changed.
+*/
+static size_t reconstruct(Reconstruction* R, const unsigned int* residues, unsigned int p)
+{
+  int length = R->modulusLength;
+  unsigned int base = (unsigned int) ((1ULL << 32) % p);
+  unsigned int wrap = mulMod(base, base, p); // 2^64 mod p
+  size_t changed = 0;
+
+  // room for one more digit
+  if (R->space < length + 1) {
+    int space = 2 * R->space + 1;
+    unsigned int* digits = calloc(R->count * space + 1, sizeof(unsigned int));
+    for (size_t k = 0; k < R->count; k++) {
+      memcpy(digits + k * space, R->digits + k * R->space, R->space * sizeof(unsigned int));
+    }
+    free(R->digits);
+    R->digits = digits;
+    R->space = space;
+    R->modulus = realloc(R->modulus, (space + 1) * sizeof(unsigned int));
+    R->powers = realloc(R->powers, (space + 1) * sizeof(unsigned int));
+  }
+  R->powers[0] = 1;
+  for (int i = 1; i <= length; i++) {
+    R->powers[i] = mulMod(R->powers[i - 1], base, p);
+  }
+
+  // M mod p, and its inverse
+  unsigned int m = 0;
+  for (int i = 0; i < length; i++) {
+    m = addMod(m, mulMod(R->modulus[i] % p, R->powers[i], p), p);
+  }
+  unsigned int inverse = inverseMod(m, p);
+
+  for (size_t k = 0; k < R->count; k++) {
+    unsigned int* x = R->digits + k * R->space;
+    unsigned long long int s = 0, carries = 0;
+    for (int i = 0; i < R->lengths[k]; i++) { // x mod p, as the sum of its digits times 2^(32 i) mod p
+      unsigned long long int term = (unsigned long long int) x[i] * R->powers[i];
+      s += term;
+      carries += (s < term);
+    }
+    unsigned int residue = addMod((unsigned int) (s % p), mulMod((unsigned int) (carries % p), wrap, p), p);
+    unsigned int t = mulMod(addMod(residues[k], p - residue, p), inverse, p);
+    if (t == 0) {
+      continue;
+    }
+    unsigned long long int carry = 0;
+    for (int i = 0; i < length; i++) {
+      carry += (unsigned long long int) R->modulus[i] * t + x[i];
+      x[i] = (unsigned int) carry;
+      carry >>= 32;
+    }
+    x[length] += (unsigned int) carry;
+    int n = length + 1;
+    while (n > 0 && x[n - 1] == 0) {
+      n--;
+    }
+    R->lengths[k] = n;
+    changed++;
+  }
+
+  // M = M p
+  unsigned long long int carry = 0;
+  for (int i = 0; i < length; i++) {
+    carry += (unsigned long long int) R->modulus[i] * p;
+    R->modulus[i] = (unsigned int) carry;
+    carry >>= 32;
+  }
+  if (carry > 0) {
+    R->modulus[R->modulusLength++] = (unsigned int) carry;
+  }
+  return changed;
+}
+
+/*
+  Helper function that computes the exact counts, with primes c 2^k + 1 below 2^31 from
+  the largest down, 2^k being the length of the longest transform.
+*/
+static int exactCounts(const Program* program, Machine* M, Counts* counts)
+{
+  int length = M->length;
+  int k = 0;
+  while ((1 << k) < M->span) {
+    k++;
+  }
+  Reconstruction R;
+  R.count = (size_t) program->statements * length;
+  R.space = 1;
+  R.digits = calloc(R.count + 1, sizeof(unsigned int));
+  R.lengths = calloc(R.count + 1, sizeof(int));
+  R.modulus = malloc(2 * sizeof(unsigned int));
+  R.modulus[0] = 1;
+  R.modulusLength = 1;
+  R.powers = malloc(2 * sizeof(unsigned int));
+  unsigned int* residues = malloc((R.count + 1) * sizeof(unsigned int));
+
+  int stable = 0;
+  for (unsigned long long int c = ((1ULL << 31) - 2) >> k; c > 0 && stable < STABLE_PRIMES; c--) {
+    unsigned long long int q = (c << k) + 1;
+    if (q <= (unsigned long long int) program->largestDenominator || q < (unsigned long long int) length ||
+        !isPrime((unsigned int) q)) {
+      continue;
+    }
+    run(M, (unsigned int) q, residues);
+    stable = (reconstruct(&R, residues, (unsigned int) q) == 0) ? stable + 1 : 0;
+    counts->primes++;
+  }
+
+  if (stable == STABLE_PRIMES) {
+    int limbs = 1;
+    for (size_t i = 0; i < R.count; i++) {
+      if (R.lengths[i] > limbs) {
+        limbs = R.lengths[i];
+      }
+    }
+    counts->limbs = limbs;
+    counts->values = calloc(R.count * limbs + 1, sizeof(unsigned int));
+    for (size_t i = 0; i < R.count; i++) {
+      memcpy(counts->values + i * limbs, R.digits + i * R.space, R.lengths[i] * sizeof(unsigned int));
+    }
+  }
+  free(R.digits);
+  free(R.lengths);
+  free(R.modulus);
+  free(R.powers);
+  free(residues);
+  return stable == STABLE_PRIMES;
+}
+
+/********************************** Counting **********************************/
+
+Counts* countGrammar(Grammar* grammar, OracleType type, int size, unsigned int modulus)
+{
+  if (size < 0 || size > MAX_SIZE || (modulus != 0 && (modulus <= (unsigned int) size ||
+                                                         modulus >= (1U << 31) || !isPrime(modulus)))) {
+    return NULL;
+  }
+  Program* program = compileProgram(grammar, type, size + 1);
+  if (program == NULL) {
+    return NULL;
+  }
+  if (modulus != 0 && modulus <= (unsigned int) program->largestDenominator) {
+    freeProgram(program);
+    return NULL;
+  }
+
+  Machine* M = newMachine(program);
+  Counts* counts = calloc(1, sizeof(Counts));
+  counts->statements = program->statements;
+  counts->size = size;
+  counts->modulus = modulus;
+  counts->limbs = 1;
+  int success = 1;
+  if (modulus != 0) {
+    counts->primes = 1;
+    counts->values = malloc(((size_t) program->statements * (size + 1) + 1) * sizeof(unsigned int));
+    run(M, modulus, counts->values);
+  } else {
+    success = exactCounts(program, M, counts);
+  }
+
+  freeMachine(M);
+  freeProgram(program);
+  if (!success) {
+    freeCounts(counts);
+    return NULL;
+  }
+  return counts;
+}
+
+void freeCounts(Counts* counts)
+{
+  if (counts == NULL) {
+    return;
+  }
+  free(counts->values);
+  free(counts);
+}
+
+/********************************** Output **********************************/
+
+#define APPEND(buffer, literal) (bufferAppend((buffer), (literal), sizeof(literal) - 1)) // literal strings only
+#define DECIMAL_BASE 1000000000U // 10^9, the largest power of 10 below 2^32
+
+void countsWriteDecimal(const Counts* counts, int statement, int n, Buffer* buffer)
+{
+  const unsigned int* x = counts->values + ((size_t) statement * (counts->size + 1) + n) * counts->limbs;
+  int length = counts->limbs;
+  char chunk[16];
+
+  while (length > 0 && x[length - 1] == 0) {
+    length--;
+  }
+  if (length <= 1) {
+    bufferAppendInt(buffer, (length == 0) ? 0 : x[0]);
+    return;
+  }
+
+  // divide repeatedly by 10^9, the chunks coming out least significant first
+  unsigned int* quotient = malloc(length * sizeof(unsigned int));
+  unsigned int* chunks = malloc((length * 32 / 29 + 2) * sizeof(unsigned int));
+  int count = 0;
+  memcpy(quotient, x, length * sizeof(unsigned int));
+  while (length > 0) {
+    unsigned long long int remainder = 0;
+    for (int i = length - 1; i >= 0; i--) {
+      unsigned long long int current = (remainder << 32) | quotient[i];
+      quotient[i] = (unsigned int) (current / DECIMAL_BASE);
+      remainder = current % DECIMAL_BASE;
+    }
+    chunks[count++] = (unsigned int) remainder;
+    while (length > 0 && quotient[length - 1] == 0) {
+      length--;
+    }
+  }
+  bufferAppendInt(buffer, chunks[count - 1]);
+  for (int i = count - 2; i >= 0; i--) {
+    snprintf(chunk, sizeof(chunk), "%09u", chunks[i]);
+    bufferAppendString(buffer, chunk);
+  }
+  free(quotient);
+  free(chunks);
+}
+
+void countsWriteJson(const Grammar* grammar, const Counts* counts, Buffer* buffer)
+{
+  const StatementList* Slist = (StatementList*) grammar->component;
+
+  APPEND(buffer, "{");
+  for (int i = 0; i < counts->statements; i++) {
+    bufferAppendString(buffer, (i == 0) ? " \"" : ", \"");
+    bufferAppendString(buffer, Slist->components[i]->variable->name);
+    APPEND(buffer, "\": [");
+    for (int n = 0; n <= counts->size; n++) {
+      bufferAppendString(buffer, (n == 0) ? " " : ", ");
+      countsWriteDecimal(counts, i, n, buffer);
+    }
+    APPEND(buffer, " ]");
+  }
+  APPEND(buffer, " }");
+}
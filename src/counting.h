@@ -0,0 +1,67 @@
+#include "oracle.h"
+
+#ifndef COUNTINGTYPE
+#define COUNTINGTYPE
+/*
+  Counting sequences of the statements of a grammar: the number of objects of each size
+  0, ..., size described by each statement (for LABELLED classes, the number of labelled
+  objects, which is n! times the coefficient of z^n in the exponential generating function).
+  The counts are either reduced modulo a prime, or exact, in which case each of them is a
+  nonnegative integer of limbs digits in base 2^32, least significant first.
+*/
+typedef struct Counts_s
+{
+  int statements;
+  int size; // largest size counted
+  unsigned int modulus; // prime the counts are reduced modulo, or 0 if they are exact
+  int limbs; // number of digits of each exact count (1 if the counts are reduced)
+  int primes; // number of primes the exact counts were reconstructed from (1 if reduced)
+  unsigned int* values; // count of size n of statement i: values + (i * (size + 1) + n) * limbs
+} Counts;
+#endif
+
+#ifndef COUNTING_H
+#define COUNTING_H
+
+/*
+  Returns the number of objects of each size, up to size, described by each statement of
+  the grammar: modulo the given prime if modulus is not 0, and exactly otherwise. The
+  generating functions are computed as power series, coefficient by coefficient, in the
+  order of sizes: Union adds series, Prod multiplies them, and Set, PowerSet, Cycle and
+  Sequence apply the exponential, the logarithm or their Pólya counterparts (according to
+  the semantics given), restrictions to cardinality being expanded into sums of terms. All
+  products are online convolutions, computed in blocks by number-theoretic transforms, in
+  O(size log^2 size) operations each. Exact counts are reconstructed from their residues
+  modulo primes of the form c 2^k + 1 by the Chinese remainder theorem, with primes being
+  added until two of them in a row leave all counts unchanged.
+
+  Returns NULL if the grammar is an error or is not well-founded (see analyzeGrammar()),
+  uses Subst (which is not supported), takes an unrestricted PowerSet (or one restricted by
+  card >= k) of a class with objects of size 0, or restricts a cardinality beyond 2^20; if
+  size is negative or above 2^22; or if modulus is neither 0 nor a prime larger than size
+  (and than the restrictions to cardinality) and below 2^31. The counts do not depend on
+  the grammar, and should be freed with freeCounts().
+*/
+Counts* countGrammar(Grammar* grammar, OracleType type, int size, unsigned int modulus);
+
+void freeCounts(Counts* counts);
+
+/*
+  Writes the base-10 representation of the count of size n of statement i to the buffer.
+*/
+void countsWriteDecimal(const Counts* counts, int statement, int n, Buffer* buffer);
+
+/*
+  Writes the Json representation of the counts of the statements of the grammar to the
+  buffer, as an object mapping each symbol to the list of its counts:
+    { "A": [ 0, 1, 1, 2, ... ], ... }
+*/
+void countsWriteJson(const Grammar* grammar, const Counts* counts, Buffer* buffer);
+
+/*
+  Tells whether n < 2^32 is prime (Miller-Rabin with bases 2, 7 and 61, which is
+  deterministic in this range).
+*/
+int isPrime(unsigned int n);
+
+#endif
@@ -0,0 +1,553 @@
+#include <stdlib.h>
+#include <string.h>
+#include "document.h"
+#include "normal.h"
+
+#define COMPACTION_SLACK 65536 // bytes that can be parsed again before compacting, whatever the size of the text
+
+/*
+  Part of the text that holds one statement: from the byte after the top-level comma that
+  ends the previous statement (or from the beginning of the text), leading spaces and
+  comments included, to the comma that ends it (or to the end of the text). Spans do not
+  store their offsets, which every edit would have to shift: the span i begins after the
+  spans before it and their commas, which the tree of the document sums up.
+*/
+typedef struct Span_s
+{
+  size_t length; // number of bytes, without the comma after the statement
+  int lines; // number of newlines that the lexer counts in the span (those of C comments are not)
+  Grammar* error; // error found while parsing the span (NULL if it parsed)
+  int errorLine; // line of the error, from the first line of the span (lines before it may change)
+} Span;
+
+/*
+  Definition of a symbol by one of the statements replaced or inserted by an edit.
+*/
+typedef struct Definition_s
+{
+  int symbol;
+  int index; // index of the statement among those replaced (or inserted)
+  const Statement* statement;
+} Definition;
+
+typedef enum {CODE, C_COMMENT, LINE_COMMENT} ScanState;
+
+struct Document_s
+{
+  char* text; // NULL-terminated
+  size_t length, space;
+  Span* spans; // spans of the statements of the text, in order (there is always one)
+  int count, spanSpace;
+  size_t* widths; // Fenwick tree of the widths of the spans (their lengths plus 1, for their commas)
+  int* lineCounts; // Fenwick tree of the numbers of lines of the spans
+  Span* scanned; // spans found by the last scan
+  int scannedCount, scannedSpace;
+  ParseContext ctx; // arena and symbol table of the abstract syntax tree
+  Grammar* grammar; // statement i of its list is that of spans[i] (NULL if the span has an error)
+  int errorCount; // number of spans with an error
+  size_t parsed; // number of bytes parsed since the arena was created
+  Definition* definitions;
+  int definitionSpace;
+  unsigned int* marks; // marks[s] is the stamp of the last edit that changed symbol s (or stamp + 1 once reported)
+  int markSpace;
+  unsigned int stamp;
+  Buffer* names; // names of the symbols changed by the last edit, each NULL-terminated
+  size_t* offsets; // offsets of the names in the buffer
+  const char** symbols;
+  int symbolSpace;
+};
+
+/********************************** Offsets of the spans **********************************/
+
+/*
+  Helper function that builds the Fenwick trees of the spans, in time linear in their
+  number: entry i (from 1) sums the spans i - (i & -i), ..., i - 1.
+*/
+static void buildTrees(Document* D)
+{
+  D->widths = realloc(D->widths, (D->spanSpace + 1) * sizeof(size_t));
+  D->lineCounts = realloc(D->lineCounts, (D->spanSpace + 1) * sizeof(int));
+  for (int i = 1; i <= D->count; i++) {
+    D->widths[i] = D->spans[i - 1].length + 1;
+    D->lineCounts[i] = D->spans[i - 1].lines;
+  }
+  for (int i = 1; i <= D->count; i++) {
+    int parent = i + (i & -i);
+    if (parent <= D->count) {
+      D->widths[parent] += D->widths[i];
+      D->lineCounts[parent] += D->lineCounts[i];
+    }
+  }
+}
+
+/*
+  Helper function that adds width bytes and lines lines to span i, in the trees (widths
+  are unsigned, and a negative difference wraps around to the same sums).
+*/
+static void updateTrees(Document* D, int i, size_t width, int lines)
+{
+  for (i++; i <= D->count; i += i & -i) {
+    D->widths[i] += width;
+    D->lineCounts[i] += lines;
+  }
+}
+
+/*
+  Helper function that returns the offset of the first byte of span i.
+*/
+static size_t spanBegin(const Document* D, int i)
+{
+  size_t begin = 0;
+  for (; i > 0; i -= i & -i) {
+    begin += D->widths[i];
+  }
+  return begin;
+}
+
+/*
+  Helper function that returns the line of the text on which span i begins.
+*/
+static int spanLine(const Document* D, int i)
+{
+  int line = 1;
+  for (; i > 0; i -= i & -i) {
+    line += D->lineCounts[i];
+  }
+  return line;
+}
+
+/*
+  Helper function that returns the index of the span that holds the byte at offset (or
+  the comma after it), that is, the first span that ends at offset or after.
+*/
+static int findSpan(const Document* D, size_t offset)
+{
+  int step = 1;
+  while (2 * step <= D->count) {
+    step *= 2;
+  }
+  int i = 0; // number of spans known to end before offset
+  for (; step > 0; step /= 2) {
+    if (i + step <= D->count && D->widths[i + step] <= offset) {
+      i += step;
+      offset -= D->widths[i];
+    }
+  }
+  return i;
+}
+
+/********************************** Scanning and parsing **********************************/
+
+/*
+  Helper function that appends a span to those found by the current scan.
+*/
+static void addScanned(Document* D, size_t begin, size_t end, int lines)
+{
+  if (D->scannedCount == D->scannedSpace) {
+    D->scannedSpace = 2 * D->scannedSpace + 16;
+    D->scanned = realloc(D->scanned, D->scannedSpace * sizeof(Span));
+  }
+  Span* span = &D->scanned[D->scannedCount++];
+  span->length = end - begin;
+  span->lines = lines;
+  span->error = NULL;
+}
+
+/*
+  Helper function that finds the spans of the text from begin, which must be 0 or follow a
+  top-level comma, into D->scanned. Top-level commas are found as the lexer would (outside
+  of comments, which it cannot split), and outside of parentheses. The text is assumed to
+  be edited so that its bytes from edited on are the old bytes from edited - inserted +
+  removed on, while D->spans still holds the old spans, the first of which begins at begin:
+  as soon as a comma at or after edited was the end of the old span j (j >= first), the
+  spans after it are unchanged, and the scan stops there and returns j. Otherwise the scan
+  goes on to the end of the text, and returns the index of the last old span.
+*/
+static int scanSpans(Document* D, size_t begin, size_t edited, size_t inserted, size_t removed, int first)
+{
+  const char* text = D->text;
+  size_t length = D->length;
+  ScanState state = CODE;
+  int level = 0; // depth of nested C comments
+  int depth = 0; // depth of parentheses
+  int lines = 0;
+  int j = first;
+  size_t end = (first < D->count) ? begin + D->spans[first].length : 0; // old end of span j
+
+  D->scannedCount = 0;
+  for (size_t p = begin; p < length; p++) {
+    char c = text[p];
+    char next = (p + 1 < length) ? text[p + 1] : '\0';
+    switch (state) {
+    case (CODE):
+      if (c == ',' && depth <= 0) {
+        addScanned(D, begin, p, lines);
+        if (p >= edited) {
+          size_t old = p - inserted + removed;
+          while (j + 1 < D->count && end < old) {
+            j++;
+            end += 1 + D->spans[j].length;
+          }
+          if (j < D->count && end == old) {
+            return j;
+          }
+        }
+        begin = p + 1;
+        depth = 0;
+        lines = 0;
+      } else if (c == '(') {
+        depth++;
+      } else if (c == ')') {
+        depth--;
+      } else if (c == '\n') {
+        lines++;
+      } else if (c == '/' && next == '*') {
+        state = C_COMMENT;
+        level = 1;
+        p++;
+      } else if ((c == '/' && next == '/') || c == '#') {
+        state = LINE_COMMENT;
+        p += (c == '/');
+      }
+      break;
+    case (C_COMMENT):
+      if (c == '/' && next == '*') {
+        level++;
+        p++;
+      } else if (c == '*' && next == '/') {
+        if (--level == 0) {
+          state = CODE;
+        }
+        p++;
+      }
+      break;
+    case (LINE_COMMENT):
+      if (c == '\n') {
+        state = CODE;
+      }
+      break;
+    }
+  }
+  addScanned(D, begin, length, lines);
+  return D->count - 1;
+}
+
+/*
+  Helper function that parses the span, whose first byte and line are given, and returns
+  its statement, or NULL if it has an error (which is then stored in the span).
+*/
+static Statement* parseSpan(Document* D, Span* span, size_t begin, int line)
+{
+  Grammar* G = readStatementsCtx(&D->ctx, D->text + begin, span->length, line);
+  D->parsed += span->length;
+  if (G->type == ISERROR) {
+    span->error = G;
+    span->errorLine = ((Error*) G->component)->line - line;
+    return NULL;
+  }
+  span->error = NULL;
+  return ((StatementList*) G->component)->components[0]; // the span has no top-level comma
+}
+
+/*
+  Helper function that parses every span again, into a new arena (releasing the nodes
+  of the previous ones).
+*/
+static void parseDocument(Document* D)
+{
+  if (D->ctx.arena != NULL) {
+    freeArena(D->ctx.arena);
+  }
+  Arena* arena = newArena();
+  D->ctx.arena = arena;
+  D->ctx.symbols = newSymbolTable(arena, 1);
+
+  StatementList* Slist = newStatementList(arena, NULL);
+  Slist->components = arenaAlloc(arena, D->count * sizeof(Statement*));
+  Slist->size = D->count;
+  Slist->space = D->count;
+  D->grammar = newGrammar(arena, Slist, NOTERROR);
+  D->grammar->symbols = D->ctx.symbols;
+
+  size_t begin = 0;
+  int line = 1;
+  D->errorCount = 0;
+  for (int i = 0; i < D->count; i++) {
+    Slist->components[i] = parseSpan(D, &D->spans[i], begin, line);
+    D->errorCount += (D->spans[i].error != NULL);
+    begin += D->spans[i].length + 1;
+    line += D->spans[i].lines;
+  }
+  D->parsed = 0;
+}
+
+/********************************** Documents **********************************/
+
+Document* newDocument(const char* text, size_t length)
+{
+  Document* D = calloc(1, sizeof(Document));
+  D->text = malloc(length + 1);
+  memcpy(D->text, text, length);
+  D->text[length] = '\0';
+  D->length = length;
+  D->space = length;
+  D->names = newBuffer();
+
+  scanSpans(D, 0, 0, 0, 0, 0);
+  D->spans = D->scanned; // take over the spans scanned
+  D->count = D->scannedCount;
+  D->spanSpace = D->scannedSpace;
+  D->scanned = NULL;
+  D->scannedCount = 0;
+  D->scannedSpace = 0;
+  buildTrees(D);
+  parseDocument(D);
+  return D;
+}
+
+void freeDocument(Document* document)
+{
+  if (document == NULL) {
+    return;
+  }
+  freeArena(document->ctx.arena);
+  free(document->text);
+  free(document->spans);
+  free(document->widths);
+  free(document->lineCounts);
+  free(document->scanned);
+  free(document->definitions);
+  free(document->marks);
+  freeBuffer(document->names);
+  free(document->offsets);
+  free(document->symbols);
+  free(document);
+}
+
+Grammar* documentGrammar(Document* document)
+{
+  if (document->errorCount == 0) {
+    return document->grammar;
+  }
+
+  // the error that parsing the whole text reports last: the parser stops at its first
+  // error, and the lexer goes on after its errors
+  Grammar* error = NULL;
+  int line = 1;
+  for (int i = 0; i < document->count; i++) {
+    const Span* span = &document->spans[i];
+    if (span->error != NULL) {
+      error = span->error;
+      ((Error*) error->component)->line = line + span->errorLine;
+      if (((Error*) error->component)->type == PARSER) {
+        break;
+      }
+    }
+    line += span->lines;
+  }
+  return error;
+}
+
+const char* documentText(const Document* document, size_t* length)
+{
+  *length = document->length;
+  return document->text;
+}
+
+/*
+  Helper function that replaces the bytes start, ..., end - 1 of the text.
+*/
+static void spliceText(Document* D, size_t start, size_t end, const char* replacement, size_t length)
+{
+  size_t newLength = D->length - (end - start) + length;
+  if (newLength > D->space) {
+    D->space = 2 * newLength;
+    D->text = realloc(D->text, D->space + 1);
+  }
+  memmove(D->text + start + length, D->text + end, D->length - end + 1); // with the NULL character
+  memcpy(D->text + start, replacement, length);
+  D->length = newLength;
+}
+
+static int compareDefinitions(const void* a, const void* b)
+{
+  const Definition* A = (const Definition*) a;
+  const Definition* B = (const Definition*) b;
+  if (A->symbol != B->symbol) {
+    return (A->symbol < B->symbol) ? -1 : 1;
+  }
+  return (A->index > B->index) - (A->index < B->index);
+}
+
+/*
+  Helper function that collects the definitions of the count statements (skipping NULL
+  ones) into D->definitions from offset on, sorted by symbol, and returns their number.
+*/
+static int collectDefinitions(Document* D, Statement** statements, int count, int offset)
+{
+  int size = 0;
+  for (int k = 0; k < count; k++) {
+    if (statements[k] != NULL) {
+      Definition* d = &D->definitions[offset + size++];
+      d->symbol = statements[k]->variable->symbol;
+      d->index = k;
+      d->statement = statements[k];
+    }
+  }
+  qsort(D->definitions + offset, size, sizeof(Definition), compareDefinitions);
+  return size;
+}
+
+/*
+  Helper function that records in change (if not NULL) the symbols whose definitions
+  differ between the statements before the edit and those that replace them: those defined by a
+  different number of statements, or by statements whose expressions differ (in order).
+*/
+static void recordChange(Document* D, Statement** before, int beforeCount, Statement** after, int afterCount, DocumentChange* change)
+{
+  if (change == NULL) {
+    return;
+  }
+
+  if (beforeCount + afterCount > D->definitionSpace) {
+    D->definitionSpace = 2 * (beforeCount + afterCount);
+    D->definitions = realloc(D->definitions, D->definitionSpace * sizeof(Definition));
+  }
+  int symbolCount = D->ctx.symbols->size;
+  if (symbolCount > D->markSpace) {
+    D->marks = realloc(D->marks, 2 * symbolCount * sizeof(unsigned int));
+    memset(D->marks + D->markSpace, 0, (2 * symbolCount - D->markSpace) * sizeof(unsigned int));
+    D->markSpace = 2 * symbolCount;
+  }
+  D->stamp += 2;
+  if (D->stamp == 0) { // the stamps wrapped around
+    memset(D->marks, 0, D->markSpace * sizeof(unsigned int));
+    D->stamp = 2;
+  }
+
+  int a = 0, aEnd = collectDefinitions(D, before, beforeCount, 0);
+  int b = aEnd, bEnd = aEnd + collectDefinitions(D, after, afterCount, aEnd);
+  const Definition* d = D->definitions;
+  while (a < aEnd || b < bEnd) {
+    int s = (b == bEnd || (a < aEnd && d[a].symbol < d[b].symbol)) ? d[a].symbol : d[b].symbol;
+    int a2 = a, b2 = b;
+    while (a2 < aEnd && d[a2].symbol == s) {
+      a2++;
+    }
+    while (b2 < bEnd && d[b2].symbol == s) {
+      b2++;
+    }
+    int same = (a2 - a == b2 - b);
+    for (int k = 0; same && k < a2 - a; k++) {
+      same = (compareExpressions(d[a + k].statement->expression, d[b + k].statement->expression) == 0);
+    }
+    if (!same) {
+      D->marks[s] = D->stamp;
+    }
+    a = a2;
+    b = b2;
+  }
+
+  // report the symbols in order of appearance, in the statements after the edit and then before
+  bufferClear(D->names);
+  int count = 0;
+  for (int side = 0; side < 2; side++) {
+    Statement** statements = (side == 0) ? after : before;
+    int size = (side == 0) ? afterCount : beforeCount;
+    for (int k = 0; k < size; k++) {
+      if (statements[k] == NULL || D->marks[statements[k]->variable->symbol] != D->stamp) {
+        continue;
+      }
+      const Id* variable = statements[k]->variable;
+      D->marks[variable->symbol] = D->stamp + 1;
+      if (count == D->symbolSpace) {
+        D->symbolSpace = 2 * D->symbolSpace + 16;
+        D->offsets = realloc(D->offsets, D->symbolSpace * sizeof(size_t));
+        D->symbols = realloc(D->symbols, D->symbolSpace * sizeof(const char*));
+      }
+      D->offsets[count++] = D->names->length;
+      bufferAppend(D->names, variable->name, variable->length + 1); // with the NULL character
+    }
+  }
+  for (int k = 0; k < count; k++) { // the buffer does not move anymore
+    D->symbols[k] = D->names->data + D->offsets[k];
+  }
+  change->symbols = D->symbols;
+  change->symbolCount = count;
+}
+
+int editDocument(Document* document, size_t start, size_t end, const char* replacement, size_t length, DocumentChange* change)
+{
+  Document* D = document;
+  if (start > end || end > D->length) {
+    return -1;
+  }
+  spliceText(D, start, end, replacement, length);
+
+  // the first span that the edit touches (with the comma that ends it), then the spans of
+  // the new text from there, until they are the old ones again
+  int first = findSpan(D, start);
+  size_t begin = spanBegin(D, first);
+  int last = scanSpans(D, begin, start + length, length, end - start, first);
+  int removed = last - first + 1;
+  int inserted = D->scannedCount;
+
+  int line = spanLine(D, first);
+  Statement** statements = malloc(inserted * sizeof(Statement*));
+  for (int k = 0; k < inserted; k++) {
+    statements[k] = parseSpan(D, &D->scanned[k], begin, line);
+    begin += D->scanned[k].length + 1;
+    line += D->scanned[k].lines;
+  }
+
+  StatementList* Slist = (StatementList*) D->grammar->component;
+  recordChange(D, Slist->components + first, removed, statements, inserted, change);
+  if (change != NULL) {
+    change->first = first;
+    change->removed = removed;
+    change->inserted = inserted;
+  }
+
+  // splice the new spans and statements in place of the old ones
+  for (int i = first; i <= last; i++) {
+    D->errorCount -= (D->spans[i].error != NULL);
+  }
+  for (int k = 0; k < inserted; k++) {
+    D->errorCount += (D->scanned[k].error != NULL);
+  }
+  if (inserted == removed) { // the later spans keep their indices: update the trees in place
+    for (int k = 0; k < inserted; k++) {
+      const Span* before = &D->spans[first + k];
+      const Span* after = &D->scanned[k];
+      updateTrees(D, first + k, after->length - before->length, after->lines - before->lines);
+    }
+    memcpy(D->spans + first, D->scanned, inserted * sizeof(Span));
+    memcpy(Slist->components + first, statements, inserted * sizeof(Statement*));
+  } else { // the later statements move in the list of the grammar, and the trees are built again
+    int count = D->count - removed + inserted;
+    if (count > D->spanSpace) {
+      D->spanSpace = 2 * count;
+      D->spans = realloc(D->spans, D->spanSpace * sizeof(Span));
+    }
+    if (count > Slist->space) {
+      Slist->components = arenaGrow(D->ctx.arena, Slist->components, Slist->size * sizeof(Statement*), 2 * count * sizeof(Statement*));
+      Slist->space = 2 * count;
+    }
+    int tail = D->count - last - 1;
+    memmove(D->spans + first + inserted, D->spans + last + 1, tail * sizeof(Span));
+    memmove(Slist->components + first + inserted, Slist->components + last + 1, tail * sizeof(Statement*));
+    memcpy(D->spans + first, D->scanned, inserted * sizeof(Span));
+    memcpy(Slist->components + first, statements, inserted * sizeof(Statement*));
+    D->count = count;
+    Slist->size = count;
+    buildTrees(D);
+  }
+  D->grammar->sharing = NULL;
+  D->grammar->graph = NULL;
+  free(statements);
+
+  if (D->parsed > 2 * D->length + COMPACTION_SLACK) { // the arena is mostly replaced nodes
+    parseDocument(D);
+  }
+  return 0;
+}
@@ -0,0 +1,73 @@
+#include "context.h"
+
+#ifndef DOCUMENTTYPE
+#define DOCUMENTTYPE
+/*
+  Text of a grammar kept together with its abstract syntax tree, which is updated
+  statement by statement as the text is edited (see editDocument()).
+*/
+typedef struct Document_s Document;
+
+/*
+  What an edit did to the statements of a document: the statements first, ...,
+  first + removed - 1 were replaced by the statements first, ..., first + inserted - 1, and
+  the definitions of the symbols listed changed (they were added, removed or modified). A
+  statement that does not parse defines nothing.
+*/
+typedef struct DocumentChange_s
+{
+  int first; // index of the first statement replaced
+  int removed; // number of statements replaced
+  int inserted; // number of statements put in their place
+  const char** symbols; // names of the symbols whose definitions changed, in order of appearance
+  int symbolCount;
+} DocumentChange;
+#endif
+
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+/*
+  Parses the first length bytes of the text (which is copied) into a new document, to be
+  freed with freeDocument().
+*/
+Document* newDocument(const char* text, size_t length);
+
+void freeDocument(Document* document);
+
+/*
+  Returns the grammar of the current text of the document, as readGrammarFromBuffer() would
+  parse it: an error, or the list of its statements. The grammar belongs to the document
+  and should not be modified nor freed; it is only valid until the next edit, but
+  resolveGrammar() and the other read-only passes can be run on it in between. Its symbol
+  table is that of the document, so it may also contain the symbols of statements that
+  were edited away.
+*/
+Grammar* documentGrammar(Document* document);
+
+/*
+  Returns the current text of the document, and sets length to its number of bytes. The
+  text is NULL-terminated, and is only valid until the next edit.
+*/
+const char* documentText(const Document* document, size_t* length);
+
+/*
+  Replaces the bytes start, ..., end - 1 of the text of the document by the first length
+  bytes of replacement, then parses again only the statements that the edit touched: the
+  top-level commas that separate statements are found again from the beginning of the
+  first statement touched, until one of them is a comma that was already there after the
+  edit, where the statements are the same as before (so an edit inside a statement usually
+  parses that statement alone, and one that opens a comment parses up to where the comment
+  is closed). The statements parsed are spliced into the list of statements of the
+  grammar, and the change is stored in change, if not NULL (its names belong to the
+  document, and are valid until the next edit). The work done is proportional to the size
+  of the statements parsed again, plus a logarithmic number of steps per statement to find
+  and update their offsets and lines, apart from moving the text (and the later statements
+  in the list of the grammar, when their number changes); the nodes they replace are only
+  released when those parsed since the document was last compacted are twice as large as
+  the text, by parsing it all again.
+  Returns 0, or -1 (and does nothing) if the range is not within the text.
+*/
+int editDocument(Document* document, size_t start, size_t end, const char* replacement, size_t length, DocumentChange* change);
+
+#endif
@@ -0,0 +1,280 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "flat.h"
+#include "share.h"
+
+#define INITIAL_SPACE 1024 // initial number of nodes the flat grammar can hold
+
+/*
+  Helper function that returns the operation of an expression type.
+*/
+static FlatOp flatOp(enum yytokentype type)
+{
+  switch (type) {
+  case (EPSILON): return FLAT_EPSILON;
+  case (ATOM): return FLAT_ATOM;
+  case (Z): return FLAT_Z;
+  case (ID): return FLAT_ID;
+  case (UNION): return FLAT_UNION;
+  case (PROD): return FLAT_PROD;
+  case (SUBST): return FLAT_SUBST;
+  case (SET): return FLAT_SET;
+  case (POWERSET): return FLAT_POWERSET;
+  case (SEQUENCE): return FLAT_SEQUENCE;
+  default: return FLAT_CYCLE;
+  }
+}
+
+/*
+  State of the flattening of a grammar: the space of the arrays being filled, and, for a
+  shared grammar (see shareGrammar()), the node of the first occurrence of each distinct
+  expression (-1 until it is flattened).
+*/
+typedef struct Flattener_s
+{
+  FlatGrammar* flat;
+  int space; // number of nodes that flat->nodes can hold
+  int limitSpace; // number of values that flat->limits can hold
+  const Sharing* sharing;
+  int* first;
+} Flattener;
+
+/*
+  Helper function that appends an expression and its subexpressions (in preorder) to the
+  nodes of the flat grammar, and returns the index of its node. The later occurrences of a
+  shared expression are copies of the nodes of the first one.
+*/
+static int flattenExpression(Flattener* F, const Expression* E)
+{
+  FlatGrammar* flat = F->flat;
+  int shared = (F->sharing != NULL) ? sharingIndex(F->sharing, E) : -1;
+  if (shared >= 0 && F->first[shared] >= 0) {
+    int first = F->first[shared];
+    int span = flat->nodes[first].span;
+    while (flat->size + span > F->space) {
+      F->space *= 2;
+      flat->nodes = realloc(flat->nodes, F->space * sizeof(FlatNode));
+      flat->shared = realloc(flat->shared, F->space * sizeof(int));
+    }
+    int node = flat->size;
+    memcpy(flat->nodes + node, flat->nodes + first, span * sizeof(FlatNode));
+    memcpy(flat->shared + node, flat->shared + first, span * sizeof(int));
+    flat->size += span;
+    return node;
+  }
+
+  if (flat->size >= F->space) {
+    F->space *= 2;
+    flat->nodes = realloc(flat->nodes, F->space * sizeof(FlatNode));
+    if (flat->shared != NULL) {
+      flat->shared = realloc(flat->shared, F->space * sizeof(int));
+    }
+  }
+  int node = flat->size++;
+  FlatNode* N = &flat->nodes[node];
+  N->op = flatOp(E->type);
+  N->restriction = E->restriction;
+  N->reserved = 0;
+  N->value = -1;
+  N->children = 0;
+  if (flat->shared != NULL) {
+    flat->shared[node] = node;
+  }
+  if (shared >= 0) {
+    F->first[shared] = node;
+  }
+
+  switch (E->type) {
+  case (ID):
+    N->value = ((Id*) E->component)->symbol;
+    break;
+  case (UNION):
+  case (PROD):
+  case (SUBST): ;
+    ExpressionList* Elist = (ExpressionList*) E->component;
+    N->children = Elist->size;
+    for (int i = 0; i < Elist->size; i++) {
+      flattenExpression(F, Elist->components[i]);
+    }
+    break;
+  case (SET):
+  case (POWERSET):
+  case (SEQUENCE):
+  case (CYCLE):
+    if (E->restriction != NONE) {
+      if (flat->limitCount >= F->limitSpace) {
+        F->limitSpace = 2 * F->limitSpace + 1;
+        flat->limits = realloc(flat->limits, F->limitSpace * sizeof(long long int));
+      }
+      flat->limits[flat->limitCount] = E->limit;
+      flat->nodes[node].value = flat->limitCount++; // N may have moved
+    }
+    flat->nodes[node].children = 1;
+    flattenExpression(F, (Expression*) E->component);
+    break;
+  default:
+    break;
+  }
+
+  flat->nodes[node].span = flat->size - node;
+  return node;
+}
+
+FlatGrammar* flattenGrammar(const Grammar* grammar)
+{
+  if (grammar->type == ISERROR) {
+    return NULL;
+  }
+
+  const StatementList* Slist = (StatementList*) grammar->component;
+  Flattener F = {NULL, INITIAL_SPACE, 0, grammar->sharing, NULL};
+
+  FlatGrammar* flat = malloc(sizeof(FlatGrammar));
+  F.flat = flat;
+  flat->nodes = malloc(F.space * sizeof(FlatNode));
+  flat->shared = NULL;
+  if (F.sharing != NULL) {
+    flat->shared = malloc(F.space * sizeof(int));
+    F.first = malloc((F.sharing->distinct + 1) * sizeof(int));
+    memset(F.first, -1, (F.sharing->distinct + 1) * sizeof(int));
+  }
+  flat->size = 0;
+  flat->limits = NULL;
+  flat->limitCount = 0;
+  flat->statements = Slist->size;
+  flat->roots = malloc(Slist->size * sizeof(int));
+  flat->variables = malloc(Slist->size * sizeof(int));
+  flat->mapping = NULL;
+  flat->mappingSize = 0;
+
+  // copy the names, so that the result does not depend on the grammar
+  const SymbolTable* symbols = grammar->symbols;
+  flat->symbols = symbols->size;
+  flat->nameOffsets = malloc((symbols->size + 1) * sizeof(int));
+  flat->namesSize = 0;
+  for (int s = 0; s < symbols->size; s++) {
+    flat->nameOffsets[s] = flat->namesSize;
+    flat->namesSize += symbols->lengths[s] + 1;
+  }
+  flat->nameOffsets[symbols->size] = flat->namesSize;
+  flat->names = malloc(flat->namesSize + 1);
+  for (int s = 0; s < symbols->size; s++) {
+    memcpy(flat->names + flat->nameOffsets[s], symbols->names[s], symbols->lengths[s]);
+    flat->names[flat->nameOffsets[s] + symbols->lengths[s]] = '\0';
+  }
+
+  for (int i = 0; i < Slist->size; i++) {
+    flat->variables[i] = Slist->components[i]->variable->symbol;
+    flat->roots[i] = flattenExpression(&F, Slist->components[i]->expression);
+  }
+  free(F.first);
+
+  // release the unused space
+  flat->nodes = realloc(flat->nodes, (flat->size > 0 ? flat->size : 1) * sizeof(FlatNode));
+  if (flat->shared != NULL) {
+    flat->shared = realloc(flat->shared, (flat->size > 0 ? flat->size : 1) * sizeof(int));
+  }
+  return flat;
+}
+
+void freeFlatGrammar(FlatGrammar* flat)
+{
+  if (flat == NULL) {
+    return;
+  }
+  if (flat->mapping != NULL) { // the arrays point into the mapping
+    munmap(flat->mapping, flat->mappingSize);
+  } else {
+    free(flat->nodes);
+    free(flat->limits);
+    free(flat->roots);
+    free(flat->variables);
+    free(flat->names);
+    free(flat->nameOffsets);
+  }
+  free(flat->shared);
+  free(flat);
+}
+
+/********************************** Json **********************************/
+
+#define APPEND(buffer, literal) (bufferAppend((buffer), (literal), sizeof(literal) - 1)) // literal strings only
+
+/*
+  Helper function that writes the Json representation of the subtree rooted at the node
+  (see expressionWriteJson()).
+*/
+static void flatExpressionWriteJson(const FlatGrammar* flat, int node, Buffer* buffer)
+{
+  const FlatNode* N = &flat->nodes[node];
+
+  switch (N->op) {
+  case (FLAT_ATOM):
+    APPEND(buffer, "{ \"type\": \"unit\", \"unit\": \"Atom\" }");
+    return;
+  case (FLAT_EPSILON):
+    APPEND(buffer, "{ \"type\": \"unit\", \"unit\": \"Epsilon\" }");
+    return;
+  case (FLAT_Z):
+    APPEND(buffer, "{ \"type\": \"id\", \"id\": \"Z\" }");
+    return;
+  case (FLAT_ID):
+    APPEND(buffer, "{ \"type\": \"id\", \"id\": \"");
+    bufferAppendString(buffer, flatSymbolName(flat, N->value));
+    APPEND(buffer, "\" }");
+    return;
+  case (FLAT_UNION):
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"Union\", \"param\": [ ");
+    break;
+  case (FLAT_PROD):
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"Prod\", \"param\": [ ");
+    break;
+  case (FLAT_SUBST):
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"Subst\", \"param\": [ ");
+    break;
+  case (FLAT_SET):
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"Set\", \"param\": [");
+    break;
+  case (FLAT_POWERSET):
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"PowerSet\", \"param\": [");
+    break;
+  case (FLAT_SEQUENCE):
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"Sequence\", \"param\": [");
+    break;
+  default:
+    APPEND(buffer, "{ \"type\": \"op\", \"op\": \"Cycle\", \"param\": [");
+    break;
+  }
+
+  int child = flatFirstChild(node);
+  for (int k = 0; k < N->children; k++, child = flatNextSibling(flat, child)) {
+    if (k > 0) {
+      APPEND(buffer, ", ");
+    }
+    flatExpressionWriteJson(flat, child, buffer);
+  }
+
+  if (N->op == FLAT_UNION || N->op == FLAT_PROD || N->op == FLAT_SUBST) {
+    APPEND(buffer, " ] }");
+  } else {
+    APPEND(buffer, "]");
+    restrictionWriteJson(N->restriction, flatLimit(flat, node), buffer);
+    APPEND(buffer, " }");
+  }
+}
+
+void flatGrammarWriteJson(const FlatGrammar* flat, Buffer* buffer)
+{
+  APPEND(buffer, "{ ");
+  for (int i = 0; i < flat->statements; i++) {
+    if (i > 0) {
+      APPEND(buffer, ", ");
+    }
+    APPEND(buffer, "\"");
+    bufferAppendString(buffer, flatSymbolName(flat, flat->variables[i]));
+    APPEND(buffer, "\": ");
+    flatExpressionWriteJson(flat, flat->roots[i], buffer);
+  }
+  APPEND(buffer, "}\n");
+}
@@ -0,0 +1,99 @@
+#include "absyn.h"
+
+#ifndef FLATTYPE
+#define FLATTYPE
+/*
+  Operations of the nodes of a flat grammar (one per kind of expression).
+*/
+typedef enum {FLAT_EPSILON, FLAT_ATOM, FLAT_Z, FLAT_ID, FLAT_UNION, FLAT_PROD, FLAT_SUBST,
+              FLAT_SET, FLAT_POWERSET, FLAT_SEQUENCE, FLAT_CYCLE} FlatOp;
+
+/*
+  Node of a flat grammar (16 bytes). The children of a node immediately follow it, in
+  preorder, so that its first child is the next node, and the sibling after a child is
+  found by skipping the span of the child.
+*/
+typedef struct FlatNode_s
+{
+  unsigned char op; // FlatOp
+  unsigned char restriction; // Restriction
+  unsigned short reserved;
+  int value; // symbol for FLAT_ID, index in limits for restricted nodes, -1 otherwise
+  int children; // number of children
+  int span; // number of nodes of the subtree rooted at this node (including itself)
+} FlatNode;
+
+/*
+  Frozen representation of a grammar, as one contiguous array of nodes rather than a
+  graph of pointers. The expression of statement i is rooted at roots[i], and these
+  expressions are stored in order, so that the nodes of statement i are exactly
+  nodes[roots[i]], ..., nodes[roots[i] + nodes[roots[i]].span - 1].
+*/
+typedef struct FlatGrammar_s
+{
+  FlatNode* nodes;
+  int size; // number of nodes
+  long long int* limits; // numerical values of the restrictions to cardinality
+  int limitCount;
+  int* roots; // roots[i] is the node of the expression of statement i
+  int* variables; // variables[i] is the symbol defined by statement i
+  int statements; // number of statements
+  char* names; // names of the symbols, NULL-terminated and stored one after the other
+  int* nameOffsets; // symbol s is named names + nameOffsets[s] (symbols + 1 entries)
+  int symbols; // number of symbols
+  int namesSize; // number of characters of names (including the NULL characters)
+  int* shared; // shared[n] is the first node whose subtree equals that of n (see shareGrammar()), or NULL
+  void* mapping; // memory-mapped file the arrays point into (NULL if they are allocated)
+  size_t mappingSize;
+} FlatGrammar;
+#endif
+
+#ifndef FLAT_H
+#define FLAT_H
+
+/*
+  Returns the flat representation of the grammar, built in a single pass over its abstract
+  syntax tree, or NULL if the grammar is an error. The result does not depend on the
+  grammar, which can be freed independently. If the grammar is shared (see shareGrammar()),
+  each distinct expression is flattened once, its later occurrences being copies of its
+  nodes, and shared tells, for each node, the first node of which it is a copy (evaluators
+  may then compute each distinct expression once).
+*/
+FlatGrammar* flattenGrammar(const Grammar* grammar);
+
+void freeFlatGrammar(FlatGrammar* flat);
+
+/*
+  Writes the Json representation of the flat grammar to the buffer (the same as that of
+  the grammar it was built from, see grammarWriteJson()).
+*/
+void flatGrammarWriteJson(const FlatGrammar* flat, Buffer* buffer);
+
+/*
+  Functions to iterate over the children of a node, as in:
+    for (int k = 0, c = flatFirstChild(node); k < flat->nodes[node].children; k++, c = flatNextSibling(flat, c))
+*/
+static inline int flatFirstChild(int node)
+{
+  return node + 1;
+}
+
+static inline int flatNextSibling(const FlatGrammar* flat, int node)
+{
+  return node + flat->nodes[node].span;
+}
+
+static inline const char* flatSymbolName(const FlatGrammar* flat, int symbol)
+{
+  return flat->names + flat->nameOffsets[symbol];
+}
+
+/*
+  Returns the numerical value of the restriction to cardinality of the node (0 if there is none).
+*/
+static inline long long int flatLimit(const FlatGrammar* flat, int node)
+{
+  return (flat->nodes[node].restriction == NONE) ? 0 : flat->limits[flat->nodes[node].value];
+}
+
+#endif
@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <string.h>
+#include "graph.h"
+
+/*
+  State of the resolution pass: the targets of the current statement are appended to a
+  temporary array, using a stamp per statement to avoid repetitions.
+*/
+typedef struct Resolver_s
+{
+  GrammarGraph* graph;
+  int* stamp; // stamp[j] is the last statement that got an arc to statement j
+  int current; // statement being resolved
+  int* targets; // malloc'ed, copied into the arena at the end
+  int length;
+  int space;
+  ResolutionError* errors; // malloc'ed, copied into the arena at the end
+  int errorCount;
+  int errorSpace;
+} Resolver;
+
+/*
+  Helper function that records an error.
+*/
+static void addError(Resolver* R, ResolutionErrorType type, int symbol, int statement)
+{
+  if (R->errorCount >= R->errorSpace) {
+    R->errorSpace = 2 * R->errorSpace + 1;
+    R->errors = realloc(R->errors, R->errorSpace * sizeof(ResolutionError));
+  }
+  R->errors[R->errorCount].type = type;
+  R->errors[R->errorCount].symbol = symbol;
+  R->errors[R->errorCount].statement = statement;
+  R->errorCount++;
+}
+
+/*
+  Helper function that adds an arc from the current statement to the given one.
+*/
+static void addArc(Resolver* R, int target)
+{
+  if (R->stamp[target] == R->current) { // already there
+    return;
+  }
+  R->stamp[target] = R->current;
+
+  if (R->length >= R->space) {
+    R->space = 2 * R->space + 1;
+    R->targets = realloc(R->targets, R->space * sizeof(int));
+  }
+  R->targets[R->length++] = target;
+}
+
+/*
+  Helper function that binds the identifiers of an expression, and adds the arcs.
+*/
+static void resolveExpression(Resolver* R, Expression* E)
+{
+  switch (E->type) {
+  case (ID): ;
+    Id* id = (Id*) E->component;
+    id->definition = (id->symbol >= 0) ? R->graph->definition[id->symbol] : -1;
+    if (id->definition >= 0) {
+      addArc(R, id->definition);
+    } else {
+      addError(R, UNDEFINED_SYMBOL, id->symbol, R->current);
+    }
+    return;
+  case (Z):
+    if (R->graph->zStatement >= 0) {
+      addArc(R, R->graph->zStatement);
+    }
+    return;
+  case (UNION):
+  case (PROD):
+  case (SUBST): ;
+    ExpressionList* Elist = (ExpressionList*) E->component;
+    for (int i = 0; i < Elist->size; i++) {
+      resolveExpression(R, Elist->components[i]);
+    }
+    return;
+  case (SET):
+  case (POWERSET):
+  case (SEQUENCE):
+  case (CYCLE):
+    resolveExpression(R, (Expression*) E->component);
+    return;
+  default:
+    return;
+  }
+}
+
+GrammarGraph* resolveGrammar(Grammar* grammar)
+{
+  if (grammar->type == ISERROR) {
+    return NULL;
+  }
+  if (grammar->graph != NULL) { // already resolved, and not changed since
+    return grammar->graph;
+  }
+
+  Arena* arena = grammar->arena;
+  SymbolTable* symbols = grammar->symbols;
+  StatementList* Slist = (StatementList*) grammar->component;
+  int size = Slist->size;
+
+  GrammarGraph* graph = arenaAlloc(arena, sizeof(GrammarGraph));
+  graph->size = size;
+  graph->symbols = symbols->size;
+  graph->definition = arenaAlloc(arena, symbols->size * sizeof(int));
+  graph->offsets = arenaAlloc(arena, (size + 1) * sizeof(int));
+  memset(graph->definition, -1, symbols->size * sizeof(int));
+
+  Resolver R = {graph, malloc(size * sizeof(int)), -1, NULL, 0, 0, NULL, 0, 0};
+  memset(R.stamp, -1, size * sizeof(int));
+
+  // first pass: definitions
+  for (int i = 0; i < size; i++) {
+    Id* variable = Slist->components[i]->variable;
+    variable->definition = i;
+    if (variable->symbol < 0) { // not interned: cannot be referenced
+      continue;
+    } else if (graph->definition[variable->symbol] < 0) {
+      graph->definition[variable->symbol] = i;
+    } else {
+      addError(&R, DUPLICATE_SYMBOL, variable->symbol, i);
+    }
+  }
+  int z = lookupSymbol(symbols, "Z", 1);
+  graph->zStatement = (z >= 0) ? graph->definition[z] : -1;
+
+  // second pass: references
+  for (int i = 0; i < size; i++) {
+    graph->offsets[i] = R.length;
+    R.current = i;
+    resolveExpression(&R, Slist->components[i]->expression);
+  }
+  graph->offsets[size] = R.length;
+
+  graph->targets = arenaAlloc(arena, R.length * sizeof(int));
+  if (R.length > 0) {
+    memcpy(graph->targets, R.targets, R.length * sizeof(int));
+  }
+  graph->errors = arenaAlloc(arena, R.errorCount * sizeof(ResolutionError));
+  if (R.errorCount > 0) {
+    memcpy(graph->errors, R.errors, R.errorCount * sizeof(ResolutionError));
+  }
+  graph->errorCount = R.errorCount;
+
+  free(R.stamp);
+  free(R.targets);
+  free(R.errors);
+  grammar->graph = graph;
+  return graph;
+}
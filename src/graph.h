@@ -0,0 +1,50 @@
+#include "absyn.h"
+
+#ifndef GRAPHTYPE
+#define GRAPHTYPE
+typedef enum {UNDEFINED_SYMBOL, DUPLICATE_SYMBOL} ResolutionErrorType;
+
+/*
+  Problem found while binding identifiers to their definitions.
+*/
+typedef struct ResolutionError_s
+{
+  ResolutionErrorType type;
+  int symbol; // symbol that is undefined, or defined more than once
+  int statement; // statement that references the undefined symbol, or that redefines the symbol
+} ResolutionError;
+
+/*
+  Grammar in which every identifier is bound to the statement that defines it, seen as a
+  graph whose vertices are the statements (in order), with an arc from each statement to
+  the statements it references. Arcs are stored in compressed sparse row form: the targets
+  of statement i are targets[offsets[i]], ..., targets[offsets[i+1] - 1], without repetition.
+*/
+struct GrammarGraph_s
+{
+  int size; // number of statements (vertices)
+  int symbols; // number of symbols of the grammar
+  int* definition; // definition[s] is the statement defining symbol s (the first one, if several), or -1
+  int* offsets; // size + 1 entries
+  int* targets; // offsets[size] entries
+  int zStatement; // statement defining Z (references to Z are then references to it), or -1 if Z is the atom
+  ResolutionError* errors;
+  int errorCount;
+};
+#endif
+
+#ifndef GRAPH_H
+#define GRAPH_H
+
+/*
+  Binds every identifier of the grammar to the statement that defines it (the field
+  definition of each Id is set), and returns the corresponding graph. Runs in time linear
+  in the size of the grammar. The graph is allocated from the arena of the grammar, and is
+  released with it. It is kept in grammar->graph, so that the passes that need it (reach,
+  minimize, analysis, ...) resolve the grammar only once; the passes that change the
+  statements reset it to NULL, and it is then computed again by the next call. Returns
+  NULL if the grammar is an error.
+*/
+GrammarGraph* resolveGrammar(Grammar* grammar);
+
+#endif
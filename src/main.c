@@ -0,0 +1,542 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "context.h"
+#include "binary.h"
+#include "analysis.h"
+#include "counting.h"
+#include "share.h"
+#include "normal.h"
+#include "minimize.h"
+#include "reach.h"
+
+static const char usage[] =
+  "usage: combstruct2json [PASSES] FILE\n"
+  "       combstruct2json --write-binary OUTPUT [PASSES] FILE\n"
+  "       combstruct2json --binary [--verify] FILE\n"
+  "       combstruct2json --analyze [PASSES] FILE\n"
+  "       combstruct2json --count N [--modulo P] [--labelled] [PASSES] FILE\n"
+  "       combstruct2json --batch [--jobs N] [FILE...]\n"
+  "       combstruct2json --stream [--delimiter LINE | --length-prefixed]\n"
+  "PASSES: [--root SYMBOL] [--normalize] [--minimize] [--share]\n"
+  "\n"
+  "Prints the Json representation of the grammar in FILE. With --write-binary, the parsed\n"
+  "grammar is instead saved in binary form to OUTPUT, which --binary reads back (checking\n"
+  "its checksum with --verify).\n"
+  "\n"
+  "With --analyze, the structure of the grammar is printed instead: its strongly connected\n"
+  "components in topological order, its unproductive and nullable symbols, and whether\n"
+  "it is well-founded. The exit status is 1 if it is not.\n"
+  "\n"
+  "With --count, the number of objects of each size up to N described by each symbol is\n"
+  "printed instead, as { \"A\": [ ... ], ... }: exactly, or modulo the prime P (larger\n"
+  "than N and below 2^31) with --modulo, and for unlabelled classes unless --labelled is\n"
+  "given. The exit status is 1 if the grammar cannot be counted (it is not well-founded,\n"
+  "or uses Subst).\n"
+  "\n"
+  "The grammar is first transformed by the PASSES given, in this order:\n"
+  "\n"
+  "With --root, only the symbols reachable from SYMBOL are kept, SYMBOL first. The exit\n"
+  "status is 1 if it is not defined.\n"
+  "\n"
+  "With --normalize, the grammar is put in normal form: nested Unions and Prods are\n"
+  "flattened, the Epsilons of Prods dropped, Unions and Prods of a single expression\n"
+  "replaced by it, and the alternatives of Unions sorted in a canonical order.\n"
+  "\n"
+  "With --minimize, the equivalent symbols of the grammar (those whose definitions are\n"
+  "equal once each symbol is replaced by its class) are merged into the first of them,\n"
+  "and the mapping of the symbols removed is printed to the standard error, as\n"
+  "{ \"c2\": \"c1\", ... }.\n"
+  "\n"
+  "With --share, the structurally equal expressions of the grammar are shared, so that\n"
+  "each distinct one is written, saved or counted once, and the number of expressions\n"
+  "and of distinct ones is printed to the standard error.\n"
+  "\n"
+  "With --batch, every FILE (or every line of the standard input, if there is none) is\n"
+  "parsed, on N threads (by default, one per processor), and one line of Json is printed\n"
+  "per file, in order of completion: { \"path\": ..., \"grammar\": ... } or, if the file\n"
+  "could not be parsed, { \"path\": ..., \"error\": ... }. The exit status is 1 if there\n"
+  "was any error.\n"
+  "\n"
+  "With --stream, grammars are read from the standard input, either separated by lines\n"
+  "equal to LINE (by default, %%) or each preceded by a line giving its size in bytes,\n"
+  "and a line of Json is printed (and flushed) as soon as each grammar is parsed, tagged\n"
+  "with its index in the stream: { \"index\": ..., \"grammar\": ... } or\n"
+  "{ \"index\": ..., \"error\": ... }. The exit status is 1 if there was any error.\n";
+
+/*
+  Helper function that returns an error that happened before any grammar could be built,
+  as if it came from the parser.
+*/
+static Grammar* newInputError(char* message)
+{
+  Arena* arena = newArena();
+  return newGrammar(arena, newError(arena, 0, message, INPUT), ISERROR);
+}
+
+static void printInputError(char* message)
+{
+  Grammar* error = newInputError(message);
+  Buffer* buffer = newFileBuffer(stdout);
+  grammarWriteJson(error, buffer);
+  bufferAppendString(buffer, "\n");
+  freeBuffer(buffer);
+  freeGrammar(error);
+}
+
+/********************************** Batch mode **********************************/
+
+/*
+  Work shared by the threads of a batch: each thread repeatedly takes the next path,
+  parses it with its own context, and writes the whole record to the output at once.
+*/
+typedef struct Batch_s
+{
+  char** paths;
+  int count; // number of paths
+  int next; // next path to parse
+  int errors; // number of paths that could not be parsed
+  pthread_mutex_t lock; // protects next, errors and the output
+} Batch;
+
+/*
+  Helper function that ends the record (a single line of Json) of a parsed grammar, whose
+  tag (such as its path) has already been written. The grammar, or its error, is written
+  by grammarWriteJson(), as in the output of a single file.
+*/
+static void writeRecord(Buffer* buffer, const Grammar* root)
+{
+  bufferAppendString(buffer, (root->type == ISERROR) ? ", \"error\": " : ", \"grammar\": ");
+  grammarWriteJson(root, buffer);
+  if (buffer->length > 0 && buffer->data[buffer->length - 1] == '\n') { // keep the record on one line
+    buffer->data[--buffer->length] = '\0';
+  }
+  bufferAppendString(buffer, " }\n");
+}
+
+static void* batchWorker(void* arg)
+{
+  Batch* batch = (Batch*) arg;
+  ParseContext ctx;
+  Buffer* buffer = newBuffer();
+
+  for (;;) {
+    pthread_mutex_lock(&batch->lock);
+    int i = batch->next++;
+    pthread_mutex_unlock(&batch->lock);
+    if (i >= batch->count) {
+      break;
+    }
+
+    Grammar* root = readGrammarMappedCtx(&ctx, batch->paths[i]);
+    bufferAppendString(buffer, "{ \"path\": \"");
+    bufferAppendEscaped(buffer, batch->paths[i]);
+    bufferAppendString(buffer, "\"");
+    writeRecord(buffer, root);
+
+    pthread_mutex_lock(&batch->lock);
+    fwrite(buffer->data, 1, buffer->length, stdout);
+    batch->errors += (root->type == ISERROR);
+    pthread_mutex_unlock(&batch->lock);
+
+    bufferClear(buffer);
+    freeGrammar(root);
+  }
+
+  freeBuffer(buffer);
+  return NULL;
+}
+
+/*
+  Helper function that reads the paths given on the standard input, one per line
+  (empty lines are ignored). Returns the number of paths.
+*/
+static int readPaths(char*** paths)
+{
+  int count = 0, space = 64;
+  char* line = NULL;
+  size_t lineSpace = 0;
+  ssize_t length;
+
+  *paths = malloc(space * sizeof(char*));
+  while ((length = getline(&line, &lineSpace, stdin)) >= 0) {
+    while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+      line[--length] = '\0';
+    }
+    if (length == 0) {
+      continue;
+    }
+    if (count == space) {
+      space *= 2;
+      *paths = realloc(*paths, space * sizeof(char*));
+    }
+    (*paths)[count++] = strdup(line);
+  }
+  free(line);
+  return count;
+}
+
+/*
+  Parses all the paths on the given number of threads, and returns the number of errors.
+*/
+static int runBatch(char** paths, int count, int jobs)
+{
+  Batch batch = {.paths = paths, .count = count, .next = 0, .errors = 0};
+  pthread_mutex_init(&batch.lock, NULL);
+
+  if (jobs > count) {
+    jobs = count;
+  }
+  if (jobs <= 1) {
+    batchWorker(&batch);
+  } else {
+    pthread_t* threads = malloc(jobs * sizeof(pthread_t));
+    for (int t = 0; t < jobs; t++) {
+      pthread_create(&threads[t], NULL, batchWorker, &batch);
+    }
+    for (int t = 0; t < jobs; t++) {
+      pthread_join(threads[t], NULL);
+    }
+    free(threads);
+  }
+
+  pthread_mutex_destroy(&batch.lock);
+  fflush(stdout);
+  return batch.errors;
+}
+
+/********************************** Stream mode **********************************/
+
+/*
+  Helper function that writes the record of a grammar of the stream, and flushes it, so
+  that the tool can be used as a filter. Returns whether the grammar could be parsed.
+*/
+static int streamRecord(Buffer* buffer, int index, Grammar* root)
+{
+  bufferAppendString(buffer, "{ \"index\": ");
+  bufferAppendInt(buffer, index);
+  writeRecord(buffer, root);
+  fwrite(buffer->data, 1, buffer->length, stdout);
+  fflush(stdout);
+  bufferClear(buffer);
+
+  int parsed = (root->type != ISERROR);
+  freeGrammar(root);
+  return parsed;
+}
+
+/*
+  Helper function that tells whether the first length characters of data are all blank.
+*/
+static int isBlank(const char* data, size_t length)
+{
+  for (size_t i = 0; i < length; i++) {
+    if (data[i] != ' ' && data[i] != '\t' && data[i] != '\n' && data[i] != '\r') {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+  Parses the grammars of the standard input, separated by lines equal to the delimiter
+  (blank grammars are skipped), or preceded by their size if delimiter is NULL. Returns
+  the number of errors.
+*/
+static int runStream(const char* delimiter)
+{
+  ParseContext ctx;
+  Buffer* output = newBuffer();
+  Buffer* grammar = newBuffer();
+  size_t delimiterLength = (delimiter != NULL) ? strlen(delimiter) : 0;
+  char* line = NULL;
+  size_t lineSpace = 0;
+  ssize_t length;
+  int index = 0, errors = 0;
+
+  while ((length = getline(&line, &lineSpace, stdin)) >= 0) {
+    size_t content = length; // without the end of line
+    while (content > 0 && (line[content - 1] == '\n' || line[content - 1] == '\r')) {
+      content--;
+    }
+
+    if (delimiter == NULL) { // line is the size of the next grammar
+      if (isBlank(line, length)) {
+        continue;
+      }
+      char* end;
+      long long int size = strtoll(line, &end, 10);
+      if (end == line || size < 0 || !isBlank(end, line + length - end)) {
+        errors += !streamRecord(output, index++, newInputError("invalid size of grammar"));
+        break;
+      }
+      bufferClear(grammar);
+      char chunk[65536];
+      size_t remaining = (size_t) size;
+      while (remaining > 0) {
+        size_t read = fread(chunk, 1, (remaining < sizeof(chunk)) ? remaining : sizeof(chunk), stdin);
+        if (read == 0) {
+          break;
+        }
+        bufferAppend(grammar, chunk, read);
+        remaining -= read;
+      }
+      if (grammar->length < (size_t) size) {
+        errors += !streamRecord(output, index++, newInputError("truncated grammar"));
+        bufferClear(grammar);
+        break;
+      }
+    } else if (content != delimiterLength || memcmp(line, delimiter, content) != 0) {
+      bufferAppend(grammar, line, length);
+      continue;
+    }
+
+    // a whole grammar has been read
+    if (!isBlank(grammar->data, grammar->length)) {
+      errors += !streamRecord(output, index++, readGrammarFromBufferCtx(&ctx, grammar->data, grammar->length));
+    }
+    bufferClear(grammar);
+  }
+
+  if (!isBlank(grammar->data, grammar->length)) { // last grammar, without a delimiter after it
+    errors += !streamRecord(output, index++, readGrammarFromBufferCtx(&ctx, grammar->data, grammar->length));
+  }
+
+  free(line);
+  freeBuffer(grammar);
+  freeBuffer(output);
+  return errors;
+}
+
+/********************************** Main **********************************/
+
+/*
+  Helper function that reads a non-negative int from the whole text (not just from its
+  beginning, as atoi() would) into value. Returns 1, or 0 (and leaves value unchanged)
+  if the text is not such a number.
+*/
+static int parseSize(const char* text, int* value)
+{
+  char* end;
+  errno = 0;
+  long int number = strtol(text, &end, 10);
+  if (end == text || *end != '\0' || errno == ERANGE || number < 0 || number > INT_MAX) {
+    return 0;
+  }
+  *value = (int) number;
+  return 1;
+}
+
+/*
+  Helper function that reads a prime below 2^31 from the whole text into value. Returns 1,
+  or 0 (and leaves value unchanged) if the text is not such a prime.
+*/
+static int parseModulus(const char* text, unsigned int* value)
+{
+  char* end;
+  errno = 0;
+  unsigned long int number = strtoul(text, &end, 10);
+  if (end == text || *end != '\0' || text[0] == '-' || errno == ERANGE || number >= (1UL << 31) ||
+      !isPrime((unsigned int) number)) {
+    return 0;
+  }
+  *value = (unsigned int) number;
+  return 1;
+}
+
+int main(int argc, char* argv[])
+{
+  char* binaryOutput = NULL;
+  int binaryInput = 0;
+  int verify = 0;
+  int analyze = 0;
+  int count = -1;
+  unsigned int modulus = 0;
+  int labelled = 0;
+  char* rootSymbol = NULL;
+  int normalize = 0;
+  int minimize = 0;
+  int share = 0;
+  int batch = 0;
+  int jobs = 0;
+  int stream = 0;
+  char* delimiter = "%%";
+  char** files = malloc(argc * sizeof(char*));
+  int fileCount = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--write-binary") == 0 && i + 1 < argc) {
+      binaryOutput = argv[++i];
+    } else if (strcmp(argv[i], "--binary") == 0) {
+      binaryInput = 1;
+    } else if (strcmp(argv[i], "--verify") == 0) {
+      verify = 1;
+    } else if (strcmp(argv[i], "--analyze") == 0) {
+      analyze = 1;
+    } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc && parseSize(argv[i + 1], &count)) {
+      i++;
+    } else if (strcmp(argv[i], "--modulo") == 0 && i + 1 < argc && parseModulus(argv[i + 1], &modulus)) {
+      i++;
+    } else if (strcmp(argv[i], "--labelled") == 0) {
+      labelled = 1;
+    } else if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+      rootSymbol = argv[++i];
+    } else if (strcmp(argv[i], "--normalize") == 0) {
+      normalize = 1;
+    } else if (strcmp(argv[i], "--minimize") == 0) {
+      minimize = 1;
+    } else if (strcmp(argv[i], "--share") == 0) {
+      share = 1;
+    } else if (strcmp(argv[i], "--batch") == 0) {
+      batch = 1;
+    } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+      jobs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--stream") == 0) {
+      stream = 1;
+    } else if (strcmp(argv[i], "--delimiter") == 0 && i + 1 < argc) {
+      delimiter = argv[++i];
+    } else if (strcmp(argv[i], "--length-prefixed") == 0) {
+      delimiter = NULL;
+    } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+      fputs(usage, stderr);
+      return 2;
+    } else {
+      files[fileCount++] = argv[i];
+    }
+  }
+
+  if ((modulus != 0 || labelled) && count < 0) {
+    fputs(usage, stderr);
+    return 2;
+  }
+  int structure = analyze || count >= 0; // something else than the grammar is printed
+  int passes = rootSymbol != NULL || normalize || minimize || share; // the grammar is transformed
+
+  if (stream) {
+    if (batch || structure || passes || binaryInput || binaryOutput != NULL || fileCount > 0) {
+      fputs(usage, stderr);
+      return 2;
+    }
+    free(files);
+    return runStream(delimiter) > 0;
+  }
+
+  if (batch) {
+    if (structure || passes || binaryInput || binaryOutput != NULL) {
+      fputs(usage, stderr);
+      return 2;
+    }
+    if (jobs == 0) {
+      jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    int errors;
+    if (fileCount > 0) {
+      errors = runBatch(files, fileCount, jobs);
+    } else {
+      char** paths;
+      int count = readPaths(&paths);
+      errors = runBatch(paths, count, jobs);
+      for (int i = 0; i < count; i++) {
+        free(paths[i]);
+      }
+      free(paths);
+    }
+    free(files);
+    return errors > 0;
+  }
+
+  if (fileCount != 1 || (binaryInput && binaryOutput != NULL) || (analyze && count >= 0) ||
+      (structure && (binaryInput || binaryOutput != NULL)) || (binaryInput && passes)) {
+    fputs(usage, stderr);
+    return 2;
+  }
+  char* filename = files[0];
+  free(files);
+
+  if (binaryInput) {
+    FlatGrammar* flat = readGrammarBinary(filename, verify);
+    if (flat == NULL) {
+      printInputError("could not read binary grammar");
+      return 1;
+    }
+    Buffer* buffer = newFileBuffer(stdout);
+    flatGrammarWriteJson(flat, buffer);
+    bufferAppendString(buffer, "\n");
+    freeBuffer(buffer);
+    freeFlatGrammar(flat);
+    return 0;
+  }
+
+  Grammar* root = readGrammarMapped(filename);
+
+  if (rootSymbol != NULL && root->type != ISERROR && pruneGrammar(root, rootSymbol) < 0) {
+    freeGrammar(root);
+    printInputError("undefined root symbol");
+    return 1;
+  }
+  if (normalize && root->type != ISERROR) {
+    normalizeGrammar(root);
+  }
+  if (minimize && root->type != ISERROR) {
+    Buffer* mapping = newFileBuffer(stderr);
+    minimizationWriteJson(minimizeGrammar(root), mapping);
+    bufferAppendString(mapping, "\n");
+    freeBuffer(mapping);
+  }
+  if (share && root->type != ISERROR) {
+    const Sharing* sharing = shareGrammar(root);
+    fprintf(stderr, "shared %d expressions into %d distinct ones (ratio %.2f)\n",
+            sharing->expressions, sharing->distinct, sharingRatio(sharing));
+  }
+
+  if (analyze && root->type != ISERROR) {
+    GrammarAnalysis* analysis = analyzeGrammar(root);
+    Buffer* buffer = newFileBuffer(stdout);
+    analysisWriteJson(root, analysis, buffer);
+    bufferAppendString(buffer, "\n");
+    freeBuffer(buffer);
+    int status = !analysis->wellFounded;
+    freeGrammar(root);
+    return status;
+  }
+
+  if (count >= 0 && root->type != ISERROR) {
+    Counts* counts = countGrammar(root, labelled ? LABELLED : UNLABELLED, count, modulus);
+    if (counts == NULL) {
+      freeGrammar(root);
+      printInputError("could not count grammar");
+      return 1;
+    }
+    Buffer* buffer = newFileBuffer(stdout);
+    countsWriteJson(root, counts, buffer);
+    bufferAppendString(buffer, "\n");
+    freeBuffer(buffer);
+    freeCounts(counts);
+    freeGrammar(root);
+    return 0;
+  }
+
+  if (binaryOutput != NULL && root->type != ISERROR) {
+    int status = writeGrammarBinary(root, binaryOutput);
+    freeGrammar(root);
+    if (status != 0) {
+      printInputError("could not write binary grammar");
+      return 1;
+    }
+    return 0;
+  }
+
+  // stream the output, rather than building the whole string in memory
+  Buffer* buffer = newFileBuffer(stdout);
+  grammarWriteJson(root, buffer);
+  bufferAppendString(buffer, "\n");
+  freeBuffer(buffer);
+
+  int status = (binaryOutput != NULL || structure); // the error was printed instead of writing the grammar
+  freeGrammar(root);
+  return status;
+}
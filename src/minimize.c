@@ -0,0 +1,507 @@
+#include <stdlib.h>
+#include <string.h>
+#include "minimize.h"
+
+#define APPEND(buffer, literal) (bufferAppend((buffer), (literal), sizeof(literal) - 1)) // literal strings only
+
+/*
+  Statement of a class being split, with the classes of the statements it refers to.
+*/
+typedef struct Member_s
+{
+  int statement;
+  unsigned int hash;
+  const int* signature; // classes of the statements referenced, in order
+  int length;
+} Member;
+
+/*
+  State of the minimization. The shape of the expression of statement i (its nodes in
+  preorder, references left out) is code[codeOffsets[i]], ..., and the statements it
+  refers to (in the same order) holes[holeOffsets[i]], .... The statements of class c are
+  members[start[c]], ..., members[start[c] + count[c] - 1] (statement i being at
+  members[position[i]]). A statement is pending if a statement it refers to has changed
+  class since its own class was last split: the statements of a class that are not
+  pending all refer to the same classes.
+*/
+typedef struct Minimizer_s
+{
+  const GrammarGraph* graph;
+  int* code;
+  int codeLength, codeSpace;
+  int* holes;
+  int holeLength, holeSpace;
+  int* codeOffsets;
+  int* holeOffsets;
+  int* predOffsets; // statements referring to statement i are preds[predOffsets[i]], ...
+  int* preds;
+  int* classOf;
+  int* members;
+  int* position;
+  int* start;
+  int* count;
+  int classCount;
+  int* pending; // pending statements of class c: pending[c], nextPending[pending[c]], ... (-1 at the end)
+  int* nextPending;
+  char* isPending;
+  int* queue; // classes with pending statements (a stack)
+  int queueLength;
+  int* touched; // work arrays of split()
+  int* signatures;
+  Member* parts;
+} Minimizer;
+
+static void pushCode(Minimizer* M, int value)
+{
+  if (M->codeLength == M->codeSpace) {
+    M->codeSpace = 2 * M->codeSpace + 16;
+    M->code = realloc(M->code, M->codeSpace * sizeof(int));
+  }
+  M->code[M->codeLength++] = value;
+}
+
+static void pushHole(Minimizer* M, int statement)
+{
+  if (M->holeLength == M->holeSpace) {
+    M->holeSpace = 2 * M->holeSpace + 16;
+    M->holes = realloc(M->holes, M->holeSpace * sizeof(int));
+  }
+  M->holes[M->holeLength++] = statement;
+}
+
+/*
+  Helper function that appends the shape of the expression E to the code, and the
+  statements it refers to to the holes.
+*/
+static void encode(Minimizer* M, const Expression* E)
+{
+  pushCode(M, E->type);
+  pushCode(M, E->restriction);
+  pushCode(M, (int) E->limit);
+  pushCode(M, (int) (E->limit >> 32));
+  switch (E->type) {
+  case (ID): ;
+    const Id* id = (Id*) E->component;
+    if (id->definition >= 0) {
+      pushCode(M, 1);
+      pushHole(M, id->definition);
+    } else { // undefined: only equal to the same symbol
+      pushCode(M, 0);
+      pushCode(M, id->symbol);
+    }
+    return;
+  case (Z):
+    if (M->graph->zStatement >= 0) {
+      pushHole(M, M->graph->zStatement);
+    }
+    return;
+  case (UNION):
+  case (PROD):
+  case (SUBST): ;
+    const ExpressionList* Elist = (ExpressionList*) E->component;
+    pushCode(M, Elist->size);
+    for (int i = 0; i < Elist->size; i++) {
+      encode(M, Elist->components[i]);
+    }
+    return;
+  case (SET):
+  case (POWERSET):
+  case (SEQUENCE):
+  case (CYCLE):
+    encode(M, (Expression*) E->component);
+    return;
+  default:
+    return;
+  }
+}
+
+/*
+  Helper function that adds a 32-bit value to a (FNV-1a-like) hash.
+*/
+static inline unsigned int mix(unsigned int h, unsigned int x)
+{
+  h ^= x;
+  h *= 16777619u;
+  return h ^ (h >> 15);
+}
+
+static int compareMembers(const void* a, const void* b)
+{
+  const Member* A = (const Member*) a;
+  const Member* B = (const Member*) b;
+  if (A->hash != B->hash) {
+    return (A->hash < B->hash) ? -1 : 1;
+  }
+  int order = memcmp(A->signature, B->signature, A->length * sizeof(int));
+  if (order != 0) {
+    return order;
+  }
+  return A->statement - B->statement;
+}
+
+static inline int sameSignature(const Member* A, const Member* B)
+{
+  return A->hash == B->hash && memcmp(A->signature, B->signature, A->length * sizeof(int)) == 0;
+}
+
+/*
+  Helper function that marks statement s as pending, so that its class is split again.
+*/
+static void touch(Minimizer* M, int s)
+{
+  if (M->isPending[s]) {
+    return;
+  }
+  int c = M->classOf[s];
+  M->isPending[s] = 1;
+  if (M->pending[c] < 0) {
+    M->queue[M->queueLength++] = c;
+  }
+  M->nextPending[s] = M->pending[c];
+  M->pending[c] = s;
+}
+
+/*
+  Helper function that splits class c according to the classes its pending statements
+  refer to (the others all refer to the same classes, those of its first statement). The
+  pending statements are moved to the end of the class, and sorted by the classes they
+  refer to; the largest part keeps the number c, and the statements that refer to the
+  statements of the other parts become pending, so that the total time is O(m log n) for
+  m references and n statements, as in Hopcroft's algorithm.
+*/
+static void split(Minimizer* M, int c)
+{
+  int first = M->start[c];
+  int size = M->count[c];
+  int touched = 0;
+  for (int s = M->pending[c]; s >= 0; s = M->nextPending[s]) {
+    M->isPending[s] = 0;
+    M->touched[touched++] = s;
+  }
+  M->pending[c] = -1;
+
+  // pending statements at the end
+  for (int k = 0; k < touched; k++) {
+    int s = M->touched[k];
+    int to = first + size - 1 - k;
+    int other = M->members[to];
+    M->members[M->position[s]] = other;
+    M->position[other] = M->position[s];
+    M->members[to] = s;
+    M->position[s] = to;
+  }
+  int untouched = size - touched;
+  if (size == 1) {
+    return;
+  }
+
+  // signatures: the classes referenced, in order (the same length, as the shapes are equal)
+  int length = M->holeOffsets[M->members[first] + 1] - M->holeOffsets[M->members[first]];
+  Member reference = {-1, 0, NULL, length};
+  for (int k = 0; k <= touched; k++) {
+    int s = (k < touched) ? M->members[first + untouched + k] : M->members[first];
+    int* signature = M->signatures + (size_t) k * length;
+    unsigned int hash = 2166136261u;
+    for (int j = 0; j < length; j++) {
+      signature[j] = M->classOf[M->holes[M->holeOffsets[s] + j]];
+      hash = mix(hash, signature[j]);
+    }
+    Member* part = (k < touched) ? &M->parts[k] : &reference;
+    part->statement = s;
+    part->hash = hash;
+    part->signature = signature;
+    part->length = length;
+  }
+  qsort(M->parts, touched, sizeof(Member), compareMembers);
+
+  // the statements that refer to the same classes as the others first
+  int same = 0;
+  if (untouched > 0) {
+    for (int k = 0; k < touched; k++) {
+      if (sameSignature(&M->parts[k], &reference)) {
+        Member swap = M->parts[same];
+        M->parts[same++] = M->parts[k];
+        M->parts[k] = swap;
+      }
+    }
+    qsort(M->parts + same, touched - same, sizeof(Member), compareMembers);
+  }
+  for (int k = 0; k < touched; k++) {
+    M->members[first + untouched + k] = M->parts[k].statement;
+    M->position[M->parts[k].statement] = first + untouched + k;
+  }
+
+  // parts: members[first + bounds[p]], ..., members[first + bounds[p + 1] - 1]
+  int* bounds = M->touched; // no longer needed
+  int parts = 0;
+  bounds[parts++] = 0;
+  for (int k = (untouched > 0) ? same : 1; k < touched; k++) {
+    if ((untouched > 0 && k == same) || !sameSignature(&M->parts[k], &M->parts[k - 1])) {
+      bounds[parts++] = untouched + k;
+    }
+  }
+  bounds[parts] = size;
+  if (parts == 1) {
+    return;
+  }
+
+  int largest = 0;
+  for (int p = 1; p < parts; p++) {
+    if (bounds[p + 1] - bounds[p] > bounds[largest + 1] - bounds[largest]) {
+      largest = p;
+    }
+  }
+  int moved = M->classCount;
+  for (int p = 0; p < parts; p++) {
+    int part = (p == largest) ? c : M->classCount++;
+    M->start[part] = first + bounds[p];
+    M->count[part] = bounds[p + 1] - bounds[p];
+    if (part != c) {
+      M->pending[part] = -1;
+      for (int k = M->start[part]; k < M->start[part] + M->count[part]; k++) {
+        M->classOf[M->members[k]] = part;
+      }
+    }
+  }
+  for (int d = moved; d < M->classCount; d++) {
+    for (int k = M->start[d]; k < M->start[d] + M->count[d]; k++) {
+      int s = M->members[k];
+      for (int j = M->predOffsets[s]; j < M->predOffsets[s + 1]; j++) {
+        touch(M, M->preds[j]);
+      }
+    }
+  }
+}
+
+/*
+  Helper function that replaces the references to merged statements by references to
+  their representatives.
+*/
+static void redirect(Arena* arena, const Minimization* Min, Expression* E)
+{
+  switch (E->type) {
+  case (ID): ;
+    const Id* id = (Id*) E->component;
+    if (id->definition >= 0) {
+      int representative = Min->representative[Min->classOf[id->definition]];
+      if (representative != id->definition) {
+        Id* copy = arenaAlloc(arena, sizeof(Id));
+        *copy = *Min->variables[representative];
+        E->component = copy;
+      }
+    }
+    return;
+  case (UNION):
+  case (PROD):
+  case (SUBST): ;
+    ExpressionList* Elist = (ExpressionList*) E->component;
+    for (int i = 0; i < Elist->size; i++) {
+      redirect(arena, Min, Elist->components[i]);
+    }
+    return;
+  case (SET):
+  case (POWERSET):
+  case (SEQUENCE):
+  case (CYCLE):
+    redirect(arena, Min, (Expression*) E->component);
+    return;
+  default:
+    return;
+  }
+}
+
+const Minimization* minimizeGrammar(Grammar* grammar)
+{
+  if (grammar->type == ISERROR) {
+    return NULL;
+  }
+
+  Arena* arena = grammar->arena;
+  StatementList* Slist = (StatementList*) grammar->component;
+  const GrammarGraph* graph = resolveGrammar(grammar);
+  int size = Slist->size;
+
+  Minimizer M;
+  memset(&M, 0, sizeof(Minimizer));
+  M.graph = graph;
+  M.codeOffsets = malloc((size + 1) * sizeof(int));
+  M.holeOffsets = malloc((size + 1) * sizeof(int));
+  for (int i = 0; i < size; i++) {
+    M.codeOffsets[i] = M.codeLength;
+    M.holeOffsets[i] = M.holeLength;
+    encode(&M, Slist->components[i]->expression);
+  }
+  M.codeOffsets[size] = M.codeLength;
+  M.holeOffsets[size] = M.holeLength;
+
+  // statements referring to each statement
+  M.predOffsets = calloc(size + 2, sizeof(int));
+  M.preds = malloc((M.holeLength + 1) * sizeof(int));
+  for (int h = 0; h < M.holeLength; h++) {
+    M.predOffsets[M.holes[h] + 2]++;
+  }
+  for (int i = 0; i < size; i++) {
+    M.predOffsets[i + 2] += M.predOffsets[i + 1];
+  }
+  for (int i = 0; i < size; i++) {
+    for (int h = M.holeOffsets[i]; h < M.holeOffsets[i + 1]; h++) {
+      M.preds[M.predOffsets[M.holes[h] + 1]++] = i;
+    }
+  }
+
+  // initial partition: statements with the same shape (the statement of Z alone)
+  int capacity = 16;
+  while (capacity < 2 * size) {
+    capacity *= 2;
+  }
+  int* table = malloc(capacity * sizeof(int));
+  unsigned int* hashes = malloc((size + 1) * sizeof(unsigned int));
+  int* next = malloc((size + 1) * sizeof(int)); // next statement of the same shape, or -1
+  int* last = malloc((size + 1) * sizeof(int));
+  memset(table, -1, capacity * sizeof(int));
+  M.classOf = malloc((size + 1) * sizeof(int));
+  for (int i = 0; i < size; i++) {
+    int length = M.codeOffsets[i + 1] - M.codeOffsets[i];
+    const int* code = M.code + M.codeOffsets[i];
+    unsigned int h = 2166136261u;
+    for (int k = 0; k < length; k++) {
+      h = mix(h, code[k]);
+    }
+    hashes[i] = h;
+    next[i] = -1;
+    int slot = h & (capacity - 1);
+    while (i != graph->zStatement && table[slot] >= 0) { // linear probing
+      int j = table[slot];
+      if (hashes[j] == h && M.codeOffsets[j + 1] - M.codeOffsets[j] == length &&
+          memcmp(M.code + M.codeOffsets[j], code, length * sizeof(int)) == 0) {
+        break;
+      }
+      slot = (slot + 1) & (capacity - 1);
+    }
+    if (i != graph->zStatement && table[slot] >= 0) {
+      int j = table[slot];
+      M.classOf[i] = M.classOf[j];
+      next[last[j]] = i;
+      last[j] = i;
+    } else {
+      M.classOf[i] = M.classCount++;
+      last[i] = i;
+      if (i != graph->zStatement) {
+        table[slot] = i;
+      }
+    }
+  }
+
+  M.members = malloc((size + 1) * sizeof(int));
+  M.position = malloc((size + 1) * sizeof(int));
+  M.start = malloc((size + 1) * sizeof(int));
+  M.count = malloc((size + 1) * sizeof(int));
+  int position = 0;
+  char* seen = calloc(M.classCount + 1, 1);
+  for (int i = 0; i < size; i++) {
+    int c = M.classOf[i];
+    if (!seen[c]) {
+      seen[c] = 1;
+      M.start[c] = position;
+      for (int j = i; j >= 0; j = next[j]) {
+        M.position[j] = position;
+        M.members[position++] = j;
+      }
+      M.count[c] = position - M.start[c];
+    }
+  }
+  free(seen);
+  free(table);
+  free(hashes);
+  free(next);
+  free(last);
+
+  // refinement, every statement being pending at first
+  M.pending = malloc((size + 1) * sizeof(int));
+  M.nextPending = malloc((size + 1) * sizeof(int));
+  M.isPending = calloc(size + 1, 1);
+  M.queue = malloc((size + 1) * sizeof(int));
+  M.touched = malloc((size + 2) * sizeof(int));
+  M.signatures = malloc((2 * M.holeLength + 1) * sizeof(int));
+  M.parts = malloc((size + 1) * sizeof(Member));
+  memset(M.pending, -1, (size + 1) * sizeof(int));
+  for (int i = size - 1; i >= 0; i--) {
+    touch(&M, i);
+  }
+  while (M.queueLength > 0) {
+    split(&M, M.queue[--M.queueLength]);
+  }
+
+  // the first statement of each class represents it
+  Minimization* Min = arenaAlloc(arena, sizeof(Minimization));
+  Min->statements = size;
+  Min->classes = 0;
+  Min->classOf = arenaAlloc(arena, (size + 1) * sizeof(int));
+  Min->representative = arenaAlloc(arena, (M.classCount + 1) * sizeof(int));
+  Min->variables = arenaAlloc(arena, (size + 1) * sizeof(Id*));
+  int* number = malloc((M.classCount + 1) * sizeof(int));
+  memset(number, -1, (M.classCount + 1) * sizeof(int));
+  for (int i = 0; i < size; i++) {
+    int c = M.classOf[i];
+    if (number[c] < 0) {
+      number[c] = Min->classes;
+      Min->representative[Min->classes++] = i;
+    }
+    Min->classOf[i] = number[c];
+    Min->variables[i] = Slist->components[i]->variable;
+  }
+  free(number);
+
+  // merge the classes into their representatives
+  if (Min->classes < size) {
+    int kept = 0;
+    for (int i = 0; i < size; i++) {
+      if (Min->representative[Min->classOf[i]] == i) {
+        redirect(arena, Min, Slist->components[i]->expression);
+        Slist->components[kept++] = Slist->components[i];
+      }
+    }
+    Slist->size = kept;
+    grammar->sharing = NULL;
+    grammar->graph = NULL;
+    resolveGrammar(grammar);
+  }
+
+  free(M.code);
+  free(M.holes);
+  free(M.codeOffsets);
+  free(M.holeOffsets);
+  free(M.predOffsets);
+  free(M.preds);
+  free(M.classOf);
+  free(M.members);
+  free(M.position);
+  free(M.start);
+  free(M.count);
+  free(M.pending);
+  free(M.nextPending);
+  free(M.isPending);
+  free(M.queue);
+  free(M.touched);
+  free(M.signatures);
+  free(M.parts);
+  return Min;
+}
+
+void minimizationWriteJson(const Minimization* minimization, Buffer* buffer)
+{
+  int written = 0;
+  APPEND(buffer, "{");
+  for (int i = 0; i < minimization->statements; i++) {
+    int representative = minimization->representative[minimization->classOf[i]];
+    if (representative == i) {
+      continue;
+    }
+    bufferAppendString(buffer, written++ ? ", \"" : " \"");
+    bufferAppendString(buffer, minimization->variables[i]->name);
+    APPEND(buffer, "\": \"");
+    bufferAppendString(buffer, minimization->variables[representative]->name);
+    APPEND(buffer, "\"");
+  }
+  APPEND(buffer, " }");
+}
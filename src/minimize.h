@@ -0,0 +1,47 @@
+#include "graph.h"
+
+#ifndef MINIMIZETYPE
+#define MINIMIZETYPE
+/*
+  Equivalence of the statements of a grammar found by minimizeGrammar(), and the mapping
+  of the statements merged to their representatives. Statements are numbered as in the
+  grammar before merging, classes as the statements of the grammar after merging.
+  Allocated from the arena of the grammar.
+*/
+typedef struct Minimization_s
+{
+  int statements; // number of statements before merging
+  int classes; // number of classes (statements after merging)
+  int* classOf; // classOf[i] is the class of statement i
+  int* representative; // representative[c] is the statement kept for class c (the first one)
+  Id** variables; // variables[i] is the variable of statement i
+} Minimization;
+#endif
+
+#ifndef MINIMIZE_H
+#define MINIMIZE_H
+
+/*
+  Merges the equivalent statements of the grammar: the coarsest equivalence such that
+  two statements are equivalent if their expressions are equal once every reference is
+  replaced by the class of the statement it refers to (a bisimulation, as between C and Sc
+  in tests/cographs). It is computed by partition refinement, starting from the classes of
+  statements whose expressions have the same shape (ignoring the symbols referenced), and
+  splitting classes whose statements refer to different classes; as in Hopcroft's
+  algorithm, the largest part of a class keeps its number, and only the statements that
+  refer to the others are examined again. The first statement of each class is kept, the
+  others are removed, and the references to them are replaced by references to it, so that
+  the grammar describes the same classes with fewer symbols. The statement defining Z is
+  never merged, and the alternatives of a Union are compared in order (see
+  normalizeGrammar() for a canonical order). A sharing (see shareGrammar()) is forgotten.
+  Returns the mapping, or NULL if the grammar is an error.
+*/
+const Minimization* minimizeGrammar(Grammar* grammar);
+
+/*
+  Writes the mapping of the statements merged to the buffer, as the Json object
+  { "c2": "c1", ... }, each symbol removed being mapped to the symbol of its representative.
+*/
+void minimizationWriteJson(const Minimization* minimization, Buffer* buffer);
+
+#endif
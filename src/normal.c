@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <string.h>
+#include "normal.h"
+
+/*
+  Position in the list of components of a Union or Prod whose chain is being flattened.
+*/
+typedef struct Frame_s
+{
+  const ExpressionList* list;
+  int next; // index of the next component to visit
+} Frame;
+
+/*
+  State of the normalization: the components collected for the Unions and Prods being
+  flattened (a stack, the innermost one on top), and the frames of the chains they come
+  from, so that long chains of nested Unions or Prods are flattened without recursion.
+*/
+typedef struct Normalizer_s
+{
+  Arena* arena;
+  Expression** components;
+  int size, space;
+  Frame* frames;
+  int frameCount, frameSpace;
+  int removed; // number of expressions removed so far
+} Normalizer;
+
+static Expression* normalize(Normalizer* N, Expression* E);
+
+static void pushComponent(Normalizer* N, Expression* E)
+{
+  if (N->size == N->space) {
+    N->space = 2 * N->space + 16;
+    N->components = realloc(N->components, N->space * sizeof(Expression*));
+  }
+  N->components[N->size++] = E;
+}
+
+static void pushFrame(Normalizer* N, const ExpressionList* list)
+{
+  if (N->frameCount == N->frameSpace) {
+    N->frameSpace = 2 * N->frameSpace + 16;
+    N->frames = realloc(N->frames, N->frameSpace * sizeof(Frame));
+  }
+  N->frames[N->frameCount].list = list;
+  N->frames[N->frameCount].next = 0;
+  N->frameCount++;
+}
+
+/*
+  Helper function that tells whether E is a Union (or Prod, depending on type) that can be
+  flattened into its parent.
+*/
+static inline int isChain(const Expression* E, enum yytokentype type)
+{
+  return E->type == type && E->restriction == NONE;
+}
+
+/*
+  Helper function that pushes the normalized components of the chain of nested Unions (or
+  Prods) rooted at E, from left to right, leaving out the Epsilons of a Prod.
+*/
+static void collect(Normalizer* N, const Expression* E, enum yytokentype type)
+{
+  int base = N->frameCount;
+  pushFrame(N, (const ExpressionList*) E->component);
+  while (N->frameCount > base) {
+    Frame* F = &N->frames[N->frameCount - 1];
+    if (F->next == F->list->size) {
+      N->frameCount--;
+      continue;
+    }
+    Expression* C = F->list->components[F->next++];
+    if (isChain(C, type)) { // pushFrame() may move F
+      N->removed++;
+      pushFrame(N, (const ExpressionList*) C->component);
+      continue;
+    }
+    Expression* D = normalize(N, C);
+    if (isChain(D, type)) { // as Prod(A, Union(Prod(B, C))), whose Union became Prod(B, C)
+      const ExpressionList* Dlist = (const ExpressionList*) D->component;
+      N->removed++;
+      for (int i = 0; i < Dlist->size; i++) {
+        pushComponent(N, Dlist->components[i]);
+      }
+    } else if (type == PROD && D->type == EPSILON) {
+      N->removed++;
+    } else {
+      pushComponent(N, D);
+    }
+  }
+}
+
+static int compareComponents(const void* a, const void* b)
+{
+  return compareExpressions(*(Expression* const*) a, *(Expression* const*) b);
+}
+
+/*
+  Helper function that flattens the Union (or Prod) E, and returns its normal form.
+*/
+static Expression* normalizeChain(Normalizer* N, Expression* E)
+{
+  int base = N->size;
+  collect(N, E, E->type);
+  int count = N->size - base;
+  Expression** components = N->components + base;
+
+  if (count == 0) { // a Prod of Epsilons
+    N->size = base;
+    return newExpression(N->arena, newUnit(N->arena, EPSILON), EPSILON, NONE, 0);
+  }
+  if (count == 1) {
+    N->size = base;
+    N->removed++;
+    return components[0];
+  }
+  if (E->type == UNION) {
+    qsort(components, count, sizeof(Expression*), compareComponents);
+  }
+  ExpressionList* Elist = (ExpressionList*) E->component;
+  if (count > Elist->space) {
+    Elist->components = arenaAlloc(N->arena, count * sizeof(Expression*));
+    Elist->space = count;
+  }
+  memcpy(Elist->components, components, count * sizeof(Expression*));
+  Elist->size = count;
+  N->size = base;
+  return E;
+}
+
+/*
+  Helper function that normalizes the expression E (see normalizeGrammar()), and returns its
+  normal form (E itself, modified in place, or one of its subexpressions, or a new Epsilon).
+*/
+static Expression* normalize(Normalizer* N, Expression* E)
+{
+  switch (E->type) {
+  case (UNION):
+  case (PROD):
+    if (E->restriction == NONE) {
+      return normalizeChain(N, E);
+    } // fall through
+  case (SUBST): ;
+    ExpressionList* Elist = (ExpressionList*) E->component;
+    for (int i = 0; i < Elist->size; i++) {
+      Elist->components[i] = normalize(N, Elist->components[i]);
+    }
+    return E;
+  case (SET):
+  case (POWERSET):
+  case (SEQUENCE):
+  case (CYCLE):
+    E->component = normalize(N, (Expression*) E->component);
+    if (E->restriction == GREATER && E->limit <= ((E->type == CYCLE) ? 1 : 0)) {
+      E->restriction = NONE;
+      E->limit = 0;
+    }
+    return E;
+  default: // Atom, Epsilon, Z and Id
+    return E;
+  }
+}
+
+int normalizeGrammar(Grammar* grammar)
+{
+  if (grammar->type == ISERROR) {
+    return -1;
+  }
+
+  StatementList* Slist = (StatementList*) grammar->component;
+  Normalizer N = {grammar->arena, NULL, 0, 0, NULL, 0, 0, 0};
+  for (int i = 0; i < Slist->size; i++) {
+    Statement* statement = Slist->components[i];
+    statement->expression = normalize(&N, statement->expression);
+  }
+  free(N.components);
+  free(N.frames);
+
+  grammar->sharing = NULL;
+  grammar->graph = NULL;
+  return N.removed;
+}
+
+int compareExpressions(const Expression* A, const Expression* B)
+{
+  if (A == B) {
+    return 0;
+  }
+  if (A->type != B->type) {
+    return (A->type < B->type) ? -1 : 1;
+  }
+  if (A->restriction != B->restriction) {
+    return (A->restriction < B->restriction) ? -1 : 1;
+  }
+  if (A->limit != B->limit) {
+    return (A->limit < B->limit) ? -1 : 1;
+  }
+
+  switch (A->type) {
+  case (ID): ;
+    const Id* a = (Id*) A->component;
+    const Id* b = (Id*) B->component;
+    int order = memcmp(a->name, b->name, (a->length < b->length) ? a->length : b->length);
+    if (order != 0) {
+      return order;
+    }
+    return (a->length > b->length) - (a->length < b->length);
+  case (UNION):
+  case (PROD):
+  case (SUBST): ;
+    const ExpressionList* Alist = (ExpressionList*) A->component;
+    const ExpressionList* Blist = (ExpressionList*) B->component;
+    if (Alist->size != Blist->size) {
+      return (Alist->size < Blist->size) ? -1 : 1;
+    }
+    for (int i = 0; i < Alist->size; i++) {
+      int order = compareExpressions(Alist->components[i], Blist->components[i]);
+      if (order != 0) {
+        return order;
+      }
+    }
+    return 0;
+  case (SET):
+  case (POWERSET):
+  case (SEQUENCE):
+  case (CYCLE):
+    return compareExpressions((Expression*) A->component, (Expression*) B->component);
+  default: // Atom, Epsilon and Z
+    return 0;
+  }
+}
@@ -0,0 +1,34 @@
+#include "absyn.h"
+
+#ifndef NORMAL_H
+#define NORMAL_H
+
+/*
+  Puts the expressions of the grammar in normal form, in place:
+  - nested Unions (and nested Prods) are flattened into a single n-ary Union (Prod), so
+    that Union(A, Union(B, C)) becomes Union(A, B, C);
+  - the Epsilons of a Prod are dropped, a Prod without components becoming Epsilon;
+  - a Union or Prod with a single component is replaced by that component;
+  - the alternatives of a Union are sorted in a canonical order (by type, restriction and
+    then components, Ids by name), so that equal classes written in a different order
+    have the same normal form;
+  - the restrictions that do not restrict anything (card >= 0, or card >= 1 for a Cycle)
+    are removed.
+  The components of a Prod keep their order, which is part of the shape of its objects.
+  The nodes of the normal form are allocated from the arena of the grammar (the nodes
+  replaced are only released with it), and the chains of nested Unions or Prods are
+  flattened in time linear in their length. The grammar describes the same classes, with
+  the same counts, but its statements should be normalized before any pass that keeps
+  references to its expressions: a sharing (see shareGrammar()) is forgotten. Returns
+  the number of expressions removed, or -1 if the grammar is an error.
+*/
+int normalizeGrammar(Grammar* grammar);
+
+/*
+  Compares two expressions in the canonical order used by normalizeGrammar(): returns a
+  negative number, 0 or a positive number if A comes before, is equal to, or comes after
+  B. Expressions that compare equal are structurally equal.
+*/
+int compareExpressions(const Expression* A, const Expression* B);
+
+#endif
@@ -0,0 +1,1356 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "oracle.h"
+#include "flat.h"
+
+#define MAX_LEVELS 256 // largest j such that A(z^j) is computed, for the Pólya operators
+#define MAX_LIMIT (1 << 20) // largest restriction to cardinality supported
+#define NEGLIGIBLE 1e-17 // terms A(z^j) with z^j below this are neglected
+#define TAIL_BOUND 0.5 // card >= k sums the terms from k on if the argument is below this
+#define TAIL_TERMS 128 // largest number of terms summed
+#define NEWTON_ITERATIONS 100
+#define NEWTON_TOLERANCE 1e-13
+#define GMRES_RESTART 30
+#define GMRES_RESTARTS 10
+#define GMRES_TOLERANCE 1e-13
+
+/*
+  Value of an expression together with its derivative in some direction (forward mode
+  automatic differentiation): evaluating the system at y, with the derivatives of the
+  statements set to v, yields both F(y) and the product of the Jacobian of F by v.
+*/
+typedef struct Dual_s
+{
+  double v;
+  double d;
+} Dual;
+
+/*
+  Instruction of the program of an oracle. Instruction n evaluates node n of the flat
+  representation of the grammar into register n.
+*/
+typedef struct Instruction_s
+{
+  unsigned char op; // FlatOp (FLAT_ID for references, including Z when it is defined)
+  unsigned char restriction; // Restriction
+  unsigned short reserved;
+  int first; // first child in the list of children, or statement referred to (FLAT_ID)
+  int count; // number of children
+  int limit; // value of the restriction to cardinality (0 if there is none)
+  int slot; // table of values at z^j of the child (UNLABELLED Set, PowerSet and Cycle), or -1
+} Instruction;
+
+typedef struct Batch_s Batch; // see evaluateOracleBatch()
+
+struct Oracle_s
+{
+  OracleType type;
+  int size; // number of instructions
+  int statements;
+  Instruction* program;
+  int* childList; // children of instruction n are childList[first], ..., childList[first + count - 1]
+  int* roots; // roots[i] is the instruction of the expression of statement i
+  int componentCount;
+  char* recursive; // recursive[c] is 1 if component c references itself
+  int* componentOffsets;
+  int* componentStatements;
+  int* orderOffsets; // component c evaluates order[orderOffsets[c]], ..., children first
+  int* order;
+  int slots;
+  int* slotChild; // slotChild[s] is the child whose values are kept in table s
+  double* polya; // polya[s * (MAX_LEVELS + 1) + j] is the value of slotChild[s] at z^j
+  const double* table; // table read by polyaTerm(): polya, or one lane of the batch (see Batch)
+  int stride;
+  int maxLimit;
+
+  // state of an evaluation
+  double x; // point at which the system is currently evaluated, z^level
+  int level;
+  int levels; // number of powers of z computed
+  int invalid; // set when an argument leaves the domain of its function
+  Dual* registers;
+  Dual* current; // current[i] is the value of statement i
+  double* y;
+  double* start; // values at a smaller z, from which Newton's method may start at level 1
+  int warm; // 1 if Newton's method starts from start rather than from 0
+  Dual* series; // maxLimit + TAIL_TERMS + 1 entries, see construction()
+
+  // work arrays of the solver (sized for the largest component)
+  int largest; // number of statements of the largest component
+  Batch* batch; // state of batch evaluations, or NULL
+  double *residual, *step, *work, *basis, *hessenberg, *cosines, *sines, *rhs;
+};
+
+/******************************* Dual numbers *******************************/
+
+static inline Dual dual(double v, double d)
+{
+  Dual r = {v, d};
+  return r;
+}
+
+static inline Dual dualAdd(Dual a, Dual b)
+{
+  return dual(a.v + b.v, a.d + b.d);
+}
+
+static inline Dual dualSub(Dual a, Dual b)
+{
+  return dual(a.v - b.v, a.d - b.d);
+}
+
+static inline Dual dualMul(Dual a, Dual b)
+{
+  return dual(a.v * b.v, a.v * b.d + a.d * b.v);
+}
+
+static inline Dual dualScale(Dual a, double s)
+{
+  return dual(a.v * s, a.d * s);
+}
+
+static inline Dual dualExp(Dual a)
+{
+  double e = exp(a.v);
+  return dual(e, e * a.d);
+}
+
+// 1 / (1 - a)
+static inline Dual dualInverse(Dual a)
+{
+  double r = 1.0 / (1.0 - a.v);
+  return dual(r, r * r * a.d);
+}
+
+// log(1 / (1 - a))
+static inline Dual dualLog(Dual a)
+{
+  return dual(-log1p(-a.v), a.d / (1.0 - a.v));
+}
+
+static inline Dual dualPower(Dual a, int k)
+{
+  Dual r = dual(1.0, 0.0);
+  for (; k > 0; k >>= 1, a = dualMul(a, a)) {
+    if (k & 1) {
+      r = dualMul(r, a);
+    }
+  }
+  return r;
+}
+
+static int eulerPhi(int n)
+{
+  int result = n;
+  for (int p = 2; p * p <= n; p++) {
+    if (n % p == 0) {
+      while (n % p == 0) {
+        n /= p;
+      }
+      result -= result / p;
+    }
+  }
+  return (n > 1) ? result - result / n : result;
+}
+
+/******************************* Evaluation *******************************/
+
+/*
+  Helper function that returns the value at z^j of the child of an UNLABELLED construction,
+  at the current level (a constant, since only the value at z itself depends on the
+  unknowns being solved for), or 0 if it is negligible.
+*/
+static inline Dual polyaTerm(const Oracle* oracle, int slot, int j)
+{
+  int level = oracle->level * j;
+  return dual((level <= oracle->levels) ? oracle->table[(slot * (MAX_LEVELS + 1) + level) * oracle->stride] : 0.0, 0.0);
+}
+
+/*
+  Helper function that returns T_n(a), the value of the construction of the instruction
+  (Set, PowerSet, Sequence or Cycle) restricted to n components, from T_0(a), ..., T_{n-1}(a).
+*/
+static Dual seriesTerm(const Oracle* oracle, const Instruction* I, Dual a, const Dual* T, int n)
+{
+  int labelled = (oracle->type == LABELLED);
+  int op = I->op;
+  Dual term = dual(0.0, 0.0);
+
+  if (n == 0) {
+    return dual((op == FLAT_CYCLE) ? 0.0 : 1.0, 0.0);
+  } else if (op == FLAT_SEQUENCE) {
+    return dualMul(T[n - 1], a);
+  } else if (labelled && op == FLAT_CYCLE) {
+    return dualScale(dualPower(a, n), 1.0 / n);
+  } else if (labelled) { // Set and PowerSet: a^n / n!
+    return dualScale(dualMul(T[n - 1], a), 1.0 / n);
+  } else if (op == FLAT_CYCLE) { // (1/n) sum over d | n of phi(d) a(z^d)^(n/d)
+    for (int d = 1; d <= n; d++) {
+      if (n % d == 0) {
+        Dual ad = (d == 1) ? a : polyaTerm(oracle, I->slot, d);
+        term = dualAdd(term, dualScale(dualPower(ad, n / d), eulerPhi(d)));
+      }
+    }
+  } else { // multisets and sets: (1/n) sum of (+/-) a(z^j) T_{n-j}
+    for (int j = 1; j <= n; j++) {
+      Dual aj = (j == 1) ? a : polyaTerm(oracle, I->slot, j);
+      double sign = (op == FLAT_POWERSET && j % 2 == 0) ? -1.0 : 1.0;
+      term = dualAdd(term, dualScale(dualMul(aj, T[n - j]), sign));
+    }
+  }
+  return dualScale(term, 1.0 / n);
+}
+
+/*
+  Helper function that returns the value of Set, PowerSet, Sequence or Cycle of a: with
+  T(a) the value of the construction, and T_k(a) that of the construction restricted to k
+  components, this is T_k(a) for card = k, T_0(a) + ... + T_k(a) for card <= k, and
+  T(a) - T_0(a) - ... - T_{k-1}(a) for card >= k (or T_k(a) + T_{k+1}(a) + ... if a is
+  small, since the difference would then cancel out). The series T_0, T_1, ... is computed
+  into oracle->series.
+*/
+static Dual construction(Oracle* oracle, const Instruction* I, Dual a)
+{
+  int labelled = (oracle->type == LABELLED);
+  int op = I->op;
+  int k = I->limit;
+  int terms = (I->restriction == EQUAL || I->restriction == LESS) ? k + 1 :
+    (I->restriction == GREATER) ? k : 0;
+  Dual* T = oracle->series;
+
+  for (int n = 0; n < terms; n++) {
+    T[n] = seriesTerm(oracle, I, a, T, n);
+  }
+
+  if (I->restriction == GREATER && a.v < TAIL_BOUND) {
+    Dual tail = dual(0.0, 0.0);
+    for (int n = k; n < k + TAIL_TERMS; n++) {
+      T[n] = seriesTerm(oracle, I, a, T, n);
+      tail = dualAdd(tail, T[n]);
+      if (fabs(T[n].v) <= NEGLIGIBLE * tail.v && n > k) {
+        break;
+      }
+    }
+    return tail;
+  }
+
+  Dual result = dual(0.0, 0.0);
+  if (I->restriction == EQUAL) {
+    return T[k];
+  }
+  if (I->restriction == LESS) {
+    for (int n = 0; n <= k; n++) {
+      result = dualAdd(result, T[n]);
+    }
+    return result;
+  }
+
+  // the unrestricted construction
+  if (op == FLAT_SEQUENCE || op == FLAT_CYCLE) {
+    if (a.v >= 1.0) {
+      oracle->invalid = 1;
+      return dual(INFINITY, 0.0);
+    }
+    result = (op == FLAT_SEQUENCE) ? dualInverse(a) : dualLog(a);
+    for (int j = 2; op == FLAT_CYCLE && !labelled && oracle->level * j <= oracle->levels; j++) {
+      Dual aj = polyaTerm(oracle, I->slot, j);
+      if (aj.v >= 1.0) {
+        oracle->invalid = 1;
+        return dual(INFINITY, 0.0);
+      }
+      result = dualAdd(result, dualScale(dualLog(aj), (double) eulerPhi(j) / j));
+    }
+  } else {
+    Dual exponent = a;
+    for (int j = 2; !labelled && oracle->level * j <= oracle->levels; j++) {
+      double sign = (op == FLAT_POWERSET && j % 2 == 0) ? -1.0 : 1.0;
+      exponent = dualAdd(exponent, dualScale(polyaTerm(oracle, I->slot, j), sign / j));
+    }
+    result = dualExp(exponent);
+  }
+  for (int n = 0; n < terms; n++) { // card >= k
+    result = dualSub(result, T[n]);
+  }
+  return result;
+}
+
+/*
+  Helper function that evaluates the instructions of component c at the current point,
+  the unknowns of the component being y (with derivatives v, or 0 if v is NULL). Other
+  statements are read from oracle->current.
+*/
+static void evaluateComponent(Oracle* oracle, int c, const double* v)
+{
+  const Instruction* program = oracle->program;
+  Dual* R = oracle->registers;
+  int first = oracle->componentOffsets[c];
+  int m = oracle->componentOffsets[c + 1] - first;
+
+  for (int k = 0; k < m; k++) {
+    int i = oracle->componentStatements[first + k];
+    oracle->current[i] = dual(oracle->y[i], (v != NULL) ? v[k] : 0.0);
+  }
+
+  for (int o = oracle->orderOffsets[c]; o < oracle->orderOffsets[c + 1]; o++) {
+    int n = oracle->order[o];
+    const Instruction* I = &program[n];
+    const int* children = oracle->childList + I->first;
+    switch (I->op) {
+    case (FLAT_EPSILON):
+      R[n] = dual(1.0, 0.0);
+      break;
+    case (FLAT_ATOM):
+    case (FLAT_Z):
+      R[n] = dual(oracle->x, 0.0);
+      break;
+    case (FLAT_ID):
+      R[n] = oracle->current[I->first];
+      break;
+    case (FLAT_UNION):
+      R[n] = dual(0.0, 0.0);
+      for (int k = 0; k < I->count; k++) {
+        R[n] = dualAdd(R[n], R[children[k]]);
+      }
+      break;
+    case (FLAT_PROD):
+      R[n] = dual(1.0, 0.0);
+      for (int k = 0; k < I->count; k++) {
+        R[n] = dualMul(R[n], R[children[k]]);
+      }
+      break;
+    default: // SET, POWERSET, SEQUENCE, CYCLE
+      R[n] = construction(oracle, I, R[children[0]]);
+    }
+  }
+}
+
+/*
+  Helper function that sets out to (I - J) v, with J the Jacobian of the system of
+  component c at the current unknowns.
+*/
+static void applyOperator(Oracle* oracle, int c, const double* v, double* out)
+{
+  int first = oracle->componentOffsets[c];
+  int m = oracle->componentOffsets[c + 1] - first;
+  evaluateComponent(oracle, c, v);
+  for (int k = 0; k < m; k++) {
+    out[k] = v[k] - oracle->registers[oracle->roots[oracle->componentStatements[first + k]]].d;
+  }
+}
+
+/*
+  Helper function that solves (I - J) x = b approximately, for component c, with the
+  restarted GMRES method (which only needs products of J by vectors, so that the Jacobian
+  is never formed).
+*/
+static void gmres(Oracle* oracle, int c, const double* b, double* x)
+{
+  int m = oracle->componentOffsets[c + 1] - oracle->componentOffsets[c];
+  int restart = (m < GMRES_RESTART) ? m : GMRES_RESTART;
+  double* V = oracle->basis; // restart + 1 vectors of m entries
+  double* H = oracle->hessenberg; // (restart + 1) x restart, by columns
+  double* cs = oracle->cosines;
+  double* sn = oracle->sines;
+  double* g = oracle->rhs;
+  double* w = oracle->work;
+  double normB = 0.0;
+
+  for (int k = 0; k < m; k++) {
+    x[k] = 0.0;
+    normB += b[k] * b[k];
+  }
+  normB = sqrt(normB);
+  if (normB == 0.0) {
+    return;
+  }
+
+  for (int cycle = 0; cycle < GMRES_RESTARTS; cycle++) {
+    // residual b - (I - J) x
+    double beta = 0.0;
+    if (cycle == 0) {
+      memcpy(V, b, m * sizeof(double));
+    } else {
+      applyOperator(oracle, c, x, w);
+      for (int k = 0; k < m; k++) {
+        V[k] = b[k] - w[k];
+      }
+    }
+    for (int k = 0; k < m; k++) {
+      beta += V[k] * V[k];
+    }
+    beta = sqrt(beta);
+    if (beta <= GMRES_TOLERANCE * normB) {
+      return;
+    }
+    for (int k = 0; k < m; k++) {
+      V[k] /= beta;
+    }
+    memset(g, 0, (restart + 1) * sizeof(double));
+    g[0] = beta;
+
+    int j = 0;
+    while (j < restart) {
+      double* h = H + j * (restart + 1);
+      double* next = V + (j + 1) * m;
+      applyOperator(oracle, c, V + j * m, next);
+      for (int i = 0; i <= j; i++) { // modified Gram-Schmidt
+        h[i] = 0.0;
+        for (int k = 0; k < m; k++) {
+          h[i] += next[k] * V[i * m + k];
+        }
+        for (int k = 0; k < m; k++) {
+          next[k] -= h[i] * V[i * m + k];
+        }
+      }
+      h[j + 1] = 0.0;
+      for (int k = 0; k < m; k++) {
+        h[j + 1] += next[k] * next[k];
+      }
+      h[j + 1] = sqrt(h[j + 1]);
+      for (int i = 0; i < j; i++) { // previous rotations
+        double t = cs[i] * h[i] + sn[i] * h[i + 1];
+        h[i + 1] = -sn[i] * h[i] + cs[i] * h[i + 1];
+        h[i] = t;
+      }
+      double r = hypot(h[j], h[j + 1]);
+      int breakdown = (h[j + 1] == 0.0);
+      if (r == 0.0) {
+        break;
+      }
+      if (!breakdown) {
+        for (int k = 0; k < m; k++) {
+          next[k] /= h[j + 1];
+        }
+      }
+      cs[j] = h[j] / r;
+      sn[j] = h[j + 1] / r;
+      h[j] = r;
+      h[j + 1] = 0.0;
+      g[j + 1] = -sn[j] * g[j];
+      g[j] = cs[j] * g[j];
+      j++;
+      if (breakdown || fabs(g[j]) <= GMRES_TOLERANCE * normB) {
+        break;
+      }
+    }
+
+    // x += V y, with H y = g
+    for (int i = j - 1; i >= 0; i--) {
+      for (int l = i + 1; l < j; l++) {
+        g[i] -= H[l * (restart + 1) + i] * g[l];
+      }
+      g[i] /= H[i * (restart + 1) + i];
+    }
+    for (int i = 0; i < j; i++) {
+      for (int k = 0; k < m; k++) {
+        x[k] += g[i] * V[i * m + k];
+      }
+    }
+    if (j < restart) { // converged (or broke down) before the end of the cycle
+      return;
+    }
+  }
+}
+
+/*
+  Helper function that solves the system of component c at the current point with Newton's
+  method, from 0 (or from the solution at a smaller z, which is below the least solution as
+  well). Returns 0 on success, -1 if z is beyond the singularity.
+*/
+static int solveComponent(Oracle* oracle, int c)
+{
+  int first = oracle->componentOffsets[c];
+  int m = oracle->componentOffsets[c + 1] - first;
+  const int* S = oracle->componentStatements + first;
+  double* r = oracle->residual;
+  double* d = oracle->step;
+
+  int warm = oracle->warm && oracle->level == 1;
+  for (int k = 0; k < m; k++) {
+    oracle->y[S[k]] = warm ? oracle->start[S[k]] : 0.0;
+  }
+
+  for (int iteration = 0; iteration < NEWTON_ITERATIONS; iteration++) {
+    evaluateComponent(oracle, c, NULL);
+    if (oracle->invalid) {
+      return -1;
+    }
+    int converged = 1;
+    for (int k = 0; k < m; k++) {
+      double value = oracle->registers[oracle->roots[S[k]]].v;
+      r[k] = value - oracle->y[S[k]];
+      if (!isfinite(value)) {
+        return -1;
+      }
+      if (fabs(r[k]) > NEWTON_TOLERANCE * fabs(value)) {
+        converged = 0;
+      }
+    }
+    if (!oracle->recursive[c]) { // F does not depend on y
+      for (int k = 0; k < m; k++) {
+        oracle->y[S[k]] += r[k];
+        oracle->current[S[k]] = dual(oracle->y[S[k]], 0.0);
+      }
+      return 0;
+    }
+    if (converged) {
+      return 0;
+    }
+
+    gmres(oracle, c, r, d);
+    if (oracle->invalid) {
+      return -1;
+    }
+    double largest = 0.0;
+    for (int k = 0; k < m; k++) {
+      largest = fmax(largest, fabs(d[k]));
+    }
+    for (int k = 0; k < m; k++) {
+      // below the singularity, the iteration increases monotonically to the least solution
+      if (!isfinite(d[k]) || d[k] < -1e-9 * (oracle->y[S[k]] + largest)) {
+        return -1;
+      }
+      oracle->y[S[k]] += d[k];
+    }
+  }
+  return -1;
+}
+
+/*
+  Helper function that solves the whole system at x, component after component.
+*/
+static int solveSystem(Oracle* oracle, double x)
+{
+  oracle->x = x;
+  oracle->invalid = 0;
+  for (int c = 0; c < oracle->componentCount; c++) {
+    if (solveComponent(oracle, c) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/*
+  Helper function that evaluates the system at z, into oracle->y.
+*/
+static int evaluate(Oracle* oracle, double z)
+{
+  if (!(z >= 0.0) || !isfinite(z)) {
+    return -1;
+  }
+
+  // with the Pólya operators, the values at z^j, from the highest power down
+  oracle->table = oracle->polya;
+  oracle->stride = 1;
+  oracle->levels = 1;
+  if (oracle->slots > 0 && z > 0.0) {
+    if (z >= 1.0) {
+      return -1;
+    }
+    double levels = ceil(log(NEGLIGIBLE) / log(z));
+    oracle->levels = (levels < MAX_LEVELS) ? (int) levels : MAX_LEVELS;
+  }
+  for (oracle->level = oracle->levels; oracle->level >= 1; oracle->level--) {
+    if (solveSystem(oracle, pow(z, oracle->level)) < 0) {
+      return -1;
+    }
+    for (int s = 0; s < oracle->slots; s++) {
+      oracle->polya[s * (MAX_LEVELS + 1) + oracle->level] = oracle->registers[oracle->slotChild[s]].v;
+    }
+  }
+  oracle->level = 1;
+  return 0;
+}
+
+int evaluateOracle(Oracle* oracle, double z, double* values)
+{
+  oracle->warm = 0;
+  if (evaluate(oracle, z) < 0) {
+    return -1;
+  }
+  memcpy(values, oracle->y, oracle->statements * sizeof(double));
+  return 0;
+}
+
+double oracleSingularity(Oracle* oracle, double precision)
+{
+  double low = 0.0, high = 1.0;
+
+  // every evaluation starts from the solution at low, the largest z known to be valid
+  oracle->warm = 0;
+  if (evaluate(oracle, 0.0) < 0) {
+    return 0.0;
+  }
+  memcpy(oracle->start, oracle->y, oracle->statements * sizeof(double));
+  oracle->warm = 1;
+  while (evaluate(oracle, high) == 0) {
+    memcpy(oracle->start, oracle->y, oracle->statements * sizeof(double));
+    low = high;
+    high *= 2.0;
+    if (high > 1048576.0) {
+      oracle->warm = 0;
+      return INFINITY;
+    }
+  }
+  while (high - low > precision * high) {
+    double middle = (low + high) / 2.0;
+    if (evaluate(oracle, middle) == 0) {
+      memcpy(oracle->start, oracle->y, oracle->statements * sizeof(double));
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  oracle->warm = 0;
+  return low;
+}
+
+int oracleSize(const Oracle* oracle)
+{
+  return oracle->statements;
+}
+
+/******************************* Batch evaluation *******************************/
+
+/*
+  Lanes of a batch: the points of a batch are evaluated together, one per lane of a SIMD
+  vector (with the vector extensions of GCC and Clang), so that each instruction runs on
+  all of them at once. The width is that of the instruction set the library is compiled
+  for (-mavx512f, -mavx2, ...), with a scalar fallback.
+*/
+#if defined(__GNUC__) && defined(__AVX512F__)
+#define LANES 8
+#elif defined(__GNUC__) && defined(__AVX__)
+#define LANES 4
+#elif defined(__GNUC__) && (defined(__SSE2__) || defined(__ARM_NEON))
+#define LANES 2
+#else
+#define LANES 1
+#endif
+
+#if LANES > 1
+typedef double Lane __attribute__((vector_size(LANES * sizeof(double))));
+#define LANE(x, l) ((x)[l])
+#else
+typedef double Lane;
+#define LANE(x, l) (x)
+#endif
+
+/*
+  State of a batch evaluation: the same as that of a scalar evaluation, with one lane per
+  point. Allocated the first time evaluateOracleBatch() is called.
+*/
+struct Batch_s
+{
+  Lane x;
+  Lane* values; // registers
+  Lane* dots;
+  Lane* currentValues; // statements
+  Lane* currentDots;
+  Lane* y;
+  double* polya; // polya[(s * (MAX_LEVELS + 1) + j) * LANES + l] is the value of slotChild[s] at z_l^j
+  Lane *residual, *step, *work, *basis, *hessenberg, *cosines, *sines, *rhs;
+};
+
+static inline Lane broadcast(double c)
+{
+  Lane r;
+  for (int l = 0; l < LANES; l++) {
+    LANE(r, l) = c;
+  }
+  return r;
+}
+
+/*
+  Helper function that allocates memory aligned for Lane (posix_memalign() rather than
+  aligned_alloc(), which is C11). Returns NULL if the allocation fails.
+*/
+static void* allocateLanes(size_t size)
+{
+  void* memory;
+  return (posix_memalign(&memory, sizeof(Lane), size) == 0) ? memory : NULL;
+}
+
+static Lane* newLanes(size_t count)
+{
+  return allocateLanes((count + 1) * sizeof(Lane));
+}
+
+/*
+  Helper function that evaluates Sequence, and the labelled constructions restricted to
+  card = k or card <= k, for every lane at once (these need neither exp() nor log(), see
+  construction()). Returns 0 for the other constructions, which are left to construction().
+*/
+static int constructionLanes(Oracle* oracle, const Instruction* I, Lane a, Lane da, Lane* value, Lane* dot, char* invalid)
+{
+  int labelled = (oracle->type == LABELLED);
+  int restricted = (I->restriction == EQUAL || I->restriction == LESS);
+
+  if (I->op == FLAT_SEQUENCE && I->restriction == NONE) { // 1 / (1 - a)
+    Lane r = broadcast(1.0) / (broadcast(1.0) - a);
+    for (int l = 0; l < LANES; l++) {
+      if (LANE(a, l) >= 1.0) {
+        invalid[l] = 1;
+      }
+    }
+    *value = r;
+    *dot = r * r * da;
+    return 1;
+  }
+  if (!restricted || (I->op != FLAT_SEQUENCE && !labelled)) {
+    return 0;
+  }
+
+  // T_n = c_n a^n, with c_n = 1 (Sequence), 1/n! (Set, PowerSet) or 1/n (Cycle, n > 0)
+  Lane power = broadcast(1.0), powerDot = broadcast(0.0);
+  Lane sum = broadcast(0.0), sumDot = broadcast(0.0);
+  double factorial = 1.0;
+  for (int n = 0; n <= I->limit; n++) {
+    if (n > 0) {
+      powerDot = power * da + powerDot * a;
+      power *= a;
+      factorial *= n;
+    }
+    double coefficient = (I->op == FLAT_SEQUENCE) ? 1.0 :
+      (I->op == FLAT_CYCLE) ? ((n > 0) ? 1.0 / n : 0.0) : 1.0 / factorial;
+    if (I->restriction == LESS || n == I->limit) {
+      sum += power * coefficient;
+      sumDot += powerDot * coefficient;
+    }
+  }
+  *value = sum;
+  *dot = sumDot;
+  return 1;
+}
+
+/*
+  Helper function that evaluates the instructions of component c for every lane (see
+  evaluateComponent()). The constructions that need exp() or log() are evaluated one
+  lane at a time; invalid[l] is set if an argument of lane l leaves its domain.
+*/
+static void evaluateComponentLanes(Oracle* oracle, int c, const Lane* v, char* invalid)
+{
+  Batch* B = oracle->batch;
+  Lane* V = B->values;
+  Lane* D = B->dots;
+  Lane zero = broadcast(0.0);
+  Lane one = broadcast(1.0);
+  int first = oracle->componentOffsets[c];
+  int m = oracle->componentOffsets[c + 1] - first;
+
+  for (int k = 0; k < m; k++) {
+    int i = oracle->componentStatements[first + k];
+    B->currentValues[i] = B->y[i];
+    B->currentDots[i] = (v != NULL) ? v[k] : zero;
+  }
+
+  for (int o = oracle->orderOffsets[c]; o < oracle->orderOffsets[c + 1]; o++) {
+    int n = oracle->order[o];
+    const Instruction* I = &oracle->program[n];
+    const int* children = oracle->childList + I->first;
+    switch (I->op) {
+    case (FLAT_EPSILON):
+      V[n] = one;
+      D[n] = zero;
+      break;
+    case (FLAT_ATOM):
+    case (FLAT_Z):
+      V[n] = B->x;
+      D[n] = zero;
+      break;
+    case (FLAT_ID):
+      V[n] = B->currentValues[I->first];
+      D[n] = B->currentDots[I->first];
+      break;
+    case (FLAT_UNION): {
+      Lane value = zero, dot = zero;
+      for (int k = 0; k < I->count; k++) {
+        value += V[children[k]];
+        dot += D[children[k]];
+      }
+      V[n] = value;
+      D[n] = dot;
+      break;
+    }
+    case (FLAT_PROD): {
+      Lane value = one, dot = zero;
+      for (int k = 0; k < I->count; k++) {
+        dot = value * D[children[k]] + dot * V[children[k]];
+        value *= V[children[k]];
+      }
+      V[n] = value;
+      D[n] = dot;
+      break;
+    }
+    default: // SET, POWERSET, SEQUENCE, CYCLE
+      if (constructionLanes(oracle, I, V[children[0]], D[children[0]], &V[n], &D[n], invalid)) {
+        break;
+      }
+      for (int l = 0; l < LANES; l++) {
+        oracle->table = B->polya + l;
+        oracle->invalid = 0;
+        Dual r = construction(oracle, I, dual(LANE(V[children[0]], l), LANE(D[children[0]], l)));
+        LANE(V[n], l) = r.v;
+        LANE(D[n], l) = r.d;
+        invalid[l] |= oracle->invalid;
+      }
+    }
+  }
+}
+
+/*
+  Helper function that sets out to (I - J) v for every lane (see applyOperator()).
+*/
+static void applyOperatorLanes(Oracle* oracle, int c, const Lane* v, Lane* out, char* invalid)
+{
+  int first = oracle->componentOffsets[c];
+  int m = oracle->componentOffsets[c + 1] - first;
+  evaluateComponentLanes(oracle, c, v, invalid);
+  for (int k = 0; k < m; k++) {
+    out[k] = v[k] - oracle->batch->dots[oracle->roots[oracle->componentStatements[first + k]]];
+  }
+}
+
+/*
+  Helper function that solves (I - J) x = b for every lane, with GMRES (see gmres()). The
+  lanes iterate in lockstep: a lane that has converged keeps a null basis vector, which
+  leaves its solution unchanged, until all lanes have converged.
+*/
+static void gmresLanes(Oracle* oracle, int c, const Lane* b, Lane* x, char* invalid)
+{
+  Batch* B = oracle->batch;
+  int m = oracle->componentOffsets[c + 1] - oracle->componentOffsets[c];
+  int restart = (m < GMRES_RESTART) ? m : GMRES_RESTART;
+  Lane* V = B->basis;
+  Lane* H = B->hessenberg;
+  Lane* cs = B->cosines;
+  Lane* sn = B->sines;
+  Lane* g = B->rhs;
+  Lane* w = B->work;
+  Lane zero = broadcast(0.0);
+  Lane normB = zero;
+  char stopped[LANES], active[LANES];
+  int used[LANES];
+
+  for (int k = 0; k < m; k++) {
+    x[k] = zero;
+    normB += b[k] * b[k];
+  }
+  int remaining = 0;
+  for (int l = 0; l < LANES; l++) {
+    LANE(normB, l) = sqrt(LANE(normB, l));
+    stopped[l] = (LANE(normB, l) == 0.0);
+    remaining += !stopped[l];
+  }
+
+  for (int cycle = 0; cycle < GMRES_RESTARTS && remaining > 0; cycle++) {
+    // residual b - (I - J) x, normalized (null for the lanes that have stopped)
+    Lane beta = zero, scale;
+    if (cycle == 0) {
+      memcpy(V, b, m * sizeof(Lane));
+    } else {
+      applyOperatorLanes(oracle, c, x, w, invalid);
+      for (int k = 0; k < m; k++) {
+        V[k] = b[k] - w[k];
+      }
+    }
+    for (int k = 0; k < m; k++) {
+      beta += V[k] * V[k];
+    }
+    for (int l = 0; l < LANES; l++) {
+      LANE(beta, l) = sqrt(LANE(beta, l));
+      if (!stopped[l] && LANE(beta, l) <= GMRES_TOLERANCE * LANE(normB, l)) {
+        stopped[l] = 1;
+      }
+      active[l] = !stopped[l];
+      used[l] = 0;
+      LANE(scale, l) = active[l] ? 1.0 / LANE(beta, l) : 0.0;
+    }
+    for (int k = 0; k < m; k++) {
+      V[k] *= scale;
+    }
+    for (int i = 0; i <= restart; i++) {
+      g[i] = zero;
+    }
+    for (int l = 0; l < LANES; l++) {
+      LANE(g[0], l) = active[l] ? LANE(beta, l) : 0.0;
+    }
+
+    int j = 0;
+    int running = remaining;
+    while (j < restart && running > 0) {
+      Lane* h = H + j * (restart + 1);
+      Lane* next = V + (j + 1) * m;
+      applyOperatorLanes(oracle, c, V + j * m, next, invalid);
+      for (int i = 0; i <= j; i++) { // modified Gram-Schmidt
+        Lane dot = zero;
+        for (int k = 0; k < m; k++) {
+          dot += next[k] * V[i * m + k];
+        }
+        h[i] = dot;
+        for (int k = 0; k < m; k++) {
+          next[k] -= dot * V[i * m + k];
+        }
+      }
+      Lane norm = zero;
+      for (int k = 0; k < m; k++) {
+        norm += next[k] * next[k];
+      }
+      running = 0;
+      for (int l = 0; l < LANES; l++) {
+        LANE(scale, l) = 0.0;
+        if (!active[l]) {
+          continue;
+        }
+        double hn = sqrt(LANE(norm, l));
+        LANE(h[j + 1], l) = hn;
+        for (int i = 0; i < j; i++) { // previous rotations
+          double t = LANE(cs[i], l) * LANE(h[i], l) + LANE(sn[i], l) * LANE(h[i + 1], l);
+          LANE(h[i + 1], l) = -LANE(sn[i], l) * LANE(h[i], l) + LANE(cs[i], l) * LANE(h[i + 1], l);
+          LANE(h[i], l) = t;
+        }
+        double r = hypot(LANE(h[j], l), hn);
+        if (r == 0.0) {
+          active[l] = 0;
+          stopped[l] = 1;
+          continue;
+        }
+        LANE(cs[j], l) = LANE(h[j], l) / r;
+        LANE(sn[j], l) = hn / r;
+        LANE(h[j], l) = r;
+        LANE(h[j + 1], l) = 0.0;
+        LANE(g[j + 1], l) = -LANE(sn[j], l) * LANE(g[j], l);
+        LANE(g[j], l) = LANE(cs[j], l) * LANE(g[j], l);
+        used[l] = j + 1;
+        if (hn == 0.0 || fabs(LANE(g[j + 1], l)) <= GMRES_TOLERANCE * LANE(normB, l)) {
+          active[l] = 0;
+          stopped[l] = 1;
+        } else {
+          LANE(scale, l) = 1.0 / hn;
+          running++;
+        }
+      }
+      for (int k = 0; k < m; k++) {
+        next[k] *= scale;
+      }
+      j++;
+    }
+
+    // x += V y, with H y = g (for each lane, on the columns it used)
+    for (int l = 0; l < LANES; l++) {
+      for (int i = used[l] - 1; i >= 0; i--) {
+        for (int k = i + 1; k < used[l]; k++) {
+          LANE(g[i], l) -= LANE(H[k * (restart + 1) + i], l) * LANE(g[k], l);
+        }
+        LANE(g[i], l) /= LANE(H[i * (restart + 1) + i], l);
+      }
+      for (int i = used[l]; i < j; i++) {
+        LANE(g[i], l) = 0.0;
+      }
+      if (used[l] < restart) { // converged (or broke down) before the end of the cycle
+        stopped[l] = 1;
+      }
+    }
+    for (int i = 0; i < j; i++) {
+      for (int k = 0; k < m; k++) {
+        x[k] += g[i] * V[i * m + k];
+      }
+    }
+    remaining = 0;
+    for (int l = 0; l < LANES; l++) {
+      remaining += !stopped[l];
+    }
+  }
+}
+
+/*
+  Helper function that solves the system of component c for every lane with Newton's
+  method, from 0 (see solveComponent()). failed[l] is set for the lanes beyond the
+  singularity, whose values are then meaningless.
+*/
+static void solveComponentLanes(Oracle* oracle, int c, char* failed)
+{
+  Batch* B = oracle->batch;
+  int first = oracle->componentOffsets[c];
+  int m = oracle->componentOffsets[c + 1] - first;
+  const int* S = oracle->componentStatements + first;
+  Lane* r = B->residual;
+  Lane* d = B->step;
+  char done[LANES], invalid[LANES];
+
+  for (int k = 0; k < m; k++) {
+    B->y[S[k]] = broadcast(0.0);
+  }
+  memcpy(done, failed, LANES);
+
+  for (int iteration = 0; iteration < NEWTON_ITERATIONS; iteration++) {
+    memset(invalid, 0, LANES);
+    evaluateComponentLanes(oracle, c, NULL, invalid);
+    for (int k = 0; k < m; k++) {
+      r[k] = B->values[oracle->roots[S[k]]] - B->y[S[k]];
+    }
+    if (!oracle->recursive[c]) { // F does not depend on y
+      for (int k = 0; k < m; k++) {
+        B->y[S[k]] += r[k];
+        B->currentValues[S[k]] = B->y[S[k]];
+        B->currentDots[S[k]] = broadcast(0.0);
+      }
+    }
+    int remaining = 0;
+    for (int l = 0; l < LANES; l++) {
+      if (done[l]) {
+        continue;
+      }
+      int converged = 1;
+      for (int k = 0; k < m; k++) {
+        double value = LANE(B->values[oracle->roots[S[k]]], l);
+        if (!isfinite(value)) {
+          invalid[l] = 1;
+        }
+        if (fabs(LANE(r[k], l)) > NEWTON_TOLERANCE * fabs(value)) {
+          converged = 0;
+        }
+      }
+      if (invalid[l]) {
+        failed[l] = 1;
+      }
+      done[l] = invalid[l] || converged || !oracle->recursive[c];
+      remaining += !done[l];
+    }
+    if (remaining == 0) {
+      return;
+    }
+
+    // the lanes that are done solve for a null step
+    for (int k = 0; k < m; k++) {
+      for (int l = 0; l < LANES; l++) {
+        if (done[l]) {
+          LANE(r[k], l) = 0.0;
+        }
+      }
+    }
+    memset(invalid, 0, LANES);
+    gmresLanes(oracle, c, r, d, invalid);
+    for (int l = 0; l < LANES; l++) {
+      if (done[l]) {
+        continue;
+      }
+      double largest = 0.0;
+      for (int k = 0; k < m; k++) {
+        largest = fmax(largest, fabs(LANE(d[k], l)));
+      }
+      for (int k = 0; k < m; k++) {
+        double step = LANE(d[k], l);
+        if (invalid[l] || !isfinite(step) || step < -1e-9 * (LANE(B->y[S[k]], l) + largest)) {
+          failed[l] = done[l] = 1;
+          break;
+        }
+      }
+    }
+    for (int k = 0; k < m; k++) {
+      for (int l = 0; l < LANES; l++) {
+        if (!done[l]) {
+          LANE(B->y[S[k]], l) += LANE(d[k], l);
+        }
+      }
+    }
+  }
+  for (int l = 0; l < LANES; l++) {
+    failed[l] |= !done[l];
+  }
+}
+
+/*
+  Helper function that allocates the state of batch evaluations.
+*/
+static Batch* newBatch(const Oracle* oracle)
+{
+  int restart = (oracle->largest < GMRES_RESTART) ? oracle->largest : GMRES_RESTART;
+  Batch* B = allocateLanes(sizeof(Batch));
+  B->values = newLanes(oracle->size);
+  B->dots = newLanes(oracle->size);
+  B->currentValues = newLanes(oracle->statements);
+  B->currentDots = newLanes(oracle->statements);
+  B->y = newLanes(oracle->statements);
+  B->polya = calloc(((size_t) oracle->slots * (MAX_LEVELS + 1) + 1) * LANES, sizeof(double));
+  B->residual = newLanes(oracle->largest);
+  B->step = newLanes(oracle->largest);
+  B->work = newLanes(oracle->largest);
+  B->basis = newLanes((size_t) (restart + 1) * oracle->largest);
+  B->hessenberg = newLanes((size_t) (restart + 1) * restart);
+  B->cosines = newLanes(restart + 1);
+  B->sines = newLanes(restart + 1);
+  B->rhs = newLanes(restart + 1);
+  return B;
+}
+
+static void freeBatch(Batch* B)
+{
+  if (B == NULL) {
+    return;
+  }
+  free(B->values);
+  free(B->dots);
+  free(B->currentValues);
+  free(B->currentDots);
+  free(B->y);
+  free(B->polya);
+  free(B->residual);
+  free(B->step);
+  free(B->work);
+  free(B->basis);
+  free(B->hessenberg);
+  free(B->cosines);
+  free(B->sines);
+  free(B->rhs);
+  free(B);
+}
+
+int evaluateOracleBatch(Oracle* oracle, const double* z, int count, double* values, int* status)
+{
+  int successes = 0;
+
+  // with two lanes, the lockstep costs more than it saves: the points are evaluated one by one
+  if (LANES <= 2) {
+    for (int p = 0; p < count; p++) {
+      int result = evaluateOracle(oracle, z[p], values + (size_t) p * oracle->statements);
+      if (status != NULL) {
+        status[p] = result;
+      }
+      successes += (result == 0);
+    }
+    return successes;
+  }
+
+  if (oracle->batch == NULL) {
+    oracle->batch = newBatch(oracle);
+  }
+  Batch* B = oracle->batch;
+
+  for (int p = 0; p < count; p += LANES) {
+    char failed[LANES];
+    double point[LANES];
+    int levels = 1;
+
+    // lanes past the end of the batch evaluate 0, and invalid points evaluate 0 as well
+    for (int l = 0; l < LANES; l++) {
+      point[l] = (p + l < count) ? z[p + l] : 0.0;
+      failed[l] = !(point[l] >= 0.0) || !isfinite(point[l]) || (oracle->slots > 0 && point[l] >= 1.0);
+      if (failed[l]) {
+        point[l] = 0.0;
+      } else if (oracle->slots > 0 && point[l] > 0.0) {
+        double needed = ceil(log(NEGLIGIBLE) / log(point[l]));
+        int level = (needed < MAX_LEVELS) ? (int) needed : MAX_LEVELS;
+        levels = (level > levels) ? level : levels;
+      }
+    }
+
+    oracle->stride = LANES;
+    oracle->levels = levels;
+    for (oracle->level = levels; oracle->level >= 1; oracle->level--) {
+      for (int l = 0; l < LANES; l++) {
+        LANE(B->x, l) = pow(point[l], oracle->level);
+      }
+      for (int c = 0; c < oracle->componentCount; c++) {
+        solveComponentLanes(oracle, c, failed);
+      }
+      for (int s = 0; s < oracle->slots; s++) {
+        for (int l = 0; l < LANES; l++) {
+          B->polya[(s * (MAX_LEVELS + 1) + oracle->level) * LANES + l] = LANE(B->values[oracle->slotChild[s]], l);
+        }
+      }
+    }
+    oracle->level = 1;
+
+    for (int l = 0; l < LANES && p + l < count; l++) {
+      for (int i = 0; i < oracle->statements; i++) {
+        values[(size_t) (p + l) * oracle->statements + i] = LANE(B->y[i], l);
+      }
+      if (status != NULL) {
+        status[p + l] = failed[l] ? -1 : 0;
+      }
+      successes += !failed[l];
+    }
+  }
+  return successes;
+}
+
+int oracleLanes(void)
+{
+  return LANES;
+}
+
+/******************************* Compilation *******************************/
+
+Oracle* compileOracle(Grammar* grammar, OracleType type)
+{
+  GrammarAnalysis* analysis = analyzeGrammar(grammar);
+  if (analysis == NULL) {
+    return NULL;
+  }
+  const GrammarGraph* graph = analysis->graph;
+  FlatGrammar* flat = flattenGrammar(grammar);
+  int size = flat->size;
+  int statements = flat->statements;
+
+  Oracle* oracle = calloc(1, sizeof(Oracle));
+  oracle->type = type;
+  oracle->size = size;
+  oracle->statements = statements;
+  oracle->program = malloc((size + 1) * sizeof(Instruction));
+  oracle->childList = malloc((size + 1) * sizeof(int));
+  oracle->slotChild = malloc((size + 1) * sizeof(int));
+
+  // one instruction per node
+  int children = 0;
+  int failed = 0;
+  for (int n = 0; n < size && !failed; n++) {
+    const FlatNode* N = &flat->nodes[n];
+    Instruction* I = &oracle->program[n];
+    long long int limit = flatLimit(flat, n);
+    I->op = N->op;
+    I->restriction = N->restriction;
+    I->reserved = 0;
+    I->first = children;
+    I->count = N->children;
+    I->limit = (int) limit;
+    I->slot = -1;
+    for (int k = 0, c = flatFirstChild(n); k < N->children; k++, c = flatNextSibling(flat, c)) {
+      oracle->childList[children++] = c;
+    }
+    if (N->op == FLAT_ID) {
+      I->first = graph->definition[N->value];
+    } else if (N->op == FLAT_Z && graph->zStatement >= 0) {
+      I->op = FLAT_ID;
+      I->first = graph->zStatement;
+    }
+    if (limit > MAX_LIMIT || N->op == FLAT_SUBST || (I->op == FLAT_ID && I->first < 0)) {
+      failed = 1;
+    }
+    if (type == UNLABELLED && (N->op == FLAT_SET || N->op == FLAT_POWERSET || N->op == FLAT_CYCLE)) {
+      I->slot = oracle->slots;
+      oracle->slotChild[oracle->slots++] = flatFirstChild(n);
+    }
+    if (limit > oracle->maxLimit) {
+      oracle->maxLimit = (int) limit;
+    }
+  }
+  if (failed) {
+    oracle->roots = NULL;
+    freeOracle(oracle);
+    freeFlatGrammar(flat);
+    return NULL;
+  }
+
+  // components, and their instructions (children before parents)
+  int count = analysis->componentCount;
+  oracle->componentCount = count;
+  oracle->roots = malloc((statements + 1) * sizeof(int));
+  memcpy(oracle->roots, flat->roots, statements * sizeof(int));
+  oracle->recursive = malloc(count + 1);
+  memcpy(oracle->recursive, analysis->recursive, count);
+  oracle->componentOffsets = malloc((count + 1) * sizeof(int));
+  memcpy(oracle->componentOffsets, analysis->componentOffsets, (count + 1) * sizeof(int));
+  oracle->componentStatements = malloc((statements + 1) * sizeof(int));
+  memcpy(oracle->componentStatements, analysis->componentStatements, statements * sizeof(int));
+  oracle->orderOffsets = malloc((count + 1) * sizeof(int));
+  oracle->order = malloc((size + 1) * sizeof(int));
+  // a subtree equal to one already evaluated in the component (see shareGrammar()) is
+  // not evaluated again: its parents read the registers of the first one (alias[n])
+  int* alias = malloc((size + 1) * sizeof(int));
+  int* emitted = malloc((size + 1) * sizeof(int));
+  int* stamp = malloc((size + 1) * sizeof(int));
+  memset(stamp, -1, (size + 1) * sizeof(int));
+  int largest = 1;
+  int next = 0;
+  for (int c = 0; c < count; c++) {
+    oracle->orderOffsets[c] = next;
+    for (int k = oracle->componentOffsets[c]; k < oracle->componentOffsets[c + 1]; k++) {
+      int root = flat->roots[oracle->componentStatements[k]];
+      for (int n = root + flat->nodes[root].span - 1; n >= root; n--) {
+        int class = (flat->shared != NULL) ? flat->shared[n] : n;
+        if (stamp[class] == c) {
+          alias[n] = emitted[class];
+          continue;
+        }
+        stamp[class] = c;
+        emitted[class] = n;
+        alias[n] = n;
+        oracle->order[next++] = n;
+      }
+    }
+    if (oracle->componentOffsets[c + 1] - oracle->componentOffsets[c] > largest) {
+      largest = oracle->componentOffsets[c + 1] - oracle->componentOffsets[c];
+    }
+  }
+  oracle->orderOffsets[count] = next;
+  for (int k = 0; k < children; k++) {
+    oracle->childList[k] = alias[oracle->childList[k]];
+  }
+  for (int s = 0; s < oracle->slots; s++) {
+    oracle->slotChild[s] = alias[oracle->slotChild[s]];
+  }
+  for (int i = 0; i < statements; i++) {
+    oracle->roots[i] = alias[oracle->roots[i]];
+  }
+  free(alias);
+  free(emitted);
+  free(stamp);
+
+  // state and work arrays
+  int restart = (largest < GMRES_RESTART) ? largest : GMRES_RESTART;
+  oracle->polya = calloc((size_t) oracle->slots * (MAX_LEVELS + 1) + 1, sizeof(double));
+  oracle->registers = malloc((size + 1) * sizeof(Dual));
+  oracle->current = malloc((statements + 1) * sizeof(Dual));
+  oracle->y = calloc(statements + 1, sizeof(double));
+  oracle->start = calloc(statements + 1, sizeof(double));
+  oracle->series = malloc((oracle->maxLimit + TAIL_TERMS + 1) * sizeof(Dual));
+  oracle->residual = malloc(largest * sizeof(double));
+  oracle->step = malloc(largest * sizeof(double));
+  oracle->work = malloc(largest * sizeof(double));
+  oracle->basis = malloc((size_t) (restart + 1) * largest * sizeof(double));
+  oracle->hessenberg = malloc((size_t) (restart + 1) * restart * sizeof(double));
+  oracle->cosines = malloc((restart + 1) * sizeof(double));
+  oracle->sines = malloc((restart + 1) * sizeof(double));
+  oracle->rhs = malloc((restart + 1) * sizeof(double));
+  oracle->largest = largest;
+  oracle->level = 1;
+  oracle->levels = 1;
+
+  freeFlatGrammar(flat);
+  return oracle;
+}
+
+void freeOracle(Oracle* oracle)
+{
+  if (oracle == NULL) {
+    return;
+  }
+  free(oracle->program);
+  free(oracle->childList);
+  free(oracle->roots);
+  free(oracle->recursive);
+  free(oracle->componentOffsets);
+  free(oracle->componentStatements);
+  free(oracle->orderOffsets);
+  free(oracle->order);
+  free(oracle->slotChild);
+  free(oracle->polya);
+  free(oracle->registers);
+  free(oracle->current);
+  free(oracle->y);
+  free(oracle->start);
+  free(oracle->series);
+  free(oracle->residual);
+  free(oracle->step);
+  free(oracle->work);
+  free(oracle->basis);
+  free(oracle->hessenberg);
+  free(oracle->cosines);
+  free(oracle->sines);
+  free(oracle->rhs);
+  freeBatch(oracle->batch);
+  free(oracle);
+}
@@ -0,0 +1,79 @@
+#include "analysis.h"
+
+#ifndef ORACLETYPE
+#define ORACLETYPE
+/*
+  Semantics of the constructions: in labelled classes (exponential generating functions),
+  Set(A) is exp(A(z)); in unlabelled classes (ordinary generating functions), it is the
+  Pólya exponential exp(A(z) + A(z^2)/2 + ...), and similarly for PowerSet and Cycle.
+*/
+typedef enum {LABELLED, UNLABELLED} OracleType;
+
+/*
+  Generating function oracle: a grammar compiled into an evaluation program for its system
+  of equations (see compileOracle()).
+*/
+typedef struct Oracle_s Oracle;
+#endif
+
+#ifndef ORACLE_H
+#define ORACLE_H
+
+/*
+  Compiles the grammar into a program that evaluates its generating functions at a real
+  parameter: one instruction per node of its flat representation, grouped by strongly
+  connected component (see analyzeGrammar()), so that evaluation never walks the abstract
+  syntax tree nor allocates memory. Returns NULL if the grammar is an error, references an
+  undefined symbol, uses Subst (which is not supported), or restricts a cardinality beyond
+  2^20. The oracle does not depend on the grammar, and should be freed with freeOracle().
+  An oracle should not be used by several threads at once.
+*/
+Oracle* compileOracle(Grammar* grammar, OracleType type);
+
+void freeOracle(Oracle* oracle);
+
+/*
+  Evaluates the system at z: the components are solved in topological order, each with
+  Newton's method (starting from 0, the linear systems being solved by GMRES), so that the
+  result is the least solution. values[i] is set to the value of statement i. Returns 0 on
+  success, and -1 if z is not within the disc of convergence of the system (Newton's
+  iteration does not increase monotonically, or an argument of Sequence or Cycle reaches 1).
+  With UNLABELLED, Set, PowerSet and Cycle require 0 <= z < 1; terms A(z^j) below 1e-17
+  are neglected.
+*/
+int evaluateOracle(Oracle* oracle, double z, double* values);
+
+/*
+  Evaluates the system at each of the count points of z, as evaluateOracle() does, but
+  several points at a time, one per lane of a SIMD vector (see oracleLanes()): the points
+  of a group are solved together, in lockstep, so that each instruction of the program
+  runs once for all of them. values[p * S + i] is set to the value of statement i at z[p],
+  with S the number of statements, and status[p] (unless status is NULL) to 0 on success
+  or -1 if z[p] is beyond the singularity (values[p * S], ... are then meaningless).
+  Returns the number of points successfully evaluated. With two lanes (SSE2 or NEON), the
+  lockstep was measured slower than evaluating the points one at a time (0.94 times as
+  fast on tests/cographs), so the points are then evaluated one at a time, with
+  evaluateOracle().
+*/
+int evaluateOracleBatch(Oracle* oracle, const double* z, int count, double* values, int* status);
+
+/*
+  Returns the number of lanes of the SIMD vectors of evaluateOracleBatch(): 8 if the library
+  is compiled with AVX-512 (-mavx512f), 4 with AVX or AVX2, 2 with SSE2 or NEON, and 1
+  otherwise (with 2 or 1, the points are evaluated one at a time).
+*/
+int oracleLanes(void);
+
+/*
+  Returns the radius of convergence of the system (its dominant singularity), found by
+  bisection with the given relative precision, or INFINITY if the system converges up to
+  z = 2^20. The returned value is the largest z found to be within the disc of convergence.
+*/
+double oracleSingularity(Oracle* oracle, double precision);
+
+/*
+  Returns the number of statements of the grammar the oracle was compiled from.
+*/
+int oracleSize(const Oracle* oracle);
+
+#endif
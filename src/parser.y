@@ -5,17 +5,28 @@
 %{
 #include <stdio.h>
 #include <string.h>
-#include "src/absyn.h"
-
-Grammar* root; /* root of abstract syntax tree */
-NodeST* ST; /* Symbol table with allocated nodes (for cleanup on parse error) */
-int hasLexerError = 0;
-int yyerror(char *msg);
-extern int yylex();
-extern FILE* yyin;
-extern int lineNumber;
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "src/context.h"
+
+/* The lexer is a reentrant flex scanner (see lexer.l), whose state is an opaque pointer. */
+void* newFileScanner(ParseContext* ctx, FILE* file);
+void* newBufferScanner(ParseContext* ctx, const char* bytes, size_t length);
+void* newMappedScanner(ParseContext* ctx, char* base, size_t size);
+void freeScanner(void* scanner);
 %}
 
+%define api.pure full
+%parse-param {ParseContext* ctx} {void* scanner}
+%lex-param {void* scanner}
+
+%code {
+int yylex(YYSTYPE* lvalp, void* scanner);
+int yyerror(ParseContext* ctx, void* scanner, const char* msg);
+}
+
 %union 
 {
   int symbol;
@@ -59,111 +70,278 @@ extern int lineNumber;
 
 %%
 
-grammar:	   		          statement_list { $$ = newGrammar($1, NOTERROR) ; if (!hasLexerError) root = $$; }
+grammar:	   		          statement_list { $$ = newGrammar(ctx->arena, $1, NOTERROR) ; if (!ctx->hasLexerError) ctx->root = $$; }
 ;
 
-statement_list:		                  statement { $$ = newStatementList($1); }
-		 			| statement_list COMMA statement { $$ = addStatementToList($3, $1); }
+statement_list:		                  statement { $$ = newStatementList(ctx->arena, $1); }
+		 			| statement_list COMMA statement { $$ = addStatementToList(ctx->arena, $3, $1); }
 ;
 
-statement:			          ID EQ expression { $$ = newStatement($1, $3); }
-					| Z EQ expression { $$ = newStatement(newId("Z"), $3); }
+statement:			          ID EQ expression { $$ = newStatement(ctx->arena, $1, $3); }
+					| Z EQ expression { $$ = newStatement(ctx->arena, newSymbolId(ctx->arena, ctx->symbols, internSymbol(ctx->symbols, "Z", 1)), $3); }
 ;
 
-expression_list: 	                  expression { $$ = newExpressionList($1); }
-		 			| expression_list COMMA expression { $$ = addExpressionToList($3, $1); }
+expression_list: 	                  expression { $$ = newExpressionList(ctx->arena, $1); }
+		 			| expression_list COMMA expression { $$ = addExpressionToList(ctx->arena, $3, $1); }
 ;
 
-expression:	   		          EPSILON { $$ = newExpression($1, EPSILON, NONE, 0); }
-		 			| ATOM { $$ = newExpression($1, ATOM, NONE, 0); }
-		 			| Z { $$ = newExpression($1, Z, NONE, 0); }
-		 			| ID { $$ = newExpression($1, ID, NONE, 0); }
-		 			| UNION LPAR expression_list RPAR { $$ = newExpression($3, UNION, NONE, 0); }
-                                        | PROD LPAR expression_list RPAR { $$ = newExpression($3, PROD, NONE, 0); }
-		 			| SUBST LPAR expression_list RPAR { $$ = newExpression($3, SUBST, NONE, 0); }
-		 			| SET LPAR expression RPAR { $$ = newExpression($3, SET, NONE, 0); }
-                                        | SET LPAR expression COMMA CARD LEQ NUMBER RPAR { $$ = newExpression($3, SET, LESS, $7); }
-		          	        | SET LPAR expression COMMA NUMBER GEQ CARD RPAR { $$ = newExpression($3, SET, LESS, $5); }
-		 			| SET LPAR expression COMMA CARD EQ NUMBER RPAR { $$ = newExpression($3, SET, EQUAL, $7); }
-		 			| SET LPAR expression COMMA NUMBER EQ CARD RPAR { $$ = newExpression($3, SET, EQUAL, $5); }
-		 			| SET LPAR expression COMMA CARD GEQ NUMBER RPAR { $$ = newExpression($3, SET, GREATER, $7); }
-		 			| SET LPAR expression COMMA NUMBER LEQ CARD RPAR { $$ = newExpression($3, SET, GREATER, $5); }
-		 			| POWERSET LPAR expression RPAR { $$ = newExpression($3, POWERSET, NONE, 0); }
-		 			| POWERSET LPAR expression COMMA CARD LEQ NUMBER RPAR { $$ = newExpression($3, POWERSET, LESS, $7); }
-		 			| POWERSET LPAR expression COMMA NUMBER GEQ CARD RPAR { $$ = newExpression($3, POWERSET, LESS, $5); }
-		 			| POWERSET LPAR expression COMMA CARD EQ NUMBER RPAR { $$ = newExpression($3, POWERSET, EQUAL, $7); }
-		 			| POWERSET LPAR expression COMMA NUMBER EQ CARD RPAR { $$ = newExpression($3, POWERSET, EQUAL, $5); }
-		 			| POWERSET LPAR expression COMMA CARD GEQ NUMBER RPAR { $$ = newExpression($3, POWERSET, GREATER, $7); }
-		 			| POWERSET LPAR expression COMMA NUMBER LEQ CARD RPAR { $$ = newExpression($3, POWERSET, GREATER, $5); }
-		 			| SEQUENCE LPAR expression RPAR { $$ = newExpression($3, SEQUENCE, NONE, 0); }
-                 	                | SEQUENCE LPAR expression COMMA CARD LEQ NUMBER RPAR { $$ = newExpression($3, SEQUENCE, LESS, $7); }
-		 			| SEQUENCE LPAR expression COMMA NUMBER GEQ CARD RPAR { $$ = newExpression($3, SEQUENCE, LESS, $5); }
-                 	                | SEQUENCE LPAR expression COMMA CARD EQ NUMBER RPAR { $$ = newExpression($3, SEQUENCE, EQUAL, $7); }
-		 			| SEQUENCE LPAR expression COMMA NUMBER EQ CARD RPAR { $$ = newExpression($3, SEQUENCE, EQUAL, $5); }
-                 	                | SEQUENCE LPAR expression COMMA CARD GEQ NUMBER RPAR { $$ = newExpression($3, SEQUENCE, GREATER, $7); }
-		 			| SEQUENCE LPAR expression COMMA NUMBER LEQ CARD RPAR { $$ = newExpression($3, SEQUENCE, GREATER, $5); }
-                                        | CYCLE LPAR expression RPAR { $$ = newExpression($3, CYCLE, NONE, 0); }
-                 	                | CYCLE LPAR expression COMMA CARD LEQ NUMBER RPAR { $$ = newExpression($3, CYCLE, LESS, $7); }
-		 			| CYCLE LPAR expression COMMA NUMBER GEQ CARD RPAR { $$ = newExpression($3, CYCLE, LESS, $5); }
-                 	                | CYCLE LPAR expression COMMA CARD EQ NUMBER RPAR { $$ = newExpression($3, CYCLE, EQUAL, $7); }
-		 			| CYCLE LPAR expression COMMA NUMBER EQ CARD RPAR { $$ = newExpression($3, CYCLE, EQUAL, $5); }
-                 	                | CYCLE LPAR expression COMMA CARD GEQ NUMBER RPAR { $$ = newExpression($3, CYCLE, GREATER, $7); }
-		 			| CYCLE LPAR expression COMMA NUMBER LEQ CARD RPAR { $$ = newExpression($3, CYCLE, GREATER, $5); }
+expression:	   		          EPSILON { $$ = newExpression(ctx->arena, $1, EPSILON, NONE, 0); }
+		 			| ATOM { $$ = newExpression(ctx->arena, $1, ATOM, NONE, 0); }
+		 			| Z { $$ = newExpression(ctx->arena, $1, Z, NONE, 0); }
+		 			| ID { $$ = newExpression(ctx->arena, $1, ID, NONE, 0); }
+		 			| UNION LPAR expression_list RPAR { $$ = newExpression(ctx->arena, $3, UNION, NONE, 0); }
+                                        | PROD LPAR expression_list RPAR { $$ = newExpression(ctx->arena, $3, PROD, NONE, 0); }
+		 			| SUBST LPAR expression_list RPAR { $$ = newExpression(ctx->arena, $3, SUBST, NONE, 0); }
+		 			| SET LPAR expression RPAR { $$ = newExpression(ctx->arena, $3, SET, NONE, 0); }
+                                        | SET LPAR expression COMMA CARD LEQ NUMBER RPAR { $$ = newExpression(ctx->arena, $3, SET, LESS, $7); }
+		          	        | SET LPAR expression COMMA NUMBER GEQ CARD RPAR { $$ = newExpression(ctx->arena, $3, SET, LESS, $5); }
+		 			| SET LPAR expression COMMA CARD EQ NUMBER RPAR { $$ = newExpression(ctx->arena, $3, SET, EQUAL, $7); }
+		 			| SET LPAR expression COMMA NUMBER EQ CARD RPAR { $$ = newExpression(ctx->arena, $3, SET, EQUAL, $5); }
+		 			| SET LPAR expression COMMA CARD GEQ NUMBER RPAR { $$ = newExpression(ctx->arena, $3, SET, GREATER, $7); }
+		 			| SET LPAR expression COMMA NUMBER LEQ CARD RPAR { $$ = newExpression(ctx->arena, $3, SET, GREATER, $5); }
+		 			| POWERSET LPAR expression RPAR { $$ = newExpression(ctx->arena, $3, POWERSET, NONE, 0); }
+		 			| POWERSET LPAR expression COMMA CARD LEQ NUMBER RPAR { $$ = newExpression(ctx->arena, $3, POWERSET, LESS, $7); }
+		 			| POWERSET LPAR expression COMMA NUMBER GEQ CARD RPAR { $$ = newExpression(ctx->arena, $3, POWERSET, LESS, $5); }
+		 			| POWERSET LPAR expression COMMA CARD EQ NUMBER RPAR { $$ = newExpression(ctx->arena, $3, POWERSET, EQUAL, $7); }
+		 			| POWERSET LPAR expression COMMA NUMBER EQ CARD RPAR { $$ = newExpression(ctx->arena, $3, POWERSET, EQUAL, $5); }
+		 			| POWERSET LPAR expression COMMA CARD GEQ NUMBER RPAR { $$ = newExpression(ctx->arena, $3, POWERSET, GREATER, $7); }
+		 			| POWERSET LPAR expression COMMA NUMBER LEQ CARD RPAR { $$ = newExpression(ctx->arena, $3, POWERSET, GREATER, $5); }
+		 			| SEQUENCE LPAR expression RPAR { $$ = newExpression(ctx->arena, $3, SEQUENCE, NONE, 0); }
+                 	                | SEQUENCE LPAR expression COMMA CARD LEQ NUMBER RPAR { $$ = newExpression(ctx->arena, $3, SEQUENCE, LESS, $7); }
+		 			| SEQUENCE LPAR expression COMMA NUMBER GEQ CARD RPAR { $$ = newExpression(ctx->arena, $3, SEQUENCE, LESS, $5); }
+                 	                | SEQUENCE LPAR expression COMMA CARD EQ NUMBER RPAR { $$ = newExpression(ctx->arena, $3, SEQUENCE, EQUAL, $7); }
+		 			| SEQUENCE LPAR expression COMMA NUMBER EQ CARD RPAR { $$ = newExpression(ctx->arena, $3, SEQUENCE, EQUAL, $5); }
+                 	                | SEQUENCE LPAR expression COMMA CARD GEQ NUMBER RPAR { $$ = newExpression(ctx->arena, $3, SEQUENCE, GREATER, $7); }
+		 			| SEQUENCE LPAR expression COMMA NUMBER LEQ CARD RPAR { $$ = newExpression(ctx->arena, $3, SEQUENCE, GREATER, $5); }
+                                        | CYCLE LPAR expression RPAR { $$ = newExpression(ctx->arena, $3, CYCLE, NONE, 0); }
+                 	                | CYCLE LPAR expression COMMA CARD LEQ NUMBER RPAR { $$ = newExpression(ctx->arena, $3, CYCLE, LESS, $7); }
+		 			| CYCLE LPAR expression COMMA NUMBER GEQ CARD RPAR { $$ = newExpression(ctx->arena, $3, CYCLE, LESS, $5); }
+                 	                | CYCLE LPAR expression COMMA CARD EQ NUMBER RPAR { $$ = newExpression(ctx->arena, $3, CYCLE, EQUAL, $7); }
+		 			| CYCLE LPAR expression COMMA NUMBER EQ CARD RPAR { $$ = newExpression(ctx->arena, $3, CYCLE, EQUAL, $5); }
+                 	                | CYCLE LPAR expression COMMA CARD GEQ NUMBER RPAR { $$ = newExpression(ctx->arena, $3, CYCLE, GREATER, $7); }
+		 			| CYCLE LPAR expression COMMA NUMBER LEQ CARD RPAR { $$ = newExpression(ctx->arena, $3, CYCLE, GREATER, $5); }
 ;
 
 
 %%
 
-int reportError(Error* error)
+int reportError(ParseContext* ctx, Error* error)
 {
   if (error->type == LEXER) {
-    hasLexerError = 1;
+    ctx->hasLexerError = 1;
   }
-  root = newGrammar(error, ISERROR);
+  ctx->root = newGrammar(ctx->arena, error, ISERROR);
   char* str = error->toString(error);
   int result = fprintf(stderr, "%s\n", str);
   free(str);
   return result;
 }
 
-int yyerror(char *msg)
+int yyerror(ParseContext* ctx, void* scanner, const char* msg)
 {
-  return reportError(newError(lineNumber, msg, PARSER));
+  (void) scanner; // required by the signature of a pure parser, but not needed here
+  return reportError(ctx, newError(ctx->arena, ctx->lineNumber, (char*) msg, PARSER));
 }
 
-Grammar* readGrammar(char* filename)
+/*
+  Helper function that resets the context before a run of the parser.
+*/
+static void initParseContext(ParseContext* ctx)
+{
+  ctx->root = NULL;
+  ctx->arena = newArena();
+  ctx->symbols = newSymbolTable(ctx->arena, 1);
+  ctx->hasLexerError = 0;
+  ctx->lineNumber = 1;
+  ctx->commentLevel = 0;
+  ctx->input = NULL;
+  ctx->inputSize = 0;
+}
+
+/*
+  Helper function that replaces the root of the context by an error grammar, after
+  freeing all the nodes that have been allocated so far.
+*/
+static Grammar* failParse(ParseContext* ctx, int line, char* message, ErrorType type)
+{
+  freeArena(ctx->arena);
+  ctx->arena = newArena();
+  ctx->symbols = newSymbolTable(ctx->arena, 1);
+  ctx->root = newGrammar(ctx->arena, newError(ctx->arena, line, message, type), ISERROR);
+  return ctx->root;
+}
+
+/*
+  Helper function that runs the parser on an initialized context and scanner (which is freed).
+*/
+static Grammar* parse(ParseContext* ctx, void* scanner)
 {
-  ST = newNodeST();
-  yyin = fopen(filename, "r");
-  yyparse();
-  fclose(yyin);
+  yyparse(ctx, scanner);
+  freeScanner(scanner);
 
-  if (root->type == ISERROR) { // we need to clean up
+  if (ctx->root->type == ISERROR) { // we need to clean up
   	// copy error info
-  	Error* error = (Error*) root->component;
+  	Error* error = (Error*) ctx->root->component;
   	int line = error->line;
   	ErrorType type = error->type;
   	char* str = (char*) malloc(sizeof(char) * (strlen(error->message) + 1));
   	sprintf(str, "%s", error->message);
 
-  	// free all nodes (including root) and their contents, and remove them from ST
-  	cleanup(ST);
+  	// free all nodes (including root) and their contents at once, and set root to error
+  	failParse(ctx, line, str, type);
+  	free(str);
+  } else {
+    ctx->root->symbols = ctx->symbols;
+  }
+
+  return ctx->root;
+}
+
+Grammar* readGrammarCtx(ParseContext* ctx, char* filename)
+{
+  initParseContext(ctx);
+
+  FILE* file = fopen(filename, "r");
+  if (file == NULL) {
+    return failParse(ctx, 0, "could not open file", INPUT);
+  }
+
+  parse(ctx, newFileScanner(ctx, file));
+  fclose(file);
+  return ctx->root;
+}
+
+Grammar* readGrammarFromBufferCtx(ParseContext* ctx, const char* buffer, size_t length)
+{
+  initParseContext(ctx);
+  return parse(ctx, newBufferScanner(ctx, buffer, length));
+}
+
+Grammar* readStatementsCtx(ParseContext* ctx, const char* buffer, size_t length, int line)
+{
+  ctx->root = NULL;
+  ctx->hasLexerError = 0;
+  ctx->lineNumber = line;
+  ctx->commentLevel = 0;
+  ctx->input = NULL;
+  ctx->inputSize = 0;
+
+  void* scanner = newBufferScanner(ctx, buffer, length);
+  yyparse(ctx, scanner);
+  freeScanner(scanner);
+
+  if (ctx->root->type == NOTERROR) {
+    ctx->root->symbols = ctx->symbols;
+  }
+  return ctx->root;
+}
+
+Grammar* readGrammarFromFdCtx(ParseContext* ctx, int fd)
+{
+  initParseContext(ctx);
+
+  // read through a duplicate, so that closing the stream leaves the caller's descriptor open
+  int copy = dup(fd);
+  FILE* file = (copy < 0) ? NULL : fdopen(copy, "r");
+  if (file == NULL) {
+    if (copy >= 0) {
+      close(copy);
+    }
+    return failParse(ctx, 0, "could not read file descriptor", INPUT);
+  }
+
+  parse(ctx, newFileScanner(ctx, file));
+  fclose(file);
+  return ctx->root;
+}
+
+/*
+  Helper function that maps size bytes of the file, followed by the two NULL characters
+  that the lexer needs to scan the mapping in place. The mapping is private and writable,
+  so that modifications (by the lexer, and terminateIds()) never reach the file.
+*/
+static char* mapInput(int fd, size_t size, size_t* mappedSize)
+{
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t total = (size + 2 + page - 1) / page * page;
 
-	// set root to error
-  	root = newGrammar(newError(line, str, type), ISERROR);
+  // reserve zero-filled pages, then map the file over the beginning (bytes past the end
+  // of the file in its last page read as zero, so the sentinels are always there)
+  char* base = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    return NULL;
   }
+  if (size > 0 && mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+    munmap(base, total);
+    return NULL;
+  }
+  madvise(base, total, MADV_SEQUENTIAL);
+
+  *mappedSize = total;
+  return base;
+}
 
-  // free ST (but not abstract syntax tree nodes) since it is not needed anymore
-  free(ST);
+Grammar* readGrammarMappedCtx(ParseContext* ctx, char* filename)
+{
+  struct stat st;
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) { // let the stream reader deal with it
+    if (fd >= 0) {
+      close(fd);
+    }
+    return readGrammarCtx(ctx, filename);
+  }
 
-  return root;
+  size_t mappedSize;
+  char* input = mapInput(fd, st.st_size, &mappedSize);
+  close(fd); // the mapping stays valid
+  if (input == NULL) {
+    return readGrammarCtx(ctx, filename);
+  }
+
+  initParseContext(ctx);
+  ctx->input = input;
+  ctx->inputSize = mappedSize;
+  ctx->symbols->copyNames = 0; // names are views into the mapping
+  void* scanner = newMappedScanner(ctx, ctx->input, st.st_size + 2);
+  if (scanner == NULL) {
+    failParse(ctx, 0, "could not scan mapped file", INPUT);
+  } else {
+    parse(ctx, scanner);
+  }
+
+  if (ctx->root->type == ISERROR) { // error message has been copied, nothing points into the input
+    munmap(ctx->input, ctx->inputSize);
+  } else {
+    terminateSymbols(ctx->symbols); // every Id shares the name of its symbol
+    ctx->root->input = ctx->input; // the grammar now owns the mapping
+    ctx->root->inputSize = ctx->inputSize;
+  }
+  ctx->input = NULL;
+
+  return ctx->root;
+}
+
+Grammar* readGrammar(char* filename)
+{
+  ParseContext ctx;
+  return readGrammarCtx(&ctx, filename);
+}
+
+Grammar* readGrammarFromBuffer(const char* buffer, size_t length)
+{
+  ParseContext ctx;
+  return readGrammarFromBufferCtx(&ctx, buffer, length);
+}
+
+Grammar* readGrammarFromFd(int fd)
+{
+  ParseContext ctx;
+  return readGrammarFromFdCtx(&ctx, fd);
 }
 
-#ifndef _COMPILE_LIB
-int main(int argc, char* argv[])
+Grammar* readGrammarMapped(char* filename)
 {
-  readGrammar(argv[1]);
-  
-  printf("%s\n", root->toJson(root));
+  ParseContext ctx;
+  return readGrammarMappedCtx(&ctx, filename);
 }
-#endif
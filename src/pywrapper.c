@@ -1,83 +1,863 @@
+#define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <stdlib.h>
 #include "../combstruct2json.h"
 
 /*****************************************
  Adapted from:
  https://dfm.io/posts/python-c-extensions/
+ and PEP 489 (multi-phase initialization).
  *****************************************/
 
-/* Exception */
-static PyObject *Combstruct2JsonError;
+/*
+  State of one instance of the module: its exception, and the strings used as keys and
+  values of the dictionaries, which are created once (see module_exec()).
+*/
+typedef struct {
+    PyObject *error;
+    PyObject *str_type, *str_unit, *str_id, *str_op, *str_param, *str_restriction;
+    PyObject *str_error, *str_source, *str_line, *str_msg;
+    PyObject *str_atom, *str_epsilon, *str_z;
+    PyObject *str_union, *str_prod, *str_subst, *str_set, *str_powerset, *str_sequence, *str_cycle;
+    PyObject *str_lexer, *str_parser, *str_input;
+    PyObject *flat_type, *array_type;
+} ModuleState;
+
+/* The fields of ModuleState, as an array (for initialization and garbage collection). */
+#define STATE_FIELDS(st) ((PyObject **) (st))
+#define STATE_SIZE (sizeof(ModuleState) / sizeof(PyObject *))
 
 /* Docstrings */
 static char module_docstring[] =
-    "This module provides an interface for parsing combstruct grammars.";
+    "This module provides an interface for parsing combstruct grammars.\n\n"
+    "A grammar that cannot be parsed (or read) gives the dictionary of its error,\n"
+    "{'type': 'error', 'source': ..., 'line': ..., 'msg': ...}, whatever the function.\n\n"
+    "The global interpreter lock is released while grammars are parsed, so that\n"
+    "several grammars can be parsed at once from different threads.";
 static char read_file_docstring[] =
-    "Parse the combstruct grammar file and return JSON string.";
+    "Parse the combstruct grammar file and return its JSON representation, as a dict.";
+static char loads_docstring[] =
+    "Parse the combstruct grammar given as a string and return its JSON representation, as a dict.";
+static char read_flat_docstring[] =
+    "Parse the combstruct grammar file and return its flat representation, as a FlatGrammar.";
+static char loads_flat_docstring[] =
+    "Parse the combstruct grammar given as a string and return its flat representation, as a FlatGrammar.";
+static char analyze_file_docstring[] =
+    "Parse and analyze the combstruct grammar file: return its strongly connected components\n"
+    "(in topological order), its unproductive and nullable symbols, and whether it is well-founded.";
+static char analyze_string_docstring[] =
+    "Parse and analyze the combstruct grammar given as a string (see analyze_file).";
+static char read_binary_docstring[] =
+    "Map the binary grammar file (see --write-binary) and return it as a FlatGrammar, whose arrays\n"
+    "point into the mapping. If verify is true, the checksum of the file is checked.";
 
 /* Available functions */
 static PyObject *combstruct2json_read_file(PyObject *self, PyObject *args);
+static PyObject *combstruct2json_loads(PyObject *self, PyObject *args);
+static PyObject *combstruct2json_read_flat(PyObject *self, PyObject *args);
+static PyObject *combstruct2json_loads_flat(PyObject *self, PyObject *args);
+static PyObject *combstruct2json_read_binary(PyObject *self, PyObject *args);
+static PyObject *combstruct2json_analyze_file(PyObject *self, PyObject *args);
+static PyObject *combstruct2json_analyze_string(PyObject *self, PyObject *args);
 
 /* Module specification */
+static int module_exec(PyObject *m);
+static int module_traverse(PyObject *m, visitproc visit, void *arg);
+static int module_clear(PyObject *m);
+static void module_free(void *m);
+static PyType_Spec flatgrammar_spec, flatarray_spec;
+static int flatarray_getbuffer(PyObject *obj, Py_buffer *view, int flags);
+
 static PyMethodDef module_methods[] = {
     {"read_file", combstruct2json_read_file, METH_VARARGS, read_file_docstring},
+    {"loads", combstruct2json_loads, METH_VARARGS, loads_docstring},
+    {"read_flat", combstruct2json_read_flat, METH_VARARGS, read_flat_docstring},
+    {"loads_flat", combstruct2json_loads_flat, METH_VARARGS, loads_flat_docstring},
+    {"read_binary", combstruct2json_read_binary, METH_VARARGS, read_binary_docstring},
+    {"analyze_file", combstruct2json_analyze_file, METH_VARARGS, analyze_file_docstring},
+    {"analyze_string", combstruct2json_analyze_string, METH_VARARGS, analyze_string_docstring},
     {NULL, NULL, 0, NULL}
 };
 
-/* Initialize the module */
-void initcombstruct2json(void)
+static PyModuleDef_Slot module_slots[] = {
+    {Py_mod_exec, module_exec},
+    {0, NULL}
+};
+
+static struct PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT,
+    "combstruct2json",
+    module_docstring,
+    sizeof(ModuleState),
+    module_methods,
+    module_slots,
+    module_traverse,
+    module_clear,
+    module_free
+};
+
+/* Initialize the module (the module object itself is created by the interpreter) */
+PyMODINIT_FUNC PyInit_combstruct2json(void)
+{
+    return PyModuleDef_Init(&module_def);
+}
+
+static int module_exec(PyObject *m)
 {
-    PyObject *m = Py_InitModule3("combstruct2json", module_methods, module_docstring);
-    if (m == NULL)
-        return;
-    
+    ModuleState *st = (ModuleState *) PyModule_GetState(m);
+    struct { PyObject **var; const char *text; } strings[] = {
+        {&st->str_type, "type"}, {&st->str_unit, "unit"}, {&st->str_id, "id"}, {&st->str_op, "op"},
+        {&st->str_param, "param"}, {&st->str_restriction, "restriction"},
+        {&st->str_error, "error"}, {&st->str_source, "source"}, {&st->str_line, "line"}, {&st->str_msg, "msg"},
+        {&st->str_atom, "Atom"}, {&st->str_epsilon, "Epsilon"}, {&st->str_z, "Z"},
+        {&st->str_union, "Union"}, {&st->str_prod, "Prod"}, {&st->str_subst, "Subst"}, {&st->str_set, "Set"},
+        {&st->str_powerset, "PowerSet"}, {&st->str_sequence, "Sequence"}, {&st->str_cycle, "Cycle"},
+        {&st->str_lexer, "lexer"}, {&st->str_parser, "parser"}, {&st->str_input, "input"}
+    };
+
+    // Creating the strings used to build dictionaries
+    for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++) {
+        *strings[i].var = PyUnicode_InternFromString(strings[i].text);
+        if (*strings[i].var == NULL)
+            return -1;
+    }
+
     // Initializing our custom exception
-    Combstruct2JsonError = PyErr_NewException("combstruct2json.error", NULL, NULL);
-    Py_INCREF(Combstruct2JsonError);
-    PyModule_AddObject(m, "error", Combstruct2JsonError);
+    st->error = PyErr_NewException("combstruct2json.error", NULL, NULL);
+    if (st->error == NULL)
+        return -1;
+    Py_INCREF(st->error);
+    if (PyModule_AddObject(m, "error", st->error) < 0) {
+        Py_DECREF(st->error);
+        return -1;
+    }
+
+    // Creating the types of flat grammars (which can only be obtained from the functions of the module)
+    st->flat_type = PyType_FromSpec(&flatgrammar_spec);
+    st->array_type = PyType_FromSpec(&flatarray_spec);
+    if (st->flat_type == NULL || st->array_type == NULL)
+        return -1;
+    ((PyTypeObject *) st->flat_type)->tp_new = NULL;
+    ((PyTypeObject *) st->array_type)->tp_new = NULL;
+    ((PyTypeObject *) st->array_type)->tp_as_buffer->bf_getbuffer = flatarray_getbuffer; // no slot before Python 3.9
+    Py_INCREF(st->flat_type);
+    if (PyModule_AddObject(m, "FlatGrammar", st->flat_type) < 0) {
+        Py_DECREF(st->flat_type);
+        return -1;
+    }
+
+    // Constants of the arrays of flat grammars
+    struct { const char *name; long value; } constants[] = {
+        {"FLAT_EPSILON", FLAT_EPSILON}, {"FLAT_ATOM", FLAT_ATOM}, {"FLAT_Z", FLAT_Z}, {"FLAT_ID", FLAT_ID},
+        {"FLAT_UNION", FLAT_UNION}, {"FLAT_PROD", FLAT_PROD}, {"FLAT_SUBST", FLAT_SUBST}, {"FLAT_SET", FLAT_SET},
+        {"FLAT_POWERSET", FLAT_POWERSET}, {"FLAT_SEQUENCE", FLAT_SEQUENCE}, {"FLAT_CYCLE", FLAT_CYCLE},
+        {"RESTRICTION_NONE", NONE}, {"RESTRICTION_LESS", LESS}, {"RESTRICTION_EQUAL", EQUAL},
+        {"RESTRICTION_GREATER", GREATER}
+    };
+    for (size_t i = 0; i < sizeof(constants) / sizeof(constants[0]); i++) {
+        if (PyModule_AddIntConstant(m, constants[i].name, constants[i].value) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int module_traverse(PyObject *m, visitproc visit, void *arg)
+{
+    ModuleState *st = (ModuleState *) PyModule_GetState(m);
+    for (size_t i = 0; st != NULL && i < STATE_SIZE; i++)
+        Py_VISIT(STATE_FIELDS(st)[i]);
+    return 0;
+}
+
+static int module_clear(PyObject *m)
+{
+    ModuleState *st = (ModuleState *) PyModule_GetState(m);
+    for (size_t i = 0; st != NULL && i < STATE_SIZE; i++)
+        Py_CLEAR(STATE_FIELDS(st)[i]);
+    return 0;
+}
+
+static void module_free(void *m)
+{
+    module_clear((PyObject *) m);
+}
+
+/* Build a dictionary { "type": type, key: value } (steals no reference). */
+static PyObject *new_node(const ModuleState *st, PyObject *type, PyObject *key, PyObject *value)
+{
+    PyObject *node = PyDict_New();
+    if (node == NULL)
+        return NULL;
+    if (PyDict_SetItem(node, st->str_type, type) < 0 || PyDict_SetItem(node, key, value) < 0) {
+        Py_DECREF(node);
+        return NULL;
+    }
+    return node;
 }
 
+/*
+  Convert an expression to the dictionary of the Json specification. The names of the
+  symbols are created once per grammar (names[s] is the name of symbol s).
+*/
+static PyObject *expression_to_python(const ModuleState *st, const Expression *E, PyObject **names)
+{
+    PyObject *op, *param, *node;
+
+    switch (E->type) {
+    case ATOM:
+        return new_node(st, st->str_unit, st->str_unit, st->str_atom);
+    case EPSILON:
+        return new_node(st, st->str_unit, st->str_unit, st->str_epsilon);
+    case Z:
+        return new_node(st, st->str_id, st->str_id, st->str_z);
+    case ID:
+        return new_node(st, st->str_id, st->str_id, names[((Id *) E->component)->symbol]);
+    case UNION:    op = st->str_union;    break;
+    case PROD:     op = st->str_prod;     break;
+    case SUBST:    op = st->str_subst;    break;
+    case SET:      op = st->str_set;      break;
+    case POWERSET: op = st->str_powerset; break;
+    case SEQUENCE: op = st->str_sequence; break;
+    case CYCLE:    op = st->str_cycle;    break;
+    default:
+        PyErr_SetString(st->error, "Token is not an expression.");
+        return NULL;
+    }
+
+    /* Parameters: a list of expressions, or a single expression for restricted constructors. */
+    if (E->type == UNION || E->type == PROD || E->type == SUBST) {
+        const ExpressionList *Elist = (ExpressionList *) E->component;
+        param = PyList_New(Elist->size);
+        if (param == NULL)
+            return NULL;
+        for (int i = 0; i < Elist->size; i++) {
+            PyObject *sub = expression_to_python(st, Elist->components[i], names);
+            if (sub == NULL) {
+                Py_DECREF(param);
+                return NULL;
+            }
+            PyList_SET_ITEM(param, i, sub); /* steals the reference */
+        }
+    } else {
+        PyObject *sub = expression_to_python(st, (Expression *) E->component, names);
+        if (sub == NULL)
+            return NULL;
+        param = PyList_New(1);
+        if (param == NULL) {
+            Py_DECREF(sub);
+            return NULL;
+        }
+        PyList_SET_ITEM(param, 0, sub);
+    }
+
+    node = new_node(st, st->str_op, st->str_op, op);
+    if (node == NULL || PyDict_SetItem(node, st->str_param, param) < 0) {
+        Py_XDECREF(node);
+        Py_DECREF(param);
+        return NULL;
+    }
+    Py_DECREF(param);
+
+    if (E->restriction != NONE) {
+        const char *format = (E->restriction == LESS) ? "card <= %lld"
+                           : (E->restriction == EQUAL) ? "card = %lld" : "card >= %lld";
+        PyObject *restriction = PyUnicode_FromFormat(format, E->limit);
+        if (restriction == NULL || PyDict_SetItem(node, st->str_restriction, restriction) < 0) {
+            Py_XDECREF(restriction);
+            Py_DECREF(node);
+            return NULL;
+        }
+        Py_DECREF(restriction);
+    }
+    return node;
+}
+
+/* Convert an error to the dictionary of the Json specification. */
+static PyObject *error_to_python(const ModuleState *st, const Error *error)
+{
+    PyObject *source = (error->type == LEXER) ? st->str_lexer : (error->type == INPUT) ? st->str_input : st->str_parser;
+    PyObject *node = new_node(st, st->str_error, st->str_source, source);
+    PyObject *line = PyLong_FromLong(error->line);
+    PyObject *msg = PyUnicode_FromString(error->message);
+
+    if (node == NULL || line == NULL || msg == NULL
+        || PyDict_SetItem(node, st->str_line, line) < 0 || PyDict_SetItem(node, st->str_msg, msg) < 0) {
+        Py_XDECREF(node);
+        node = NULL;
+    }
+    Py_XDECREF(line);
+    Py_XDECREF(msg);
+    return node;
+}
+
+/*
+  Convert a parsed grammar to a dictionary (the grammar is freed). The dictionary is built
+  directly from the abstract syntax tree, with the same shape as the Json representation.
+*/
+static PyObject *grammar_to_python(const ModuleState *st, Grammar *root)
+{
+    PyObject *result = NULL;
+
+    if (root == NULL) {
+        PyErr_SetString(st->error, "Parsing grammar failed for unknown reasons.");
+        return NULL;
+    }
+
+    if (root->type == ISERROR) {
+        result = error_to_python(st, (Error *) root->component);
+        freeGrammar(root);
+        return result;
+    }
+
+    /* One string per symbol, shared by every reference to it. */
+    const SymbolTable *symbols = root->symbols;
+    const StatementList *Slist = (StatementList *) root->component;
+    PyObject **names = (PyObject **) calloc(symbols->size + 1, sizeof(PyObject *));
+    int i;
+
+    if (names == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (i = 0; i < symbols->size; i++) {
+        names[i] = PyUnicode_FromStringAndSize(symbols->names[i], symbols->lengths[i]);
+        if (names[i] == NULL)
+            goto done;
+    }
+
+    result = PyDict_New();
+    if (result == NULL)
+        goto done;
+    for (i = 0; i < Slist->size; i++) {
+        const Statement *S = Slist->components[i];
+        PyObject *expression = expression_to_python(st, S->expression, names);
+        if (expression == NULL || PyDict_SetItem(result, names[S->variable->symbol], expression) < 0) {
+            Py_XDECREF(expression);
+            Py_CLEAR(result);
+            goto done;
+        }
+        Py_DECREF(expression);
+    }
+
+done:
+    if (names != NULL) {
+        for (i = 0; i < symbols->size; i++)
+            Py_XDECREF(names[i]);
+        free(names);
+    }
+    freeGrammar(root);
+    return result;
+}
+
+/*
+  The parser is reentrant (each call has its own ParseContext) and does not touch any
+  Python object, so the global interpreter lock is released while it runs.
+*/
 static PyObject *combstruct2json_read_file(PyObject *self, PyObject *args)
 {
-    char *arg_filename;
+    ModuleState *st = (ModuleState *) PyModule_GetState(self);
+    PyObject *arg_filename;
+    ParseContext ctx;
+    Grammar *root;
 
-    /* Parse the input tuple */
-    if (!PyArg_ParseTuple(args, "s", &arg_filename)) {
-        PyErr_SetString(Combstruct2JsonError, "Parsing filename for `read_file' failed.");
+    /* Parse the input tuple (the path may be str, bytes or os.PathLike) */
+    if (!PyArg_ParseTuple(args, "O&", PyUnicode_FSConverter, &arg_filename)) {
         return NULL;
     }
 
     /* Call the external C function to parse the grammar. */
-    Grammar* root = readGrammar(arg_filename);
+    Py_BEGIN_ALLOW_THREADS
+    root = readGrammarCtx(&ctx, PyBytes_AS_STRING(arg_filename));
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(arg_filename);
+    return grammar_to_python(st, root);
+}
+
+static PyObject *combstruct2json_loads(PyObject *self, PyObject *args)
+{
+    ModuleState *st = (ModuleState *) PyModule_GetState(self);
+    Py_buffer arg_grammar;
+    ParseContext ctx;
+    Grammar *root;
+
+    /* Parse the input tuple (str, or any bytes-like object) */
+    if (!PyArg_ParseTuple(args, "s*", &arg_grammar)) {
+        return NULL;
+    }
+
+    /* Call the external C function to parse the grammar, directly from memory. */
+    Py_BEGIN_ALLOW_THREADS
+    root = readGrammarFromBufferCtx(&ctx, (const char *) arg_grammar.buf, (size_t) arg_grammar.len);
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&arg_grammar);
+    return grammar_to_python(st, root);
+}
+
+/********************************** Flat grammars **********************************/
+
+/*
+  A flat grammar (see flat.h), whose arrays are exported through the buffer protocol as
+  FlatArray objects, so that NumPy (or memoryview) can wrap them without any copy. The
+  fields of the nodes are exported as strided arrays into the array of nodes.
+*/
+typedef struct {
+    PyObject_HEAD
+    FlatGrammar *flat;
+    PyObject *symbols; /* tuple of the names of the symbols */
+    PyObject *array_type; /* type of the arrays, see flatarray_spec */
+} FlatGrammarObject;
+
+/*
+  One-dimensional, read-only view of length elements of an array owned by a FlatGrammar,
+  stride bytes apart.
+*/
+typedef struct {
+    PyObject_HEAD
+    PyObject *owner; /* FlatGrammar that the data belongs to */
+    char *data;
+    const char *format; /* struct module syntax */
+    Py_ssize_t itemsize;
+    Py_ssize_t shape[1];
+    Py_ssize_t strides[1];
+} FlatArrayObject;
+
+static int flatarray_getbuffer(PyObject *obj, Py_buffer *view, int flags)
+{
+    FlatArrayObject *self = (FlatArrayObject *) obj;
+
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "flat grammar arrays are read-only");
+        return -1;
+    }
+    if (!(flags & PyBUF_STRIDES) && self->strides[0] != self->itemsize) {
+        PyErr_SetString(PyExc_BufferError, "array is not contiguous (request a strided buffer)");
+        return -1;
+    }
+
+    view->buf = self->data;
+    view->obj = obj;
+    Py_INCREF(obj);
+    view->len = self->shape[0] * self->itemsize;
+    view->itemsize = self->itemsize;
+    view->readonly = 1;
+    view->ndim = 1;
+    view->format = (flags & PyBUF_FORMAT) ? (char *) self->format : NULL;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static Py_ssize_t flatarray_length(PyObject *obj)
+{
+    return ((FlatArrayObject *) obj)->shape[0];
+}
+
+static int flatarray_traverse(PyObject *obj, visitproc visit, void *arg)
+{
+    Py_VISIT(((FlatArrayObject *) obj)->owner);
+    return 0;
+}
+
+static void flatarray_dealloc(PyObject *obj)
+{
+    PyTypeObject *type = Py_TYPE(obj);
+    PyObject_GC_UnTrack(obj);
+    Py_CLEAR(((FlatArrayObject *) obj)->owner);
+    type->tp_free(obj);
+    Py_DECREF(type);
+}
+
+static PyType_Slot flatarray_slots[] = {
+    {Py_sq_length, flatarray_length},
+    {Py_tp_traverse, flatarray_traverse},
+    {Py_tp_dealloc, flatarray_dealloc},
+    {Py_tp_doc, "Read-only array of a flat grammar, to be wrapped with memoryview() or numpy.asarray()."},
+    {0, NULL}
+};
+
+static PyType_Spec flatarray_spec = {
+    "combstruct2json.FlatArray",
+    sizeof(FlatArrayObject),
+    0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    flatarray_slots
+};
+
+/* Helper function that returns a view of count elements, stride bytes apart, from data. */
+static PyObject *new_flatarray(FlatGrammarObject *owner, void *data, Py_ssize_t count, const char *format, Py_ssize_t itemsize, Py_ssize_t stride)
+{
+    PyTypeObject *type = (PyTypeObject *) owner->array_type;
+    FlatArrayObject *array = (FlatArrayObject *) type->tp_alloc(type, 0);
+    if (array == NULL)
+        return NULL;
+
+    Py_INCREF(owner);
+    array->owner = (PyObject *) owner;
+    array->data = (char *) data;
+    array->format = format;
+    array->itemsize = itemsize;
+    array->shape[0] = count;
+    array->strides[0] = stride;
+    return (PyObject *) array;
+}
+
+/* Fields of the nodes */
+#define NODE_FIELD(self, field, format) \
+    new_flatarray((self), &(self)->flat->nodes[0].field, (self)->flat->size, (format), \
+                  sizeof((self)->flat->nodes[0].field), sizeof(FlatNode))
+
+static PyObject *flatgrammar_ops(PyObject *self, void *closure)
+{
+    (void) closure;
+    return NODE_FIELD((FlatGrammarObject *) self, op, "B");
+}
+
+static PyObject *flatgrammar_restrictions(PyObject *self, void *closure)
+{
+    (void) closure;
+    return NODE_FIELD((FlatGrammarObject *) self, restriction, "B");
+}
+
+static PyObject *flatgrammar_values(PyObject *self, void *closure)
+{
+    (void) closure;
+    return NODE_FIELD((FlatGrammarObject *) self, value, "i");
+}
+
+static PyObject *flatgrammar_children(PyObject *self, void *closure)
+{
+    (void) closure;
+    return NODE_FIELD((FlatGrammarObject *) self, children, "i");
+}
+
+static PyObject *flatgrammar_spans(PyObject *self, void *closure)
+{
+    (void) closure;
+    return NODE_FIELD((FlatGrammarObject *) self, span, "i");
+}
+
+/* Other arrays */
+static PyObject *flatgrammar_limits(PyObject *self, void *closure)
+{
+    (void) closure;
+    FlatGrammarObject *g = (FlatGrammarObject *) self;
+    return new_flatarray(g, g->flat->limits, g->flat->limitCount, "q", sizeof(long long int), sizeof(long long int));
+}
+
+static PyObject *flatgrammar_roots(PyObject *self, void *closure)
+{
+    (void) closure;
+    FlatGrammarObject *g = (FlatGrammarObject *) self;
+    return new_flatarray(g, g->flat->roots, g->flat->statements, "i", sizeof(int), sizeof(int));
+}
+
+static PyObject *flatgrammar_variables(PyObject *self, void *closure)
+{
+    (void) closure;
+    FlatGrammarObject *g = (FlatGrammarObject *) self;
+    return new_flatarray(g, g->flat->variables, g->flat->statements, "i", sizeof(int), sizeof(int));
+}
+
+static PyObject *flatgrammar_symbols(PyObject *self, void *closure)
+{
+    (void) closure;
+    FlatGrammarObject *g = (FlatGrammarObject *) self;
+    Py_INCREF(g->symbols);
+    return g->symbols;
+}
+
+static PyGetSetDef flatgrammar_getset[] = {
+    {"ops", flatgrammar_ops, NULL, "Operation of each node (uint8, FLAT_* constants).", NULL},
+    {"restrictions", flatgrammar_restrictions, NULL, "Restriction of each node (uint8, RESTRICTION_* constants).", NULL},
+    {"values", flatgrammar_values, NULL, "Symbol of each FLAT_ID node, index in limits of each restricted node, -1 otherwise (int32).", NULL},
+    {"children", flatgrammar_children, NULL, "Number of children of each node (int32).", NULL},
+    {"spans", flatgrammar_spans, NULL, "Number of nodes of the subtree rooted at each node (int32): the first child of node i is i + 1,\nand the sibling after a child c is c + spans[c].", NULL},
+    {"limits", flatgrammar_limits, NULL, "Numerical values of the restrictions to cardinality (int64).", NULL},
+    {"roots", flatgrammar_roots, NULL, "Node of the expression of each statement (int32).", NULL},
+    {"variables", flatgrammar_variables, NULL, "Symbol defined by each statement (int32).", NULL},
+    {"symbols", flatgrammar_symbols, NULL, "Names of the symbols (tuple of str).", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
 
-    /* Convert to JSON string. */
-    char *ret_jsonstr = root->toJson(root);
+static int flatgrammar_traverse(PyObject *obj, visitproc visit, void *arg)
+{
+    Py_VISIT(((FlatGrammarObject *) obj)->symbols);
+    Py_VISIT(((FlatGrammarObject *) obj)->array_type);
+    return 0;
+}
+
+static void flatgrammar_dealloc(PyObject *obj)
+{
+    FlatGrammarObject *self = (FlatGrammarObject *) obj;
+    PyTypeObject *type = Py_TYPE(obj);
+
+    PyObject_GC_UnTrack(obj);
+    freeFlatGrammar(self->flat);
+    Py_CLEAR(self->symbols);
+    Py_CLEAR(self->array_type);
+    type->tp_free(obj);
+    Py_DECREF(type);
+}
+
+static PyType_Slot flatgrammar_slots[] = {
+    {Py_tp_getset, flatgrammar_getset},
+    {Py_tp_traverse, flatgrammar_traverse},
+    {Py_tp_dealloc, flatgrammar_dealloc},
+    {Py_tp_doc, "Flat representation of a grammar: its expressions are stored as one array of nodes, in preorder,\n"
+                "with the children of each node right after it. The arrays are exported without copies."},
+    {0, NULL}
+};
+
+static PyType_Spec flatgrammar_spec = {
+    "combstruct2json.FlatGrammar",
+    sizeof(FlatGrammarObject),
+    0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    flatgrammar_slots
+};
 
-    if (ret_jsonstr == NULL) {
-        free(root);
-        PyErr_SetString(Combstruct2JsonError, "Parsing grammar failed for unknown reasons.");
+/* Wrap a flat grammar (which is then owned by the result, even on failure). */
+static PyObject *flat_to_python(const ModuleState *st, FlatGrammar *flat)
+{
+    PyTypeObject *type = (PyTypeObject *) st->flat_type;
+    FlatGrammarObject *self = (FlatGrammarObject *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        freeFlatGrammar(flat);
         return NULL;
     }
+    self->flat = flat;
+    Py_INCREF(st->array_type);
+    self->array_type = st->array_type;
 
-    /* Build the Python output string. */
-    PyObject *py_ret_jsonstr = Py_BuildValue("s", ret_jsonstr);
+    self->symbols = PyTuple_New(flat->symbols);
+    if (self->symbols == NULL) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    for (int s = 0; s < flat->symbols; s++) {
+        PyObject *name = PyUnicode_FromString(flatSymbolName(flat, s));
+        if (name == NULL) {
+            Py_DECREF(self);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(self->symbols, s, name);
+    }
+    return (PyObject *) self;
+}
+
+/*
+  Flatten a parsed grammar (the grammar is freed). A grammar that could not be parsed
+  gives the dictionary of its error, as read_file() does.
+*/
+static PyObject *grammar_to_flat(const ModuleState *st, Grammar *root)
+{
+    FlatGrammar *flat;
 
-    /* Run "import json; json.loads(s)" to return dictionary. */
-    PyObject* myModuleString = PyString_FromString((char*)"json");
-    PyObject* myModule = PyImport_Import(myModuleString);
-    PyObject* myFunction = PyObject_GetAttrString(myModule, (char*)"loads");
-    PyObject* myArgs = PyTuple_Pack(1, py_ret_jsonstr);
-    PyObject* py_ret_json = PyObject_CallObject(myFunction, myArgs);
+    if (root == NULL || root->type == ISERROR) {
+        return grammar_to_python(st, root);
+    }
 
-    /* Clean up. */
-    free(root);
-    free(ret_jsonstr);
+    Py_BEGIN_ALLOW_THREADS
+    flat = flattenGrammar(root);
+    freeGrammar(root);
+    Py_END_ALLOW_THREADS
 
-    Py_DECREF(myModuleString);
-    Py_DECREF(myModule);
-    Py_DECREF(myFunction);
-    Py_DECREF(myArgs);
+    return flat_to_python(st, flat);
+}
+
+static PyObject *combstruct2json_read_flat(PyObject *self, PyObject *args)
+{
+    ModuleState *st = (ModuleState *) PyModule_GetState(self);
+    PyObject *arg_filename;
+    ParseContext ctx;
+    Grammar *root;
+
+    if (!PyArg_ParseTuple(args, "O&", PyUnicode_FSConverter, &arg_filename)) {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    root = readGrammarCtx(&ctx, PyBytes_AS_STRING(arg_filename));
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(arg_filename);
+    return grammar_to_flat(st, root);
+}
 
-    /* Return output. */
-    return py_ret_json;
-}
\ No newline at end of file
+static PyObject *combstruct2json_loads_flat(PyObject *self, PyObject *args)
+{
+    ModuleState *st = (ModuleState *) PyModule_GetState(self);
+    Py_buffer arg_grammar;
+    ParseContext ctx;
+    Grammar *root;
+
+    if (!PyArg_ParseTuple(args, "s*", &arg_grammar)) {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    root = readGrammarFromBufferCtx(&ctx, (const char *) arg_grammar.buf, (size_t) arg_grammar.len);
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&arg_grammar);
+    return grammar_to_flat(st, root);
+}
+
+static PyObject *combstruct2json_read_binary(PyObject *self, PyObject *args)
+{
+    ModuleState *st = (ModuleState *) PyModule_GetState(self);
+    PyObject *arg_filename;
+    int arg_verify = 0;
+    FlatGrammar *flat;
+
+    if (!PyArg_ParseTuple(args, "O&|p", PyUnicode_FSConverter, &arg_filename, &arg_verify)) {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    flat = readGrammarBinary(PyBytes_AS_STRING(arg_filename), arg_verify);
+    Py_END_ALLOW_THREADS
+
+    if (flat == NULL) {
+        char message[] = "not a valid binary grammar";
+        Error error = {.line = 0, .message = message, .type = INPUT};
+        Py_DECREF(arg_filename);
+        return error_to_python(st, &error);
+    }
+    Py_DECREF(arg_filename);
+    return flat_to_python(st, flat);
+}
+
+/********************************** Analysis **********************************/
+
+/* Helper function that returns the list of the names of the statements i such that flags[i] == value. */
+static PyObject *names_to_python(const StatementList *Slist, const char *flags, int value)
+{
+    PyObject *list = PyList_New(0);
+    for (int i = 0; list != NULL && i < Slist->size; i++) {
+        if (flags[i] == value) {
+            PyObject *name = PyUnicode_FromString(Slist->components[i]->variable->name);
+            if (name == NULL || PyList_Append(list, name) < 0)
+                Py_CLEAR(list);
+            Py_XDECREF(name);
+        }
+    }
+    return list;
+}
+
+/* Helper function that sets d[key] to value, and releases value (which may be NULL). */
+static int set_item(PyObject *d, const char *key, PyObject *value)
+{
+    int status = (value == NULL) ? -1 : PyDict_SetItemString(d, key, value);
+    Py_XDECREF(value);
+    return status;
+}
+
+/*
+  Analyze a parsed grammar (the grammar is freed). The dictionary has the same shape as
+  the Json representation (see analysisWriteJson()), and a grammar that could not be
+  parsed gives the dictionary of its error, as read_file() does.
+*/
+static PyObject *grammar_to_analysis(const ModuleState *st, Grammar *root)
+{
+    GrammarAnalysis *analysis;
+
+    if (root == NULL || root->type == ISERROR) {
+        return grammar_to_python(st, root);
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    analysis = analyzeGrammar(root);
+    Py_END_ALLOW_THREADS
+
+    const StatementList *Slist = (StatementList *) root->component;
+    PyObject *result = PyDict_New();
+    PyObject *components = PyList_New(analysis->componentCount);
+
+    if (result == NULL || components == NULL
+        || set_item(result, "well-founded", PyBool_FromLong(analysis->wellFounded)) < 0)
+        goto fail;
+    if (!analysis->wellFounded
+        && set_item(result, "witness", PyUnicode_FromString(Slist->components[analysis->witness]->variable->name)) < 0)
+        goto fail;
+
+    for (int c = 0; c < analysis->componentCount; c++) {
+        int first = analysis->componentOffsets[c];
+        PyObject *component = PyDict_New();
+        PyObject *symbols = PyList_New(analysis->componentOffsets[c + 1] - first);
+        if (component == NULL || symbols == NULL) {
+            Py_XDECREF(component);
+            Py_XDECREF(symbols);
+            goto fail;
+        }
+        PyList_SET_ITEM(components, c, component);
+        for (int k = first; k < analysis->componentOffsets[c + 1]; k++) {
+            PyObject *name = PyUnicode_FromString(Slist->components[analysis->componentStatements[k]]->variable->name);
+            if (name == NULL) {
+                Py_DECREF(symbols);
+                goto fail;
+            }
+            PyList_SET_ITEM(symbols, k - first, name);
+        }
+        if (set_item(component, "symbols", symbols) < 0
+            || set_item(component, "recursive", PyBool_FromLong(analysis->recursive[c])) < 0)
+            goto fail;
+    }
+
+    if (PyDict_SetItemString(result, "components", components) < 0
+        || set_item(result, "unproductive", names_to_python(Slist, analysis->productive, 0)) < 0
+        || set_item(result, "nullable", names_to_python(Slist, analysis->nullable, 1)) < 0)
+        goto fail;
+
+    Py_DECREF(components);
+    freeGrammar(root);
+    return result;
+
+fail:
+    Py_XDECREF(result);
+    Py_XDECREF(components);
+    freeGrammar(root);
+    return NULL;
+}
+
+static PyObject *combstruct2json_analyze_file(PyObject *self, PyObject *args)
+{
+    ModuleState *st = (ModuleState *) PyModule_GetState(self);
+    PyObject *arg_filename;
+    ParseContext ctx;
+    Grammar *root;
+
+    if (!PyArg_ParseTuple(args, "O&", PyUnicode_FSConverter, &arg_filename)) {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    root = readGrammarCtx(&ctx, PyBytes_AS_STRING(arg_filename));
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(arg_filename);
+    return grammar_to_analysis(st, root);
+}
+
+static PyObject *combstruct2json_analyze_string(PyObject *self, PyObject *args)
+{
+    ModuleState *st = (ModuleState *) PyModule_GetState(self);
+    Py_buffer arg_grammar;
+    ParseContext ctx;
+    Grammar *root;
+
+    if (!PyArg_ParseTuple(args, "s*", &arg_grammar)) {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    root = readGrammarFromBufferCtx(&ctx, (const char *) arg_grammar.buf, (size_t) arg_grammar.len);
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&arg_grammar);
+    return grammar_to_analysis(st, root);
+}
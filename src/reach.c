@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <string.h>
+#include "reach.h"
+
+#define APPEND(buffer, literal) (bufferAppend((buffer), (literal), sizeof(literal) - 1)) // literal strings only
+
+struct Reachability_s
+{
+  const Grammar* grammar;
+  const GrammarGraph* graph;
+  unsigned int* stamp; // stamp[i] is the generation of the last closure that reached statement i
+  unsigned int generation;
+  int* closure; // statements of the last closure, in depth-first order
+  int* stack;
+};
+
+Reachability* newReachability(Grammar* grammar)
+{
+  if (grammar->type == ISERROR) {
+    return NULL;
+  }
+
+  Reachability* R = malloc(sizeof(Reachability));
+  int size = ((StatementList*) grammar->component)->size;
+  R->grammar = grammar;
+  R->graph = resolveGrammar(grammar);
+  R->stamp = calloc(size + 1, sizeof(unsigned int));
+  R->generation = 0;
+  R->closure = malloc((size + 1) * sizeof(int));
+  R->stack = malloc((size + 1) * sizeof(int));
+  return R;
+}
+
+void freeReachability(Reachability* reachability)
+{
+  if (reachability == NULL) {
+    return;
+  }
+  free(reachability->stamp);
+  free(reachability->closure);
+  free(reachability->stack);
+  free(reachability);
+}
+
+int reachabilityLookup(const Reachability* reachability, const char* symbol)
+{
+  int s = lookupSymbol(reachability->grammar->symbols, symbol, strlen(symbol));
+  return (s >= 0) ? reachability->graph->definition[s] : -1;
+}
+
+int reachableStatements(Reachability* reachability, int statement, const int** statements)
+{
+  Reachability* R = reachability;
+  const GrammarGraph* graph = R->graph;
+
+  if (++R->generation == 0) { // the stamps wrapped around
+    memset(R->stamp, 0, graph->size * sizeof(unsigned int));
+    R->generation = 1;
+  }
+  int count = 0;
+  int top = 0;
+  R->stamp[statement] = R->generation;
+  R->stack[top++] = statement;
+  while (top > 0) {
+    int i = R->stack[--top];
+    R->closure[count++] = i;
+    for (int k = graph->offsets[i + 1] - 1; k >= graph->offsets[i]; k--) { // first targets on top
+      int j = graph->targets[k];
+      if (R->stamp[j] != R->generation) {
+        R->stamp[j] = R->generation;
+        R->stack[top++] = j;
+      }
+    }
+  }
+  *statements = R->closure;
+  return count;
+}
+
+void reachableWriteJson(Reachability* reachability, int statement, Buffer* buffer)
+{
+  const StatementList* Slist = (StatementList*) reachability->grammar->component;
+  const int* statements;
+  int count = reachableStatements(reachability, statement, &statements);
+
+  APPEND(buffer, "{ ");
+  for (int k = 0; k < count; k++) {
+    if (k > 0) {
+      APPEND(buffer, ", ");
+    }
+    statementWriteJson(Slist->components[statements[k]], buffer);
+  }
+  APPEND(buffer, "}\n");
+}
+
+int pruneGrammar(Grammar* grammar, const char* symbol)
+{
+  Reachability* R = newReachability(grammar);
+  if (R == NULL) {
+    return -1;
+  }
+  int root = reachabilityLookup(R, symbol);
+  if (root < 0) {
+    freeReachability(R);
+    return -1;
+  }
+
+  StatementList* Slist = (StatementList*) grammar->component;
+  const int* statements;
+  int count = reachableStatements(R, root, &statements);
+  Statement** kept = malloc(count * sizeof(Statement*));
+  for (int k = 0; k < count; k++) {
+    kept[k] = Slist->components[statements[k]];
+  }
+  memcpy(Slist->components, kept, count * sizeof(Statement*));
+  Slist->size = count;
+  free(kept);
+  freeReachability(R);
+
+  grammar->sharing = NULL;
+  grammar->graph = NULL;
+  resolveGrammar(grammar);
+  return count;
+}
@@ -0,0 +1,54 @@
+#include "graph.h"
+
+#ifndef REACHTYPE
+#define REACHTYPE
+/*
+  Closures of the statements of a grammar under references, computed on demand from its
+  graph (see newReachability()).
+*/
+typedef struct Reachability_s Reachability;
+#endif
+
+#ifndef REACH_H
+#define REACH_H
+
+/*
+  Resolves the grammar once (see resolveGrammar()), and returns what is needed to compute
+  the statements reachable from any of its statements: the closure of a statement is then
+  found in time linear in the size of the statements it contains (that is, in the size of
+  the output), whatever the size of the grammar. Returns NULL if the grammar is an error.
+  The reachability refers to the statements of the grammar, which should not be modified
+  while it is used, and should be freed with freeReachability().
+*/
+Reachability* newReachability(Grammar* grammar);
+
+void freeReachability(Reachability* reachability);
+
+/*
+  Returns the statement defining the symbol, or -1 if there is none.
+*/
+int reachabilityLookup(const Reachability* reachability, const char* symbol);
+
+/*
+  Returns the number of statements reachable from the given statement (including itself),
+  and sets statements to them, in depth-first order from it, so that it comes first. The
+  array belongs to the reachability, and is only valid until the next call.
+*/
+int reachableStatements(Reachability* reachability, int statement, const int** statements);
+
+/*
+  Writes the Json representation of the statements reachable from the given statement to
+  the buffer, as grammarWriteJson() does for the whole grammar.
+*/
+void reachableWriteJson(Reachability* reachability, int statement, Buffer* buffer);
+
+/*
+  Removes the statements of the grammar that are not reachable from the statement defining
+  the symbol, the others being put in depth-first order from it (see reachableStatements()).
+  Returns the number of statements kept, or -1 if the grammar is an error or the symbol is
+  not defined (the grammar is then not modified). A sharing (see shareGrammar()) is
+  forgotten.
+*/
+int pruneGrammar(Grammar* grammar, const char* symbol);
+
+#endif
@@ -0,0 +1,1108 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "sampler.h"
+#include "flat.h"
+
+#define MAX_LEVELS 256 // largest j such that objects are drawn at z^j, for the Pólya operators
+#define MAX_LIMIT (1 << 20) // largest restriction to cardinality supported
+#define NEGLIGIBLE 1e-17 // values at z^j below this are neglected, as are the last terms of sums
+#define TAIL_BOUND 0.5 // card >= k sums the terms from k on if the argument is below this
+#define TAIL_TERMS 128 // largest number of terms summed
+#define POISSON_SPLIT 500.0 // a Poisson variable of a larger parameter is drawn as a sum of two
+
+/*
+  Laws of the number of components of a construction, whose weights t_i (for i
+  components) are a^i (GEOMETRIC), a^i / i! (POISSON) or a^i / i (LOGARITHMIC), with a the
+  value of the component at the current parameter. UNLABELLED Set and Cycle, which mix the
+  values at several powers of the parameter, have their own laws.
+*/
+typedef enum {LAW_GEOMETRIC, LAW_POISSON, LAW_LOGARITHMIC, LAW_MULTISET, LAW_CYCLE} Law;
+
+/*
+  Node of the grammar, as the sampler sees it.
+*/
+typedef struct Rule_s
+{
+  unsigned char op; // FlatOp (FLAT_ID for references, including Z when it is defined)
+  unsigned char restriction; // Restriction
+  unsigned char law; // Law of the number of components (Set, PowerSet, Sequence and Cycle)
+  unsigned char polya; // 1 for UNLABELLED Set, PowerSet and Cycle
+  int first; // first child in the list of children, or statement referred to (FLAT_ID)
+  int count; // number of children
+  int min, max; // range of the number of components (max INT_MAX if unbounded)
+} Rule;
+
+/*
+  Tasks of the explicit stack of a draw. A VISIT draws count objects from a node; a GROUP
+  draws count components and then turns into a REPLICATE, which copies them times - 1
+  times (the components of Pólya operators at z^j being repeated j times); a CLOSE
+  completes the node at index once its components are drawn.
+*/
+typedef enum {TASK_VISIT, TASK_GROUP, TASK_REPLICATE, TASK_CLOSE} TaskKind;
+
+typedef struct Task_s
+{
+  int kind; // TaskKind
+  int node;
+  int level; // the parameter is z^level
+  int count;
+  int times;
+  int index; // first node of the object drawn by the task
+  int size; // number of atoms drawn before it
+} Task;
+
+struct Sampler_s
+{
+  OracleType type;
+  int size; // number of nodes of the grammar
+  int statements;
+  Rule* rules;
+  int* childList; // children of node n are childList[first], ..., childList[first + count - 1]
+  int* roots; // roots[i] is the node of the expression of statement i
+  int levels; // number of powers of z at which objects are drawn
+  int canonical; // 1 if the components of Pólya operators are put in a canonical order
+  double* values; // values[(level - 1) * size + n] is the value of node n at z^level
+  int* tables; // tables[(level - 1) * size + n] is the offset of the table of node n at z^level, or -1
+  double* probabilities; // decision tables: probabilities, values of alias tables, or parameters
+  int* aliases;
+  int tableSize, tableSpace;
+  unsigned long long int state[4]; // state of the pseudo-random generator
+
+  // object being drawn
+  SampleNode* nodes;
+  int length, space;
+  int atoms;
+  int maxSize;
+  Task* stack;
+  int top, stackSpace;
+  int* blocks; // work array for canonical orders
+  int blockSpace;
+  SampleNode* scratch;
+  int scratchSpace;
+};
+
+/******************************* Random numbers *******************************/
+
+static inline unsigned long long int rotate(unsigned long long int x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+/*
+  Helper function that returns the next output of xoshiro256**.
+*/
+static inline unsigned long long int nextRandom(Sampler* S)
+{
+  unsigned long long int* s = S->state;
+  unsigned long long int result = rotate(s[1] * 5, 7) * 9;
+  unsigned long long int t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotate(s[3], 45);
+  return result;
+}
+
+/*
+  Helper function that returns a uniform double in [0, 1).
+*/
+static inline double uniform(Sampler* S)
+{
+  return (nextRandom(S) >> 11) * 0x1.0p-53;
+}
+
+void seedSampler(Sampler* sampler, unsigned long long int seed)
+{
+  for (int k = 0; k < 4; k++) { // splitmix64
+    seed += 0x9e3779b97f4a7c15ULL;
+    unsigned long long int x = seed;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    sampler->state[k] = x ^ (x >> 31);
+  }
+}
+
+/*
+  Helper function that draws from the alias table of m entries at offset off.
+*/
+static inline int drawAlias(Sampler* S, int off, int m)
+{
+  double u = uniform(S) * m;
+  int i = (int) u;
+  if (i >= m) {
+    i = m - 1;
+  }
+  return (u - i < S->probabilities[off + i]) ? i : S->aliases[off + i];
+}
+
+/*
+  Helper function that draws a Poisson variable of parameter lambda by inversion, from
+  the value k, of probability p (the law being conditioned to be at least k).
+*/
+static int drawPoissonFrom(Sampler* S, double lambda, int k, double p)
+{
+  double u = uniform(S);
+  double sum = p;
+  while (u >= sum && p > 0.0) {
+    k++;
+    p *= lambda / k;
+    sum += p;
+  }
+  return k;
+}
+
+static int drawPoisson(Sampler* S, double lambda)
+{
+  if (lambda > POISSON_SPLIT) {
+    return drawPoisson(S, lambda / 2) + drawPoisson(S, lambda / 2);
+  }
+  return drawPoissonFrom(S, lambda, 0, exp(-lambda));
+}
+
+/*
+  Helper function that returns the probability of 1 for a Poisson variable of parameter
+  lambda conditioned to be positive.
+*/
+static double positiveOne(double lambda)
+{
+  return (lambda > 0.0) ? lambda * exp(-lambda) / -expm1(-lambda) : 1.0;
+}
+
+/*
+  Helper function that draws a Poisson variable conditioned to be positive.
+*/
+static int drawPositivePoisson(Sampler* S, double lambda)
+{
+  if (lambda > POISSON_SPLIT) {
+    int k;
+    do {
+      k = drawPoisson(S, lambda);
+    } while (k == 0);
+    return k;
+  }
+  return drawPoissonFrom(S, lambda, 1, positiveOne(lambda));
+}
+
+/*
+  Helper function that returns the ratio t_i / t_{i-1} of the weights of a law.
+*/
+static inline double lawRatio(int law, double a, int i)
+{
+  switch (law) {
+  case (LAW_GEOMETRIC):
+    return a;
+  case (LAW_POISSON):
+    return a / i;
+  default: // LAW_LOGARITHMIC
+    return a * (i - 1) / i;
+  }
+}
+
+/*
+  Helper function that draws the number of components of a node whose law has weights
+  t_min, t_{min+1}, ..., unbounded: directly for the whole laws, and otherwise by inversion
+  from the probability p of min components, taken from the table of the node.
+*/
+static int drawUnbounded(Sampler* S, const Rule* R, double a, double p)
+{
+  int i = R->min;
+  if (R->law == LAW_GEOMETRIC) { // memoryless
+    double k = floor(log(1.0 - uniform(S)) / log(a));
+    return (a <= 0.0) ? i : (k < INT_MAX - i) ? i + (int) k : INT_MAX;
+  } else if (R->restriction == NONE && R->law == LAW_POISSON) {
+    return drawPoisson(S, a);
+  } else if (R->restriction == NONE || (R->law == LAW_LOGARITHMIC && i == 1)) {
+    double u = uniform(S) * -log1p(-a);
+    double t = a;
+    double sum = t;
+    i = 1;
+    while (u >= sum && t > 0.0) {
+      i++;
+      t *= lawRatio(LAW_LOGARITHMIC, a, i);
+      sum += t;
+    }
+    return i;
+  }
+  double u = uniform(S);
+  while (u >= p && p > 0.0 && i < INT_MAX) {
+    u -= p;
+    i++;
+    p *= lawRatio(R->law, a, i);
+  }
+  return i;
+}
+
+/********************************** Drawing **********************************/
+
+/*
+  Helper function that returns the value of node n at z^level (0 beyond the last level).
+*/
+static inline double valueAt(const Sampler* S, int n, int level)
+{
+  return (level <= S->levels) ? S->values[(size_t) (level - 1) * S->size + n] : 0.0;
+}
+
+static inline int tableOf(const Sampler* S, int n, int level)
+{
+  return S->tables[(size_t) (level - 1) * S->size + n];
+}
+
+static void pushTask(Sampler* S, int kind, int node, int level, int count, int times)
+{
+  if (S->top == S->stackSpace) {
+    S->stackSpace = 2 * S->stackSpace + 64;
+    S->stack = realloc(S->stack, S->stackSpace * sizeof(Task));
+  }
+  Task* T = &S->stack[S->top++];
+  T->kind = kind;
+  T->node = node;
+  T->level = level;
+  T->count = count;
+  T->times = times;
+  T->index = S->length;
+  T->size = S->atoms;
+}
+
+static void reserveNodes(Sampler* S, long long int length)
+{
+  if (length > S->space) {
+    while (S->space < length) {
+      S->space = 2 * S->space + 64;
+    }
+    S->nodes = realloc(S->nodes, S->space * sizeof(SampleNode));
+  }
+}
+
+static inline int emit(Sampler* S, int node)
+{
+  if (S->length == S->space) {
+    reserveNodes(S, S->length + 1);
+  }
+  S->nodes[S->length].node = node;
+  S->nodes[S->length].span = 1;
+  return S->length++;
+}
+
+/*
+  Helper function that pushes the tasks drawing the components of a Pólya operator at
+  z^level, given by the parts of a multiset, or the divisor of a cycle. Returns -1 if
+  the object is certain to exceed the largest size.
+*/
+static int drawMultiset(Sampler* S, const Rule* R, int n, int level)
+{
+  int child = S->childList[R->first];
+  int off = tableOf(S, n, level);
+  int remaining = S->maxSize - S->atoms;
+
+  if (R->max == INT_MAX) {
+    // the largest j with a part at z^(level j), then Poisson numbers of parts for each j
+    int last = S->levels / level;
+    const double* tails = S->probabilities + off; // tails[j] is the sum of the parameters beyond j
+    const double* first = tails + last + 1; // probabilities of 0 parts, and of 1 if positive, for each j
+    long long int total;
+    int top;
+    do {
+      top = S->top;
+      total = 0;
+      double e = -log(1.0 - uniform(S));
+      int largest = 0;
+      while (largest < last && tails[largest] > e) {
+        largest++;
+      }
+      for (int j = largest; j >= 1 && total <= remaining; j--) {
+        double lambda = valueAt(S, child, level * j) / j;
+        int parts = (lambda > POISSON_SPLIT) ? ((j == largest) ? drawPositivePoisson(S, lambda) : drawPoisson(S, lambda)) :
+          (j == largest) ? drawPoissonFrom(S, lambda, 1, first[2 * j - 1]) : drawPoissonFrom(S, lambda, 0, first[2 * j - 2]);
+        total += (long long int) parts * j;
+        if (j == 1 && parts > 0 && total <= remaining) { // no copies to make
+          pushTask(S, TASK_VISIT, child, level, parts, 1);
+        }
+        for (int k = 0; j > 1 && k < parts && total <= remaining; k++) {
+          pushTask(S, TASK_GROUP, child, level * j, 1, j);
+        }
+      }
+      if (total > remaining) {
+        return -1;
+      }
+      S->top = (total < R->min) ? top : S->top;
+    } while (total < R->min);
+    return 0;
+  }
+
+  // T_m is the value with m components, and m T_m is the sum over j of a(z^j) T_{m-j}
+  const double* T = S->probabilities + off;
+  int m = (R->min == R->max) ? R->min : drawAlias(S, off + R->max + 1, R->max + 1);
+  while (m > 0) {
+    double u = uniform(S) * m * T[m];
+    int chosen = 1; // last part of positive weight, in case rounding leaves u positive
+    for (int j = 1; j <= m; j++) {
+      double w = valueAt(S, child, level * j) * T[m - j];
+      chosen = (w > 0.0) ? j : chosen;
+      u -= w;
+      if (u < 0.0) {
+        break;
+      }
+    }
+    pushTask(S, TASK_GROUP, child, level * chosen, 1, chosen);
+    m -= chosen;
+  }
+  return 0;
+}
+
+static int eulerPhi(int n)
+{
+  int result = n;
+  for (int p = 2; p * p <= n; p++) {
+    if (n % p == 0) {
+      while (n % p == 0) {
+        n /= p;
+      }
+      result -= result / p;
+    }
+  }
+  return (n > 1) ? result - result / n : result;
+}
+
+static int drawCycle(Sampler* S, const Rule* R, int n, int level)
+{
+  int child = S->childList[R->first];
+  int off = tableOf(S, n, level);
+  int remaining = S->maxSize - S->atoms;
+  int d, k;
+
+  if (R->max == INT_MAX) { // a divisor d, and a logarithmic number of components at z^(level d)
+    do {
+      d = 1 + drawAlias(S, off, S->levels / level);
+      double a = valueAt(S, child, level * d);
+      double u = uniform(S) * -log1p(-a);
+      double t = a;
+      double sum = t;
+      for (k = 1; u >= sum && t > 0.0 && (long long int) k * d <= remaining; k++) {
+        t *= lawRatio(LAW_LOGARITHMIC, a, k + 1);
+        sum += t;
+      }
+      if ((long long int) k * d > remaining) {
+        return -1;
+      }
+    } while (k * d < R->min);
+  } else { // m components, and a divisor d of m with probability proportional to phi(d) a(z^d)^(m/d)
+    int m = (R->min == R->max) ? R->min : 1 + drawAlias(S, off, R->max);
+    double total = 0.0;
+    for (d = 1; d <= m; d++) {
+      if (m % d == 0) {
+        total += eulerPhi(d) * pow(valueAt(S, child, level * d), m / d);
+      }
+    }
+    double u = uniform(S) * total;
+    int chosen = 1;
+    for (d = 1; d <= m; d++) {
+      double w = (m % d == 0) ? eulerPhi(d) * pow(valueAt(S, child, level * d), m / d) : 0.0;
+      chosen = (w > 0.0) ? d : chosen;
+      u -= w;
+      if (u < 0.0) {
+        break;
+      }
+    }
+    d = chosen;
+    k = m / d;
+  }
+  pushTask(S, TASK_GROUP, child, level * d, k, d);
+  return 0;
+}
+
+/*
+  Helper function that draws an object from node n at z^level: leaves are emitted,
+  references and unions are followed, and the components of other nodes are pushed as
+  tasks. Returns -1 if the object is certain to exceed the largest size.
+*/
+static int visit(Sampler* S, int n, int level)
+{
+  for (;;) {
+    const Rule* R = &S->rules[n];
+    switch (R->op) {
+    case (FLAT_EPSILON):
+      emit(S, n);
+      return 0;
+    case (FLAT_ATOM):
+    case (FLAT_Z):
+      emit(S, n);
+      return (++S->atoms > S->maxSize) ? -1 : 0;
+    case (FLAT_ID):
+      n = S->roots[R->first];
+      continue;
+    case (FLAT_UNION):
+      n = S->childList[R->first + drawAlias(S, tableOf(S, n, level), R->count)];
+      continue;
+    case (FLAT_PROD):
+      pushTask(S, TASK_CLOSE, n, level, 0, 0);
+      emit(S, n);
+      for (int k = R->count - 1; k >= 0; k--) {
+        pushTask(S, TASK_VISIT, S->childList[R->first + k], level, 1, 1);
+      }
+      return 0;
+    default: {
+      int child = S->childList[R->first];
+      int off = tableOf(S, n, level);
+      double a = valueAt(S, child, level);
+      int k;
+      pushTask(S, TASK_CLOSE, n, level, 0, 0);
+      emit(S, n);
+      if (R->law == LAW_MULTISET) {
+        return drawMultiset(S, R, n, level);
+      } else if (R->law == LAW_CYCLE) {
+        return drawCycle(S, R, n, level);
+      } else if (R->min == R->max) {
+        k = R->min;
+      } else if (R->max != INT_MAX) {
+        k = R->min + drawAlias(S, off, R->max - R->min + 1);
+      } else {
+        k = drawUnbounded(S, R, a, (off >= 0) ? S->probabilities[off] : 0.0);
+        if (k > S->maxSize - S->atoms) { // components of unbounded constructions are not empty
+          return -1;
+        }
+      }
+      if (k > 0) {
+        pushTask(S, TASK_VISIT, child, level, k, 1);
+      }
+      return 0;
+    }
+    }
+  }
+}
+
+/*
+  Helper function that compares the objects rooted at nodes a and b (in lexicographic order
+  of their nodes).
+*/
+static int compareObjects(const Sampler* S, int a, int b)
+{
+  const SampleNode* nodes = S->nodes;
+  int la = nodes[a].span, lb = nodes[b].span;
+  for (int i = 0; i < la && i < lb; i++) {
+    if (nodes[a + i].node != nodes[b + i].node) {
+      return (nodes[a + i].node < nodes[b + i].node) ? -1 : 1;
+    } else if (nodes[a + i].span != nodes[b + i].span) {
+      return (nodes[a + i].span < nodes[b + i].span) ? -1 : 1;
+    }
+  }
+  return (la > lb) - (la < lb);
+}
+
+/*
+  Helper function that puts the components of the Set, PowerSet or Cycle at index in a
+  canonical order, so that equal objects have the same nodes: sorted (by merge sort), or
+  as the smallest rotation of a cycle. Their own components are already canonical.
+*/
+static void canonicalize(Sampler* S, int index, int op)
+{
+  int end = index + S->nodes[index].span;
+  int count = 0;
+  for (int c = index + 1; c < end; c += S->nodes[c].span) {
+    count++;
+  }
+  if (count < 2) {
+    return;
+  }
+  if (2 * count > S->blockSpace) {
+    S->blockSpace = 4 * count;
+    S->blocks = realloc(S->blocks, S->blockSpace * sizeof(int));
+  }
+  int* blocks = S->blocks;
+  int* merged = S->blocks + count;
+  count = 0;
+  for (int c = index + 1; c < end; c += S->nodes[c].span) {
+    blocks[count++] = c;
+  }
+
+  if (op == FLAT_CYCLE) {
+    int best = 0;
+    for (int r = 1; r < count; r++) {
+      for (int i = 0; i < count; i++) {
+        int c = compareObjects(S, blocks[(r + i) % count], blocks[(best + i) % count]);
+        if (c != 0) {
+          best = (c < 0) ? r : best;
+          break;
+        }
+      }
+    }
+    if (best == 0) {
+      return;
+    }
+    for (int i = 0; i < count; i++) {
+      merged[i] = blocks[(best + i) % count];
+    }
+    memcpy(blocks, merged, count * sizeof(int));
+  } else {
+    for (int width = 1; width < count; width *= 2) {
+      for (int lo = 0; lo < count; lo += 2 * width) {
+        int mid = (lo + width < count) ? lo + width : count;
+        int hi = (lo + 2 * width < count) ? lo + 2 * width : count;
+        int i = lo, j = mid, k = lo;
+        while (i < mid && j < hi) {
+          merged[k++] = (compareObjects(S, blocks[j], blocks[i]) < 0) ? blocks[j++] : blocks[i++];
+        }
+        while (i < mid) {
+          merged[k++] = blocks[i++];
+        }
+        while (j < hi) {
+          merged[k++] = blocks[j++];
+        }
+      }
+      memcpy(blocks, merged, count * sizeof(int));
+    }
+  }
+
+  int length = end - index - 1;
+  if (length > S->scratchSpace) {
+    S->scratchSpace = 2 * length;
+    S->scratch = realloc(S->scratch, S->scratchSpace * sizeof(SampleNode));
+  }
+  for (int i = 0, k = 0; i < count; i++) {
+    int span = S->nodes[blocks[i]].span;
+    memcpy(S->scratch + k, S->nodes + blocks[i], span * sizeof(SampleNode));
+    k += span;
+  }
+  memcpy(S->nodes + index + 1, S->scratch, length * sizeof(SampleNode));
+}
+
+/*
+  Helper function that completes the node of the task on top of the stack. Returns 1 if
+  it has to be drawn again (a PowerSet with a repeated component).
+*/
+static int close(Sampler* S, const Task* T)
+{
+  const Rule* R = &S->rules[T->node];
+  SampleNode* nodes = S->nodes;
+  nodes[T->index].span = S->length - T->index;
+  if (!S->canonical || !R->polya) {
+    return 0;
+  }
+  canonicalize(S, T->index, R->op);
+  if (R->op == FLAT_POWERSET) {
+    int end = T->index + nodes[T->index].span;
+    for (int c = T->index + 1; c < end && c + nodes[c].span < end; c += nodes[c].span) {
+      if (compareObjects(S, c, c + nodes[c].span) == 0) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/*
+  Helper function that draws an object of statement i. Returns -1 if its size exceeds
+  the largest size.
+*/
+static int draw(Sampler* S, int i)
+{
+  S->length = 0;
+  S->atoms = 0;
+  S->top = 0;
+  pushTask(S, TASK_VISIT, S->roots[i], 1, 1, 1);
+
+  while (S->top > 0) {
+    Task* T = &S->stack[S->top - 1];
+    int node = T->node, level = T->level, count = T->count;
+    switch (T->kind) {
+    case (TASK_VISIT):
+      if (count > 1) {
+        T->count--;
+      } else {
+        S->top--;
+      }
+      if (visit(S, node, level) < 0) {
+        return -1;
+      }
+      break;
+    case (TASK_GROUP):
+      T->kind = TASK_REPLICATE;
+      T->index = S->length;
+      T->size = S->atoms;
+      pushTask(S, TASK_VISIT, node, level, count, 1);
+      break;
+    case (TASK_REPLICATE): {
+      int start = T->index, times = T->times;
+      int length = S->length - start;
+      long long int atoms = S->atoms + (long long int) (S->atoms - T->size) * (times - 1);
+      S->top--;
+      if (atoms > S->maxSize) {
+        return -1;
+      }
+      reserveNodes(S, S->length + (long long int) length * (times - 1));
+      for (int r = 1; r < times; r++) {
+        memcpy(S->nodes + S->length, S->nodes + start, length * sizeof(SampleNode));
+        S->length += length;
+      }
+      S->atoms = (int) atoms;
+      break;
+    }
+    case (TASK_CLOSE):
+      if (close(S, T)) { // drawn again, from the same point
+        S->length = T->index;
+        S->atoms = T->size;
+        T->kind = TASK_VISIT;
+        T->count = 1;
+      } else {
+        S->top--;
+      }
+      break;
+    }
+  }
+  return 0;
+}
+
+int drawSample(Sampler* sampler, int statement, int minSize, int maxSize, int attempts, Sample* sample)
+{
+  if (statement < 0 || statement >= sampler->statements) {
+    return -1;
+  }
+  sampler->maxSize = (maxSize < 0) ? INT_MAX : maxSize;
+  sample->drawn = 0;
+  for (int k = 1; k <= attempts; k++) {
+    int status = draw(sampler, statement);
+    sample->drawn += sampler->atoms;
+    if (status == 0 && sampler->atoms >= minSize) {
+      sample->size = sampler->atoms;
+      sample->length = sampler->length;
+      sample->nodes = sampler->nodes;
+      sample->attempts = k;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/******************************* Compilation *******************************/
+
+/*
+  Helper function that returns the minimal and maximal number of components allowed by
+  the restriction of a node (maximum INT_MAX if there is none).
+*/
+static void cardinalityRange(const FlatGrammar* flat, int node, long long int* min, long long int* max)
+{
+  long long int limit = flatLimit(flat, node);
+  switch (flat->nodes[node].restriction) {
+  case (LESS):
+    *min = 0;
+    *max = limit;
+    break;
+  case (EQUAL):
+    *min = limit;
+    *max = limit;
+    break;
+  case (GREATER):
+    *min = limit;
+    *max = INT_MAX;
+    break;
+  default:
+    *min = 0;
+    *max = INT_MAX;
+  }
+  if (flat->nodes[node].op == FLAT_CYCLE && *min < 1) { // a cycle has at least one component
+    *min = 1;
+  }
+}
+
+/*
+  Helper function that reserves count entries of the decision tables, and returns their
+  offset.
+*/
+static int reserveTable(Sampler* S, int count)
+{
+  if (S->tableSize + count > S->tableSpace) {
+    while (S->tableSpace < S->tableSize + count) {
+      S->tableSpace = 2 * S->tableSpace + 64;
+    }
+    S->probabilities = realloc(S->probabilities, S->tableSpace * sizeof(double));
+    S->aliases = realloc(S->aliases, S->tableSpace * sizeof(int));
+  }
+  S->tableSize += count;
+  return S->tableSize - count;
+}
+
+/*
+  Helper function that fills the alias table of m entries at offset off, for the given
+  nonnegative weights (Vose's method), so that drawAlias() returns i with probability
+  proportional to weights[i].
+*/
+static void buildAlias(Sampler* S, int off, const double* weights, int m)
+{
+  double* probabilities = S->probabilities + off;
+  int* aliases = S->aliases + off;
+  int* small = malloc((m + 1) * sizeof(int));
+  int* large = malloc((m + 1) * sizeof(int));
+  int smalls = 0, larges = 0;
+  double total = 0.0;
+
+  for (int i = 0; i < m; i++) {
+    total += weights[i];
+  }
+  for (int i = 0; i < m; i++) {
+    probabilities[i] = (total > 0.0) ? weights[i] * m / total : 1.0;
+    aliases[i] = i;
+    if (probabilities[i] < 1.0) {
+      small[smalls++] = i;
+    } else {
+      large[larges++] = i;
+    }
+  }
+  while (smalls > 0 && larges > 0) {
+    int s = small[--smalls], l = large[larges - 1];
+    aliases[s] = l;
+    probabilities[l] -= 1.0 - probabilities[s];
+    if (probabilities[l] < 1.0) {
+      larges--;
+      small[smalls++] = l;
+    }
+  }
+  while (larges > 0) { // left over by rounding
+    probabilities[large[--larges]] = 1.0;
+  }
+  while (smalls > 0) {
+    probabilities[small[--smalls]] = 1.0;
+  }
+  free(small);
+  free(large);
+}
+
+/*
+  Helper function that returns T_m, the value of the construction of the rule restricted to
+  m components at z^level, from T_0, ..., T_{m-1} (as seriesTerm() in oracle.c).
+*/
+static double term(const Sampler* S, const Rule* R, int level, const double* T, int m)
+{
+  int child = S->childList[R->first];
+  double a = valueAt(S, child, level);
+  double sum = 0.0;
+
+  if (m == 0) {
+    return (R->op == FLAT_CYCLE) ? 0.0 : 1.0;
+  } else if (R->op == FLAT_SEQUENCE) {
+    return T[m - 1] * a;
+  } else if (!R->polya && R->op == FLAT_CYCLE) {
+    return pow(a, m) / m;
+  } else if (!R->polya) {
+    return T[m - 1] * a / m;
+  } else if (R->op == FLAT_CYCLE) {
+    for (int d = 1; d <= m; d++) {
+      if (m % d == 0) {
+        sum += eulerPhi(d) * pow(valueAt(S, child, level * d), m / d);
+      }
+    }
+  } else {
+    for (int j = 1; j <= m; j++) {
+      double sign = (R->op == FLAT_POWERSET && j % 2 == 0) ? -1.0 : 1.0;
+      sum += sign * valueAt(S, child, level * j) * T[m - j];
+    }
+  }
+  return sum / m;
+}
+
+/*
+  Helper function that returns the value of the construction of node n at z^level (as
+  construction() in oracle.c), using T as work array, or INFINITY if it diverges.
+*/
+static double constructionValue(const Sampler* S, int n, int level, double* T)
+{
+  const Rule* R = &S->rules[n];
+  int child = S->childList[R->first];
+  double a = valueAt(S, child, level);
+  int terms = (R->max != INT_MAX) ? R->max + 1 : (R->restriction == GREATER) ? R->min : 0;
+  double result = 0.0;
+
+  for (int m = 0; m < terms; m++) {
+    T[m] = term(S, R, level, T, m);
+  }
+  if (R->max != INT_MAX) {
+    for (int m = R->min; m <= R->max; m++) {
+      result += T[m];
+    }
+    return result;
+  }
+  if (R->restriction == GREATER && a < TAIL_BOUND) {
+    for (int m = terms; m < terms + TAIL_TERMS; m++) {
+      T[m] = term(S, R, level, T, m);
+      result += T[m];
+      if (fabs(T[m]) <= NEGLIGIBLE * result && m > terms) {
+        break;
+      }
+    }
+    return result;
+  }
+
+  int last = S->levels / level;
+  if (R->op == FLAT_SEQUENCE || R->op == FLAT_CYCLE) {
+    if (a >= 1.0) {
+      return INFINITY;
+    }
+    result = (R->op == FLAT_SEQUENCE) ? 1.0 / (1.0 - a) : -log1p(-a);
+    for (int d = 2; R->op == FLAT_CYCLE && R->polya && d <= last; d++) {
+      double ad = valueAt(S, child, level * d);
+      if (ad >= 1.0) {
+        return INFINITY;
+      }
+      result += -log1p(-ad) * eulerPhi(d) / d;
+    }
+  } else {
+    double exponent = a;
+    for (int j = 2; R->polya && j <= last; j++) {
+      double sign = (R->op == FLAT_POWERSET && j % 2 == 0) ? -1.0 : 1.0;
+      exponent += sign * valueAt(S, child, level * j) / j;
+    }
+    result = exp(exponent);
+  }
+  for (int m = 0; m < terms; m++) {
+    result -= T[m];
+  }
+  return result;
+}
+
+/*
+  Helper function that computes the decision table of node n at z^level (see Sampler),
+  using T (filled by constructionValue()) and weights as work arrays. Returns -1 if it is
+  not finite.
+*/
+static int buildTable(Sampler* S, int n, int level, const double* T, double* weights)
+{
+  const Rule* R = &S->rules[n];
+  if (R->count == 0 || R->op == FLAT_ID) {
+    return 0;
+  }
+  int child = S->childList[R->first];
+  double a = valueAt(S, child, level);
+  int* slot = &S->tables[(size_t) (level - 1) * S->size + n];
+  int off, m;
+
+  switch (R->op) {
+  case (FLAT_UNION):
+    for (int k = 0; k < R->count; k++) {
+      weights[k] = valueAt(S, S->childList[R->first + k], level);
+    }
+    *slot = off = reserveTable(S, R->count);
+    buildAlias(S, off, weights, R->count);
+    return 0;
+  case (FLAT_SET):
+  case (FLAT_POWERSET):
+  case (FLAT_SEQUENCE):
+  case (FLAT_CYCLE):
+    break;
+  default:
+    return 0;
+  }
+
+  if (R->law == LAW_MULTISET && R->max == INT_MAX) { // tails of the sums of the Poisson parameters
+    int last = S->levels / level;
+    *slot = off = reserveTable(S, 3 * last + 1);
+    double* tails = S->probabilities + off;
+    tails[last] = 0.0;
+    for (int j = last; j >= 1; j--) {
+      double lambda = valueAt(S, child, level * j) / j;
+      tails[j - 1] = tails[j] + lambda;
+      tails[last + 2 * j - 1] = exp(-lambda);
+      tails[last + 2 * j] = positiveOne(lambda);
+    }
+  } else if (R->law == LAW_MULTISET) { // T_0, ..., T_max, then an alias table for T_0, ..., T_max
+    *slot = off = reserveTable(S, 2 * (R->max + 1));
+    memcpy(S->probabilities + off, T, (R->max + 1) * sizeof(double));
+    buildAlias(S, off + R->max + 1, T, R->max + 1);
+  } else if (R->law == LAW_CYCLE && R->max == INT_MAX) { // the divisor d
+    int last = S->levels / level;
+    for (int d = 1; d <= last; d++) {
+      weights[d - 1] = -log1p(-valueAt(S, child, level * d)) * eulerPhi(d) / d;
+    }
+    *slot = off = reserveTable(S, last);
+    buildAlias(S, off, weights, last);
+  } else if (R->law == LAW_CYCLE) { // the number of components
+    if (R->min < R->max) {
+      *slot = off = reserveTable(S, R->max);
+      buildAlias(S, off, T + 1, R->max);
+    }
+  } else if (R->max != INT_MAX && R->min < R->max) { // alias table for min, ..., max components
+    double logarithm = 0.0, largest = 0.0;
+    for (m = R->min + 1; m <= R->max; m++) { // logarithms of t_m / t_min
+      logarithm += (a > 0.0) ? log(lawRatio(R->law, a, m)) : -INFINITY;
+      weights[m - R->min] = logarithm;
+      largest = (logarithm > largest) ? logarithm : largest;
+    }
+    weights[0] = 0.0;
+    for (m = 0; m <= R->max - R->min; m++) {
+      weights[m] = exp(weights[m] - largest);
+    }
+    *slot = off = reserveTable(S, R->max - R->min + 1);
+    buildAlias(S, off, weights, R->max - R->min + 1);
+  } else if (R->max == INT_MAX && R->restriction == GREATER && R->law != LAW_GEOMETRIC) {
+    // probability of min components: 1 / (1 + t_{min+1} / t_min + ...)
+    double t = 1.0, sum = 1.0;
+    for (m = R->min + 1; a > 0.0; m++) {
+      double ratio = lawRatio(R->law, a, m);
+      t *= ratio;
+      sum += t;
+      if (ratio < 1.0 && t <= NEGLIGIBLE * sum) {
+        break;
+      }
+      if (!isfinite(sum)) {
+        return -1;
+      }
+    }
+    *slot = off = reserveTable(S, 1);
+    S->probabilities[off] = 1.0 / sum;
+  }
+  return 0;
+}
+
+void freeSampler(Sampler* sampler)
+{
+  if (sampler == NULL) {
+    return;
+  }
+  free(sampler->rules);
+  free(sampler->childList);
+  free(sampler->roots);
+  free(sampler->values);
+  free(sampler->tables);
+  free(sampler->probabilities);
+  free(sampler->aliases);
+  free(sampler->nodes);
+  free(sampler->stack);
+  free(sampler->blocks);
+  free(sampler->scratch);
+  free(sampler);
+}
+
+Sampler* compileSampler(Grammar* grammar, OracleType type, double z, const double* values)
+{
+  GrammarAnalysis* analysis = analyzeGrammar(grammar);
+  if (analysis == NULL || !analysis->wellFounded || !(z >= 0.0) || !isfinite(z)) {
+    return NULL;
+  }
+  const GrammarGraph* graph = analysis->graph;
+  FlatGrammar* flat = flattenGrammar(grammar);
+  int size = flat->size;
+  int statements = flat->statements;
+
+  Sampler* S = calloc(1, sizeof(Sampler));
+  S->type = type;
+  S->size = size;
+  S->statements = statements;
+  S->rules = malloc((size + 1) * sizeof(Rule));
+  S->childList = malloc((size + 1) * sizeof(int));
+  S->roots = malloc((statements + 1) * sizeof(int));
+  memcpy(S->roots, flat->roots, statements * sizeof(int));
+  seedSampler(S, 0);
+
+  // one rule per node
+  int children = 0;
+  int failed = 0;
+  int polya = 0;
+  int maxLimit = 0;
+  for (int n = 0; n < size; n++) {
+    const FlatNode* N = &flat->nodes[n];
+    Rule* R = &S->rules[n];
+    long long int min, max;
+    cardinalityRange(flat, n, &min, &max);
+    R->op = N->op;
+    R->restriction = N->restriction;
+    R->polya = (type == UNLABELLED) && (N->op == FLAT_SET || N->op == FLAT_POWERSET || N->op == FLAT_CYCLE);
+    R->law = (N->op == FLAT_SEQUENCE) ? LAW_GEOMETRIC :
+      (R->polya && N->op == FLAT_SET) ? LAW_MULTISET :
+      (R->polya && N->op == FLAT_CYCLE) ? LAW_CYCLE :
+      (N->op == FLAT_CYCLE) ? LAW_LOGARITHMIC : LAW_POISSON;
+    R->first = children;
+    R->count = N->children;
+    R->min = (int) min;
+    R->max = (int) max;
+    for (int k = 0, c = flatFirstChild(n); k < N->children; k++, c = flatNextSibling(flat, c)) {
+      S->childList[children++] = c;
+    }
+    if (N->op == FLAT_ID) {
+      R->first = graph->definition[N->value];
+    } else if (N->op == FLAT_Z && graph->zStatement >= 0) {
+      R->op = FLAT_ID;
+      R->first = graph->zStatement;
+    }
+    if (flatLimit(flat, n) > MAX_LIMIT || N->op == FLAT_SUBST) {
+      failed = 1;
+    }
+    if (R->max != INT_MAX && R->max > maxLimit) {
+      maxLimit = R->max;
+    } else if (R->max == INT_MAX && R->min > maxLimit) {
+      maxLimit = R->min;
+    }
+    polya = polya || R->polya;
+    S->canonical = S->canonical || (R->polya && N->op == FLAT_POWERSET);
+  }
+  freeFlatGrammar(flat);
+  if (failed || (polya && z >= 1.0)) {
+    freeSampler(S);
+    return NULL;
+  }
+
+  // values of the statements at z, z^2, ... (from the oracle), then of the nodes
+  S->levels = 1;
+  if (polya && z > 0.0) {
+    double levels = ceil(log(NEGLIGIBLE) / log(z));
+    S->levels = (levels < MAX_LEVELS) ? (int) levels : MAX_LEVELS;
+  }
+  S->values = malloc(((size_t) S->levels * size + 1) * sizeof(double));
+  S->tables = malloc(((size_t) S->levels * size + 1) * sizeof(int));
+  double* current = malloc((statements + 1) * sizeof(double));
+  double* T = malloc((maxLimit + TAIL_TERMS + 2) * sizeof(double));
+  int largest = (S->levels > maxLimit + 1) ? S->levels : maxLimit + 1;
+  for (int n = 0; n < size; n++) {
+    if (S->rules[n].count > largest) {
+      largest = S->rules[n].count;
+    }
+  }
+  double* weights = malloc((largest + 1) * sizeof(double));
+  Oracle* oracle = (values == NULL || S->levels > 1) ? compileOracle(grammar, type) : NULL;
+
+  for (int level = S->levels; level >= 1 && !failed; level--) {
+    if (level == 1 && values != NULL) {
+      memcpy(current, values, statements * sizeof(double));
+    } else if (evaluateOracle(oracle, pow(z, level), current) < 0) {
+      failed = 1;
+      break;
+    }
+    double* V = S->values + (size_t) (level - 1) * size;
+    for (int n = size - 1; n >= 0 && !failed; n--) { // children first
+      const Rule* R = &S->rules[n];
+      S->tables[(size_t) (level - 1) * size + n] = -1;
+      switch (R->op) {
+      case (FLAT_EPSILON):
+        V[n] = 1.0;
+        break;
+      case (FLAT_ATOM):
+      case (FLAT_Z):
+        V[n] = pow(z, level);
+        break;
+      case (FLAT_ID):
+        V[n] = current[R->first];
+        break;
+      case (FLAT_UNION):
+      case (FLAT_PROD):
+        V[n] = (R->op == FLAT_PROD);
+        for (int k = 0; k < R->count; k++) {
+          double v = V[S->childList[R->first + k]];
+          V[n] = (R->op == FLAT_PROD) ? V[n] * v : V[n] + v;
+        }
+        break;
+      default:
+        V[n] = constructionValue(S, n, level, T);
+      }
+      failed = !isfinite(V[n]) || V[n] < 0.0 || buildTable(S, n, level, T, weights) < 0;
+    }
+  }
+  free(current);
+  free(T);
+  free(weights);
+  freeOracle(oracle);
+  if (failed) {
+    freeSampler(S);
+    return NULL;
+  }
+  return S;
+}
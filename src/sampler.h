@@ -0,0 +1,80 @@
+#include "oracle.h"
+
+#ifndef SAMPLERTYPE
+#define SAMPLERTYPE
+/*
+  Node of a sampled object. An object is stored as an array of nodes in preorder, the
+  components of a node immediately following it, as in a flat grammar: node is the node
+  of the flat representation of the grammar (see flattenGrammar()) that the object node
+  was drawn from, and span the number of object nodes of its subtree (including itself).
+  Only Epsilon, Atom (and Z), Prod, Set, PowerSet, Sequence and Cycle nodes appear: a
+  Union is replaced by the alternative drawn, and a reference by the expression of the
+  statement it refers to.
+*/
+typedef struct SampleNode_s
+{
+  int node;
+  int span;
+} SampleNode;
+
+/*
+  Object drawn by drawSample(). Its nodes belong to the sampler, and are only valid until
+  the next draw.
+*/
+typedef struct Sample_s
+{
+  int size; // number of atoms
+  int length; // number of nodes
+  const SampleNode* nodes;
+  int attempts; // number of objects drawn, including those rejected
+  long long int drawn; // number of atoms drawn, including those of the objects rejected
+} Sample;
+
+/*
+  Boltzmann sampler: a grammar compiled, at a fixed parameter, into decision tables (see
+  compileSampler()).
+*/
+typedef struct Sampler_s Sampler;
+#endif
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+/*
+  Compiles the grammar into a Boltzmann sampler at the parameter z (below the singularity
+  of the system, see oracleSingularity()), which draws each object of a statement with a
+  probability proportional to z^n (z^n / n! for LABELLED classes), n being its size. The
+  values of the statements at z are taken from values if it is not NULL, and computed by
+  an oracle otherwise (as are, for UNLABELLED classes with Set, PowerSet or Cycle, their
+  values at z^2, z^3, ...). Every choice of the sampler is made from a table computed
+  here: alias tables for the alternatives of each Union and for bounded numbers of
+  components, and the parameters of the geometric, Poisson and logarithmic laws of the
+  others. For UNLABELLED classes, Set and Cycle follow Flajolet, Fusy and Pivoteau
+  (Boltzmann sampling of unlabelled structures, 2007), and PowerSet draws a Set without
+  repeated components by rejection; for LABELLED classes, the shape of an object is drawn,
+  its labels being a uniformly random permutation of 1, ..., n. Returns NULL if the
+  grammar is an error or is not well-founded (see analyzeGrammar()), uses Subst (which is
+  not supported), restricts a cardinality beyond 2^20, or if z is not within the disc of
+  convergence of the system. The sampler does not depend on the grammar, and should be
+  freed with freeSampler(). A sampler should not be used by several threads at once.
+*/
+Sampler* compileSampler(Grammar* grammar, OracleType type, double z, const double* values);
+
+void freeSampler(Sampler* sampler);
+
+/*
+  Seeds the pseudo-random generator of the sampler (xoshiro256**, whose state is derived
+  from the seed by splitmix64). A new sampler is seeded with 0.
+*/
+void seedSampler(Sampler* sampler, unsigned long long int seed);
+
+/*
+  Draws objects of the given statement until one has a size between minSize and maxSize
+  (approximate-size sampling), and sets sample to it. A draw is abandoned as soon as its
+  size exceeds maxSize. Once the tables are warm, drawing does not allocate memory: the
+  objects are built in arrays owned by the sampler, which only grow. Returns 0 on success,
+  and -1 if none of the given number of attempts succeeded.
+*/
+int drawSample(Sampler* sampler, int statement, int minSize, int maxSize, int attempts, Sample* sample);
+
+#endif
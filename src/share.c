@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "share.h"
+
+/*
+  State of the sharing pass: the distinct expressions found so far, indexed by a hash
+  table on their structure (type, restriction and indices of their subexpressions).
+*/
+typedef struct Sharer_s
+{
+  Sharing* sharing;
+  int* table; // open-addressing hash table of the indices of the distinct expressions
+  unsigned int* hashes; // hashes[i] is the structural hash of the i-th distinct expression
+  int mask; // number of slots of the table, minus 1
+} Sharer;
+
+/*
+  Helper function that adds a 32-bit value to a (FNV-1a-like) hash.
+*/
+static inline unsigned int mix(unsigned int h, unsigned int x)
+{
+  h ^= x;
+  h *= 16777619u;
+  return h ^ (h >> 15);
+}
+
+/*
+  Helper function that returns the number of expressions of the tree rooted at E.
+*/
+static int countExpressions(const Expression* E)
+{
+  int count = 1;
+  switch (E->type) {
+  case (UNION):
+  case (PROD):
+  case (SUBST): ;
+    const ExpressionList* Elist = (ExpressionList*) E->component;
+    for (int i = 0; i < Elist->size; i++) {
+      count += countExpressions(Elist->components[i]);
+    }
+    return count;
+  case (SET):
+  case (POWERSET):
+  case (SEQUENCE):
+  case (CYCLE):
+    return count + countExpressions((Expression*) E->component);
+  default:
+    return count;
+  }
+}
+
+/*
+  Helper function that compares two expressions whose subexpressions are already shared
+  (so that equal subexpressions are the same nodes).
+*/
+static int sameExpression(const Expression* A, const Expression* B)
+{
+  if (A->type != B->type || A->restriction != B->restriction || A->limit != B->limit) {
+    return 0;
+  }
+  switch (A->type) {
+  case (ID): ;
+    const Id* a = (Id*) A->component;
+    const Id* b = (Id*) B->component;
+    if (a->symbol >= 0 || b->symbol >= 0) {
+      return a->symbol == b->symbol;
+    }
+    return a->length == b->length && memcmp(a->name, b->name, a->length) == 0;
+  case (UNION):
+  case (PROD):
+  case (SUBST): ;
+    const ExpressionList* Alist = (ExpressionList*) A->component;
+    const ExpressionList* Blist = (ExpressionList*) B->component;
+    if (Alist->size != Blist->size) {
+      return 0;
+    }
+    for (int i = 0; i < Alist->size; i++) {
+      if (Alist->components[i] != Blist->components[i]) {
+        return 0;
+      }
+    }
+    return 1;
+  case (SET):
+  case (POWERSET):
+  case (SEQUENCE):
+  case (CYCLE):
+    return A->component == B->component;
+  default: // Atom, Epsilon and Z
+    return 1;
+  }
+}
+
+/*
+  Helper function that shares the expression E (subexpressions first), and returns the
+  index of the distinct expression it is equal to.
+*/
+static int share(Sharer* H, Expression* E)
+{
+  Sharing* S = H->sharing;
+  unsigned int h = mix(mix(mix(2166136261u, E->type), E->restriction), (unsigned int) E->limit);
+
+  switch (E->type) {
+  case (ID): ;
+    const Id* id = (Id*) E->component;
+    if (id->symbol >= 0) {
+      h = mix(h, id->symbol);
+    } else {
+      for (int i = 0; i < id->length; i++) {
+        h = mix(h, (unsigned char) id->name[i]);
+      }
+    }
+    break;
+  case (UNION):
+  case (PROD):
+  case (SUBST): ;
+    ExpressionList* Elist = (ExpressionList*) E->component;
+    for (int i = 0; i < Elist->size; i++) {
+      int child = share(H, Elist->components[i]);
+      Elist->components[i] = S->nodes[child];
+      h = mix(h, child);
+    }
+    break;
+  case (SET):
+  case (POWERSET):
+  case (SEQUENCE):
+  case (CYCLE): ;
+    int child = share(H, (Expression*) E->component);
+    E->component = S->nodes[child];
+    h = mix(h, child);
+    break;
+  default:
+    break;
+  }
+
+  int slot = h & H->mask;
+  while (H->table[slot] >= 0) { // linear probing
+    int i = H->table[slot];
+    if (H->hashes[i] == h && sameExpression(S->nodes[i], E)) {
+      S->uses[i]++;
+      return i;
+    }
+    slot = (slot + 1) & H->mask;
+  }
+  int i = S->distinct++;
+  H->table[slot] = i;
+  H->hashes[i] = h;
+  S->nodes[i] = E;
+  S->uses[i] = 1;
+  return i;
+}
+
+/*
+  Helper function that returns the slot of the address table where E is (or should be
+  inserted).
+*/
+static int findSlot(const Sharing* S, const Expression* E)
+{
+  unsigned long long int address = (uintptr_t) E;
+  int mask = S->capacity - 1;
+  int slot = (int) (mix(mix(2166136261u, (unsigned int) (address >> 3)), (unsigned int) (address >> 35)) & mask);
+
+  while (S->slots[slot] >= 0 && S->nodes[S->slots[slot]] != E) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+const Sharing* shareGrammar(Grammar* grammar)
+{
+  if (grammar->type == ISERROR) {
+    return NULL;
+  }
+  if (grammar->sharing != NULL) {
+    return grammar->sharing;
+  }
+
+  StatementList* Slist = (StatementList*) grammar->component;
+  Arena* arena = grammar->arena;
+  int expressions = 0;
+  for (int i = 0; i < Slist->size; i++) {
+    expressions += countExpressions(Slist->components[i]->expression);
+  }
+
+  Sharing* S = arenaAlloc(arena, sizeof(Sharing));
+  S->expressions = expressions;
+  S->distinct = 0;
+  S->nodes = arenaAlloc(arena, (expressions + 1) * sizeof(Expression*));
+  S->uses = arenaAlloc(arena, (expressions + 1) * sizeof(int));
+
+  Sharer H;
+  int capacity = 16;
+  while (capacity < 2 * expressions) {
+    capacity *= 2;
+  }
+  H.sharing = S;
+  H.mask = capacity - 1;
+  H.table = malloc(capacity * sizeof(int));
+  H.hashes = malloc((expressions + 1) * sizeof(unsigned int));
+  memset(H.table, -1, capacity * sizeof(int));
+  for (int i = 0; i < Slist->size; i++) {
+    Statement* statement = Slist->components[i];
+    statement->expression = S->nodes[share(&H, statement->expression)];
+  }
+  free(H.table);
+  free(H.hashes);
+
+  // table of the distinct expressions by address, for sharingIndex()
+  S->capacity = 16;
+  while (S->capacity < 2 * S->distinct) {
+    S->capacity *= 2;
+  }
+  S->slots = arenaAlloc(arena, S->capacity * sizeof(int));
+  memset(S->slots, -1, S->capacity * sizeof(int));
+  for (int i = 0; i < S->distinct; i++) {
+    S->slots[findSlot(S, S->nodes[i])] = i;
+  }
+
+  grammar->sharing = S;
+  return S;
+}
+
+int sharingIndex(const Sharing* sharing, const Expression* E)
+{
+  return sharing->slots[findSlot(sharing, E)];
+}
@@ -0,0 +1,53 @@
+#include "absyn.h"
+
+#ifndef SHARETYPE
+#define SHARETYPE
+/*
+  Sharing of the structurally equal expressions of a grammar (see shareGrammar()): its
+  abstract syntax tree becomes a directed acyclic graph, each distinct expression being a
+  single node, referred to by every expression (or statement) it appeared in. Allocated
+  from the arena of the grammar.
+*/
+struct Sharing_s
+{
+  int expressions; // number of expressions of the abstract syntax tree
+  int distinct; // number of distinct expressions (nodes of the graph)
+  Expression** nodes; // nodes[i] is the i-th distinct expression (children before parents)
+  int* uses; // uses[i] is the number of references to nodes[i]
+  int* slots; // open-addressing hash table of the indices of nodes, by address (-1 for empty slots)
+  int capacity; // number of slots (a power of two, at least twice the number of nodes)
+};
+#endif
+
+#ifndef SHARE_H
+#define SHARE_H
+
+/*
+  Shares the structurally equal expressions of the grammar (hash-consing): expressions of
+  the same type and restriction whose subexpressions are the same nodes (or the same
+  symbol, for Ids) are replaced by a single node, from the leaves up, in time linear in
+  the size of the grammar. The grammar is modified in place, and remembers its sharing
+  (grammar->sharing), so that the Json representation (see grammarWriteJson()) and the
+  flat representation (see flattenGrammar()) are built from each distinct expression once,
+  and the evaluators that use the latter (the oracle and the counting engine) evaluate
+  each of them once. Returns the sharing, or NULL if the grammar is an error; calling it
+  again returns the same sharing.
+*/
+const Sharing* shareGrammar(Grammar* grammar);
+
+/*
+  Returns the index of the expression among the distinct nodes of the sharing, or -1 if
+  it is not one of them.
+*/
+int sharingIndex(const Sharing* sharing, const Expression* E);
+
+/*
+  Returns the compression ratio of the sharing: the number of expressions of the abstract
+  syntax tree per distinct expression.
+*/
+static inline double sharingRatio(const Sharing* sharing)
+{
+  return (sharing->distinct > 0) ? (double) sharing->expressions / sharing->distinct : 1.0;
+}
+
+#endif
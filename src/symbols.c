@@ -0,0 +1,122 @@
+#include <stdlib.h>
+#include <string.h>
+#include "symbols.h"
+
+#define INITIAL_SPACE 16 // initial number of symbols the table can hold
+
+/*
+  Helper function that computes the (32-bit FNV-1a) hash of the first length characters of name.
+*/
+static unsigned int hash(const char* name, int length)
+{
+  unsigned int h = 2166136261u;
+  for (int i = 0; i < length; i++) {
+    h ^= (unsigned char) name[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/*
+  Helper function that returns the slot where the given name is (or should be inserted).
+*/
+static int findSlot(const SymbolTable* symbols, const char* name, int length, unsigned int h)
+{
+  int mask = symbols->capacity - 1;
+  int slot = h & mask;
+
+  while (symbols->slots[slot] >= 0) { // linear probing
+    int symbol = symbols->slots[slot];
+    if (symbols->hashes[symbol] == h && symbols->lengths[symbol] == length
+        && memcmp(symbols->names[symbol], name, length) == 0) {
+      return slot;
+    }
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+/*
+  Helper function that doubles the number of slots, and of symbols the table can hold.
+*/
+static void grow(SymbolTable* symbols)
+{
+  Arena* arena = symbols->arena;
+  int space = 2 * symbols->space;
+  int size = symbols->size;
+
+  symbols->names = arenaGrow(arena, symbols->names, size * sizeof(char*), space * sizeof(char*));
+  symbols->lengths = arenaGrow(arena, symbols->lengths, size * sizeof(int), space * sizeof(int));
+  symbols->hashes = arenaGrow(arena, symbols->hashes, size * sizeof(unsigned int), space * sizeof(unsigned int));
+  symbols->space = space;
+
+  // rehash (the symbols themselves do not change)
+  symbols->capacity = 2 * space;
+  symbols->slots = arenaAlloc(arena, symbols->capacity * sizeof(int));
+  memset(symbols->slots, -1, symbols->capacity * sizeof(int));
+  for (int i = 0; i < size; i++) {
+    int slot = symbols->hashes[i] & (symbols->capacity - 1);
+    while (symbols->slots[slot] >= 0) {
+      slot = (slot + 1) & (symbols->capacity - 1);
+    }
+    symbols->slots[slot] = i;
+  }
+}
+
+/********************************** Constructors **********************************/
+
+SymbolTable* newSymbolTable(Arena* arena, int copyNames)
+{
+  SymbolTable* symbols = arenaAlloc(arena, sizeof(SymbolTable));
+  symbols->size = 0;
+  symbols->space = INITIAL_SPACE;
+  symbols->names = arenaAlloc(arena, INITIAL_SPACE * sizeof(char*));
+  symbols->lengths = arenaAlloc(arena, INITIAL_SPACE * sizeof(int));
+  symbols->hashes = arenaAlloc(arena, INITIAL_SPACE * sizeof(unsigned int));
+  symbols->capacity = 2 * INITIAL_SPACE;
+  symbols->slots = arenaAlloc(arena, symbols->capacity * sizeof(int));
+  memset(symbols->slots, -1, symbols->capacity * sizeof(int));
+  symbols->copyNames = copyNames;
+  symbols->arena = arena;
+  return symbols;
+}
+
+/********************************** Functions **********************************/
+
+int internSymbol(SymbolTable* symbols, const char* name, int length)
+{
+  unsigned int h = hash(name, length);
+  int slot = findSlot(symbols, name, length, h);
+
+  if (symbols->slots[slot] >= 0) { // already there
+    return symbols->slots[slot];
+  }
+
+  if (symbols->size == symbols->space) { // keep the load factor at most 1/2
+    grow(symbols);
+    slot = findSlot(symbols, name, length, h);
+  }
+
+  int symbol = symbols->size;
+  symbols->names[symbol] = symbols->copyNames ? arenaStrndup(symbols->arena, name, length) : (char*) name;
+  symbols->lengths[symbol] = length;
+  symbols->hashes[symbol] = h;
+  symbols->slots[slot] = symbol;
+  symbols->size++;
+  return symbol;
+}
+
+int lookupSymbol(const SymbolTable* symbols, const char* name, int length)
+{
+  return symbols->slots[findSlot(symbols, name, length, hash(name, length))];
+}
+
+void terminateSymbols(SymbolTable* symbols)
+{
+  for (int i = 0; i < symbols->size; i++) {
+    char* name = symbols->names[i];
+    if (name[symbols->lengths[i]] != '\0') { // names that are not views (such as literals) may be read-only
+      name[symbols->lengths[i]] = '\0';
+    }
+  }
+}
@@ -0,0 +1,54 @@
+#include "arena.h"
+
+#ifndef SYMBOLSTYPE
+#define SYMBOLSTYPE
+/*
+  Table of the distinct identifiers of a grammar, each of which is given a dense integer
+  index (its symbol) in order of first appearance. Ids carry their symbol, so that consumers
+  can compare identifiers and index arrays with integers rather than strings.
+*/
+typedef struct SymbolTable_s
+{
+  char** names; // names[i] is the name of symbol i
+  int* lengths; // lengths[i] is the number of characters of names[i]
+  int size; // number of symbols
+  int space; // number of symbols that names and lengths can hold
+  int* slots; // open-addressing hash table of symbol indices (-1 for empty slots)
+  unsigned int* hashes; // hashes[i] is the hash of names[i]
+  int capacity; // number of slots (a power of two, at least twice the number of symbols)
+  int copyNames; // whether new names are copied into the arena (or kept as views)
+  Arena* arena; // arena from which the table is allocated
+} SymbolTable;
+#endif
+
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+/********************************** Constructors **********************************/
+
+/*
+  Returns an empty table, allocated from the given arena. If copyNames is 0, the names given
+  to internSymbol() are kept as they are (as views into the input), and should eventually be
+  NULL-terminated with terminateSymbols().
+*/
+SymbolTable* newSymbolTable(Arena* arena, int copyNames);
+
+/********************************** Functions **********************************/
+
+/*
+  Returns the symbol of the identifier made of the first length characters of name,
+  adding it to the table if it is not there already. Expected constant time.
+*/
+int internSymbol(SymbolTable* symbols, const char* name, int length);
+
+/*
+  Returns the symbol of the identifier made of the first length characters of name, or -1
+  if there is no such identifier in the table. Expected constant time.
+*/
+int lookupSymbol(const SymbolTable* symbols, const char* name, int length);
+
+/*
+  NULL-terminates, in place, the names that were added as views (see newSymbolTable()).
+*/
+void terminateSymbols(SymbolTable* symbols);
+
+#endif